@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <jdbc/cppconn/statement.h>
+#include <jdbc/cppconn/resultset.h>
+#include <jdbc/cppconn/exception.h>
+
+#include "polardbx_driver.h"
+#include "config.h"
+#include "const.hpp"
+#include "stand_in_server.h"
+
+// Failover benchmark: drives a stand-in XCluster through planned transfers, leader
+// crashes and network partitions while client threads connect and query, and reports
+// how long the driver takes to find the new leader and what clients saw meanwhile.
+//
+// Usage: ./failover_bench [--SCENARIO=all|transfer|crash|partition] [--THREADS=16]
+//                         [--ROUNDS=3] [--ELECTION_MS=1000] [--BLOCKED_MS=100] [--TIMEOUT_MS=30000]
+
+using namespace sql::polardbx::stand_in;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+std::string scenario_arg = "all";
+int threads = 16;
+int rounds = 3;
+int election_ms = 1000;
+int blocked_ms = 100;
+int timeout_ms = 30000;
+int next_cluster_id = 1000;
+
+struct Attempt {
+    int64_t start_us;
+    int64_t end_us;
+    // 0 when the connect or the query failed
+    int port;
+};
+
+struct Result {
+    bool recovered = false;
+    int64_t detect_us = -1;
+    int64_t first_connect_us = -1;
+    size_t attempts = 0;
+    size_t failed = 0;
+    size_t blocked = 0;
+    size_t stale = 0;
+    std::vector<int64_t> latencies_us;
+};
+
+int64_t micros_since(Clock::time_point origin) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - origin).count();
+}
+
+int connected_port(sql::ConnectOptionsMap options) {
+    try {
+        std::unique_ptr<sql::Connection> conn(sql::polardbx::get_driver_instance()->connect(options));
+        std::unique_ptr<sql::Statement> stmt(conn->createStatement());
+        std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("select @@port"));
+        int port = res->next() ? res->getInt(1) : 0;
+        conn->close();
+        return port;
+    } catch (sql::SQLException& e) {
+        return 0;
+    }
+}
+
+int64_t percentile(std::vector<int64_t>& values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    auto idx = static_cast<size_t>(p * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + idx, values.end());
+    return values[idx];
+}
+
+// inject(dn) applies the fault and returns the index of the node expected to lead afterwards
+Result run_round(const std::function<size_t(XClusterStandIn&)>& inject) {
+    XClusterStandIn dn(3, next_cluster_id++);
+    sql::ConnectOptionsMap options;
+    options[OPT_USERNAME] = std::string("root");
+    options[OPT_PASSWORD] = std::string("");
+    options[OPT_HOSTNAME] = dn.addrs();
+    options[OPT_POLARDBX_CONNECT_TIMEOUT] = timeout_ms;
+
+    auto origin = Clock::now();
+    std::atomic<int64_t> fault_us{-1};
+    std::atomic<int64_t> detect_us{-1};
+    std::atomic<int> new_leader_port{0};
+    std::atomic<bool> stop{false};
+    std::atomic<bool> recovered{false};
+
+    // the checker confirms a leader with CHECK_LEADER_TRANSFER_QUERY right before installing it
+    dn.set_query_hook([&](size_t node, const std::string& statement) -> std::optional<Reply> {
+        auto port = new_leader_port.load();
+        if (port != 0 && dn.server(node).port() == port && fault_us >= 0 && detect_us < 0 &&
+            statement + ";" == sql::polardbx::CHECK_LEADER_TRANSFER_QUERY) {
+            int64_t expected = -1;
+            detect_us.compare_exchange_strong(expected, micros_since(origin));
+        }
+        return std::nullopt;
+    });
+
+    std::mutex mu;
+    std::vector<Attempt> attempts;
+    std::vector<std::thread> clients;
+    for (int t = 0; t < threads; t++) {
+        clients.emplace_back([&]() {
+            std::vector<Attempt> local;
+            while (!stop) {
+                auto start = micros_since(origin);
+                auto port = connected_port(options);
+                local.push_back({start, micros_since(origin), port});
+                if (port != 0 && port == new_leader_port && fault_us >= 0 && start >= fault_us) {
+                    recovered = true;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            std::lock_guard<std::mutex> lock(mu);
+            attempts.insert(attempts.end(), local.begin(), local.end());
+        });
+    }
+
+    // warm up until the cluster has been discovered
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    auto old_leader_port = dn.server(0).port();
+    auto target = inject(dn);
+    new_leader_port = dn.server(target).port();
+    fault_us = micros_since(origin);
+
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (Clock::now() < deadline && !recovered) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    // let in-flight connects settle, then heal partitions so blocked clients can exit
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    stop = true;
+    for (size_t i = 0; i < dn.size(); i++) {
+        dn.partition(i, false);
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+
+    Result result;
+    auto fault = fault_us.load();
+    std::sort(attempts.begin(), attempts.end(), [](const Attempt& a, const Attempt& b) { return a.end_us < b.end_us; });
+    for (const auto& attempt : attempts) {
+        if (attempt.port == new_leader_port && attempt.start_us >= fault) {
+            result.recovered = true;
+            result.first_connect_us = attempt.end_us - fault;
+            break;
+        }
+    }
+    int64_t window_end = result.recovered ? fault + result.first_connect_us : micros_since(origin);
+    for (const auto& attempt : attempts) {
+        if (attempt.end_us < fault || attempt.start_us > window_end) {
+            continue;
+        }
+        result.attempts++;
+        result.latencies_us.push_back(attempt.end_us - attempt.start_us);
+        if (attempt.port == 0) {
+            result.failed++;
+        } else if (attempt.port == old_leader_port && attempt.start_us >= fault) {
+            result.stale++;
+        }
+        if (attempt.end_us - attempt.start_us > blocked_ms * 1000) {
+            result.blocked++;
+        }
+    }
+    if (detect_us >= 0) {
+        result.detect_us = detect_us - fault;
+    }
+    return result;
+}
+
+void report(const std::string& name, std::vector<Result>& results) {
+    std::cout << "== " << name << " (" << threads << " threads, " << results.size() << " rounds)" << std::endl;
+    std::cout << std::left << std::setw(7) << "round" << std::setw(12) << "detect_ms" << std::setw(17) << "first_conn_ms"
+              << std::setw(10) << "attempts" << std::setw(8) << "failed" << std::setw(9) << "blocked"
+              << std::setw(7) << "stale" << std::setw(9) << "p50_ms" << std::setw(9) << "p99_ms" << "max_ms" << std::endl;
+    int round = 0;
+    for (auto& r : results) {
+        auto ms = [](int64_t us) { return us < 0 ? std::string("-") : std::to_string(us / 1000.0).substr(0, 8); };
+        std::cout << std::left << std::setw(7) << ++round << std::setw(12) << ms(r.detect_us)
+                  << std::setw(17) << (r.recovered ? ms(r.first_connect_us) : "timeout")
+                  << std::setw(10) << r.attempts << std::setw(8) << r.failed << std::setw(9) << r.blocked
+                  << std::setw(7) << r.stale << std::setw(9) << ms(percentile(r.latencies_us, 0.5))
+                  << std::setw(9) << ms(percentile(r.latencies_us, 0.99)) << ms(percentile(r.latencies_us, 1.0)) << std::endl;
+    }
+}
+
+void run_scenario(const std::string& name, const std::function<size_t(XClusterStandIn&)>& inject) {
+    if (scenario_arg != "all" && scenario_arg != name) {
+        return;
+    }
+    std::vector<Result> results;
+    for (int i = 0; i < rounds; i++) {
+        results.push_back(run_round(inject));
+    }
+    report(name, results);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.find("--SCENARIO=") == 0) {
+            scenario_arg = arg.substr(strlen("--SCENARIO="));
+        } else if (arg.find("--THREADS=") == 0) {
+            threads = std::stoi(arg.substr(strlen("--THREADS=")));
+        } else if (arg.find("--ROUNDS=") == 0) {
+            rounds = std::stoi(arg.substr(strlen("--ROUNDS=")));
+        } else if (arg.find("--ELECTION_MS=") == 0) {
+            election_ms = std::stoi(arg.substr(strlen("--ELECTION_MS=")));
+        } else if (arg.find("--BLOCKED_MS=") == 0) {
+            blocked_ms = std::stoi(arg.substr(strlen("--BLOCKED_MS=")));
+        } else if (arg.find("--TIMEOUT_MS=") == 0) {
+            timeout_ms = std::stoi(arg.substr(strlen("--TIMEOUT_MS=")));
+        } else {
+            std::cerr << "Usage: ./failover_bench [--SCENARIO=all|transfer|crash|partition] [--THREADS=16] [--ROUNDS=3] "
+                         "[--ELECTION_MS=1000] [--BLOCKED_MS=100] [--TIMEOUT_MS=30000]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // planned switchover: the old leader reports the transfer for election_ms / 2
+    run_scenario("transfer", [](XClusterStandIn& dn) {
+        dn.transfer_leader(1, election_ms / 2);
+        return size_t(1);
+    });
+
+    // leader process dies, the followers elect a new leader after election_ms
+    run_scenario("crash", [](XClusterStandIn& dn) {
+        dn.crash(0);
+        dn.elect(1, election_ms);
+        return size_t(1);
+    });
+
+    // the leader stops answering without closing connections, the majority side elects a new leader
+    run_scenario("partition", [](XClusterStandIn& dn) {
+        dn.partition(0, true);
+        dn.elect(1, election_ms);
+        return size_t(1);
+    });
+
+    return EXIT_SUCCESS;
+}
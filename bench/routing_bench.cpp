@@ -0,0 +1,181 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ha_manager.h"
+#include "utils.hpp"
+
+// Microbenchmarks for the code every connect runs through when picking a node.
+// Topologies have 3 - 300 CNs spread over many zones, thread counts go up to 128
+// so lock contention on the manager shows up.
+
+namespace sql {
+namespace polardbx {
+
+struct HaManagerPeer {
+    static void set_cn_topology(HaManager& manager, std::vector<std::shared_ptr<MppInfo>> cns) {
+        std::unique_lock<std::shared_mutex> lk(manager.rw_mutex_);
+        manager.cn_cluster_info_ = std::move(cns);
+    }
+
+    static std::pair<std::string, bool> get_available_cn_internal(HaManager& manager, const std::string& zoneName,
+        int32_t minZoneNodes, const std::string& backupZoneName, bool slaveRead, const std::string& instanceName,
+        const std::string& mppRole, const std::string& loadBalanceAlgorithm) {
+        return manager.get_available_cn_internal(zoneName, minZoneNodes, backupZoneName, slaveRead, instanceName,
+                                                 mppRole, loadBalanceAlgorithm);
+    }
+
+    static std::pair<std::string, bool> get_available_cn_internal(HaManager& manager,
+        const std::shared_ptr<const CnFilter>& filter, const std::string& loadBalanceAlgorithm) {
+        return manager.get_available_cn_internal(filter, loadBalanceAlgorithm);
+    }
+
+    static std::string get_node_with_load_balance(HaManager& manager, const std::vector<NodeId>& candidates,
+                                                  const std::string& loadBalanceAlgorithm) {
+        return manager.get_node_with_load_balance(candidates, loadBalanceAlgorithm);
+    }
+
+    static NodeId intern(HaManager& manager, const std::string& tag) {
+        return manager.node_table_.intern(tag);
+    }
+};
+
+} // namespace polardbx
+} // namespace sql
+
+using sql::polardbx::HaManager;
+using sql::polardbx::HaManagerPeer;
+using sql::polardbx::MppInfo;
+
+namespace {
+
+std::string cn_addr(int i) {
+    return "10.0." + std::to_string(i / 250) + "." + std::to_string(i % 250 + 1) + ":3306";
+}
+
+// cn i lives in zone-(i % zones), every third cn is a read-only replica
+std::vector<std::shared_ptr<MppInfo>> make_topology(int cn_count) {
+    int zones = std::max(3, cn_count / 10);
+    std::vector<std::shared_ptr<MppInfo>> cns;
+    for (int i = 0; i < cn_count; i++) {
+        auto role = i % 3 == 2 ? sql::polardbx::R : sql::polardbx::W;
+        cns.push_back(std::make_shared<MppInfo>(cn_addr(i), role, "pxc-bench",
+            std::vector<std::string>{"zone-" + std::to_string(i % zones)}, i == 0));
+    }
+    return cns;
+}
+
+// one manager per topology size, shared by all benchmark threads; no checker thread is started
+HaManager& manager_for(int cn_count) {
+    static std::mutex mu;
+    static std::map<int, std::shared_ptr<HaManager>> managers;
+    std::lock_guard<std::mutex> lock(mu);
+    auto& manager = managers[cn_count];
+    if (manager == nullptr) {
+        manager = std::make_shared<HaManager>(false, false, 0, std::make_shared<sql::polardbx::PolarDBXConfig>());
+        HaManagerPeer::set_cn_topology(*manager, make_topology(cn_count));
+    }
+    return *manager;
+}
+
+std::vector<sql::polardbx::NodeId> make_candidates(HaManager& manager, int count) {
+    std::vector<std::string> tags;
+    for (int i = 0; i < count; i++) {
+        tags.push_back(cn_addr(i));
+    }
+    std::sort(tags.begin(), tags.end());
+    std::vector<sql::polardbx::NodeId> candidates;
+    for (const auto& tag : tags) {
+        candidates.push_back(HaManagerPeer::intern(manager, tag));
+    }
+    return candidates;
+}
+
+void BM_GetNodeWithLoadBalance_Random(benchmark::State& state) {
+    auto& manager = manager_for(static_cast<int>(state.range(0)));
+    auto candidates = make_candidates(manager, static_cast<int>(state.range(0)));
+    const std::string algorithm = "random";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(HaManagerPeer::get_node_with_load_balance(manager, candidates, algorithm));
+    }
+}
+
+void BM_GetNodeWithLoadBalance_LeastConnection(benchmark::State& state) {
+    auto& manager = manager_for(static_cast<int>(state.range(0)));
+    auto candidates = make_candidates(manager, static_cast<int>(state.range(0)));
+    const std::string algorithm = "least_connection";
+    for (auto _ : state) {
+        auto node = HaManagerPeer::get_node_with_load_balance(manager, candidates, algorithm);
+        manager.drop_conn_count(node);
+        benchmark::DoNotOptimize(node);
+    }
+}
+
+void BM_GetAvailableCnInternal(benchmark::State& state) {
+    auto& manager = manager_for(static_cast<int>(state.range(0)));
+    const std::string zone_name = "zone-1, zone-2";
+    const std::string backup_zone_name = "zone-0";
+    for (auto _ : state) {
+        auto result = HaManagerPeer::get_available_cn_internal(manager, zone_name, 1, backup_zone_name, false, "",
+                                                               sql::polardbx::W, "random");
+        benchmark::DoNotOptimize(result);
+    }
+}
+
+// the connect path: the filter is compiled once per ConnectionConfig
+void BM_GetAvailableCnInternal_CompiledFilter(benchmark::State& state) {
+    auto& manager = manager_for(static_cast<int>(state.range(0)));
+    auto filter = sql::polardbx::CnFilter::compile("zone-1, zone-2", 1, "zone-0", false, "", sql::polardbx::W);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(HaManagerPeer::get_available_cn_internal(manager, filter, "random"));
+    }
+}
+
+void BM_GetAvailableCnInternal_SlaveRead(benchmark::State& state) {
+    auto& manager = manager_for(static_cast<int>(state.range(0)));
+    const std::string zone_name = "zone-1";
+    for (auto _ : state) {
+        auto result = HaManagerPeer::get_available_cn_internal(manager, zone_name, 1, "", true, "pxc-bench",
+                                                               sql::polardbx::R, "least_connection");
+        manager.drop_conn_count(result.first);
+        benchmark::DoNotOptimize(result);
+    }
+}
+
+void BM_ParseHostPort(benchmark::State& state) {
+    const std::vector<std::string> addrs = {"10.0.0.1:3306", "mysql://10.0.0.2:3307", "db.example.com"};
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sql::polardbx::parseHostPort(addrs[i++ % addrs.size()]));
+    }
+}
+
+void BM_CaseInsensitiveEqual(benchmark::State& state) {
+    const std::vector<std::pair<std::string, std::string>> pairs = {
+        {"Leader", "leader"}, {"Follower", "Leader"}, {"W", "w"}, {"least_connection", "random"}};
+    size_t i = 0;
+    for (auto _ : state) {
+        const auto& [a, b] = pairs[i++ % pairs.size()];
+        benchmark::DoNotOptimize(sql::polardbx::caseInsensitiveEqual(a, b));
+    }
+}
+
+void topology_args(benchmark::internal::Benchmark* b) {
+    b->Arg(3)->Arg(30)->Arg(300)->ThreadRange(1, 128)->UseRealTime();
+}
+
+} // namespace
+
+BENCHMARK(BM_GetNodeWithLoadBalance_Random)->Apply(topology_args);
+BENCHMARK(BM_GetNodeWithLoadBalance_LeastConnection)->Apply(topology_args);
+BENCHMARK(BM_GetAvailableCnInternal)->Apply(topology_args);
+BENCHMARK(BM_GetAvailableCnInternal_CompiledFilter)->Apply(topology_args);
+BENCHMARK(BM_GetAvailableCnInternal_SlaveRead)->Apply(topology_args);
+BENCHMARK(BM_ParseHostPort)->ThreadRange(1, 128)->UseRealTime();
+BENCHMARK(BM_CaseInsensitiveEqual)->ThreadRange(1, 128)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,96 @@
+#ifndef BATCH_STATEMENT_H
+#define BATCH_STATEMENT_H
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+#include "jdbc/cppconn/exception.h"
+#include "jdbc/cppconn/sqlstring.h"
+
+namespace sql {
+namespace polardbx {
+
+class PolarDBX_Connection;
+
+// update count of a row whose statement succeeded without telling its own count
+constexpr int BATCH_SUCCESS_NO_INFO = -2;
+
+// Statement text split at its ? placeholders, see parse_batch_template.
+struct BatchTemplate {
+    // text around the placeholders of the whole statement, placeholders + 1 pieces
+    std::vector<std::string> Pieces;
+    // a single-row INSERT/REPLACE ... VALUES (...) that can take more rows
+    bool MultiRow = false;
+    // everything before the values tuple, up to and including VALUES
+    std::string Head;
+    // the values tuple split at its placeholders, which are all of the statement's
+    std::vector<std::string> RowPieces;
+
+    size_t param_count() const { return Pieces.size() - 1; }
+};
+
+BatchTemplate parse_batch_template(const std::string& sql);
+
+// executeBatch failed part way; the counts cover the rows before the failing chunk
+class BatchUpdateException : public sql::SQLException {
+public:
+    BatchUpdateException(const sql::SQLException& cause, std::vector<int> counts)
+        : sql::SQLException(cause), counts_(std::move(counts)) {}
+
+    const std::vector<int>& getUpdateCounts() const { return counts_; }
+
+private:
+    std::vector<int> counts_;
+};
+
+// JDBC style batch of one parameterized statement. Rows of a single-row INSERT/REPLACE
+// are sent as multi-row statements that each fit max_allowed_packet, so a batch costs
+// one round trip per packet instead of one per row; other statements run row by row.
+// Parameters are rendered client side with the connection's escaping.
+class BatchStatement {
+public:
+    BatchStatement(PolarDBX_Connection* conn, const sql::SQLString& sql);
+    BatchStatement(const BatchStatement&) = delete;
+    BatchStatement& operator=(const BatchStatement&) = delete;
+
+    void setBigInt(unsigned int parameterIndex, const sql::SQLString& value);
+    void setBlob(unsigned int parameterIndex, std::istream* blob);
+    void setBoolean(unsigned int parameterIndex, bool value);
+    void setDateTime(unsigned int parameterIndex, const sql::SQLString& value);
+    void setDouble(unsigned int parameterIndex, double value);
+    void setInt(unsigned int parameterIndex, int32_t value);
+    void setUInt(unsigned int parameterIndex, uint32_t value);
+    void setInt64(unsigned int parameterIndex, int64_t value);
+    void setUInt64(unsigned int parameterIndex, uint64_t value);
+    void setNull(unsigned int parameterIndex, int sqlType);
+    void setString(unsigned int parameterIndex, const sql::SQLString& value);
+    void clearParameters();
+
+    // queues the current parameters as one row, they stay set for the next row
+    void addBatch();
+    // one count per queued row, BATCH_SUCCESS_NO_INFO when a multi-row statement
+    // affected a number of rows that cannot be attributed; the batch is empty afterwards
+    std::vector<int> executeBatch();
+    void clearBatch();
+    size_t batchSize() const { return rows_.size(); }
+
+private:
+    void set(unsigned int parameterIndex, std::string literal);
+    std::string quote(const std::string& value);
+    size_t max_statement_bytes();
+
+    PolarDBX_Connection* conn_;
+    BatchTemplate template_;
+    // current parameters rendered as SQL literals, empty until set
+    std::vector<std::string> params_;
+    std::vector<bool> bound_;
+    // queued rows, each the values tuple or the whole statement when not MultiRow
+    std::vector<std::string> rows_;
+    size_t max_packet_ = 0;
+};
+
+} // namespace polardbx
+} // namespace sql
+
+#endif // BATCH_STATEMENT_H
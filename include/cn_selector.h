@@ -0,0 +1,83 @@
+#ifndef CN_SELECTOR_H
+#define CN_SELECTOR_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "entity.hpp"
+#include "node_table.h"
+
+namespace sql {
+namespace polardbx {
+
+constexpr uint8_t CN_ROLE_W = 0x1;
+// R, CR and any other read-only role
+constexpr uint8_t CN_ROLE_RO = 0x2;
+
+// CN routing filter of a ConnectionConfig, parsed once and shared by every connect
+// using that config. Two filters with the same Key select the same CNs.
+struct CnFilter {
+    std::vector<std::string> Zones;
+    std::vector<std::string> BackupZones;
+    std::string InstanceName;
+    int32_t MinZoneNodes = 0;
+    // CN_ROLE_* bits accepted, 0 accepts nothing
+    uint8_t RoleMask = 0;
+
+    std::string Key;
+    size_t Hash = 0;
+
+    static std::shared_ptr<const CnFilter> compile(const std::string& zoneName, int32_t minZoneNodes,
+        const std::string& backupZoneName, bool slaveRead, const std::string& instanceName, const std::string& mppRole);
+};
+
+struct CnFilterHash {
+    size_t operator()(const std::shared_ptr<const CnFilter>& filter) const { return filter->Hash; }
+};
+
+struct CnFilterEqual {
+    bool operator()(const std::shared_ptr<const CnFilter>& a, const std::shared_ptr<const CnFilter>& b) const {
+        return a == b || a->Key == b->Key;
+    }
+};
+
+// A CN topology with zones, roles and instance names interned to small integers,
+// built once per topology version.
+class CnTopology {
+public:
+    CnTopology(uint64_t version, const std::vector<std::shared_ptr<MppInfo>>& cns, NodeTable& nodes);
+
+    uint64_t version() const { return version_; }
+
+    // ids of the CNs passing filter in tag order; when fewer than MinZoneNodes pass,
+    // the CNs in the backup zones instead
+    std::vector<NodeId> select(const CnFilter& filter) const;
+
+private:
+    using ZoneBits = std::vector<uint64_t>;
+
+    ZoneBits zone_bits(const std::vector<std::string>& zones) const;
+    static bool intersects(const ZoneBits& a, const ZoneBits& b);
+
+    uint64_t version_;
+    std::unordered_map<std::string, uint32_t> zone_ids_;
+    std::unordered_map<std::string, uint32_t> instance_ids_;
+    // indexed by CN, ordered by tag
+    std::vector<NodeId> ids_;
+    std::vector<uint8_t> roles_;
+    std::vector<uint32_t> instances_;
+    std::vector<ZoneBits> zones_;
+};
+
+// Candidates of one filter against one topology version.
+struct CnSelector {
+    uint64_t Version = 0;
+    std::vector<NodeId> Candidates;
+};
+
+} // namespace polardbx
+} // namespace sql
+
+#endif // CN_SELECTOR_H
@@ -0,0 +1,69 @@
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "jdbc/cppconn/resultset.h"
+
+namespace sql {
+namespace polardbx {
+
+enum class ColumnType { INT64, UINT64, DOUBLE, UTF8, BINARY };
+
+// Arrow C data interface format string of a column type
+const char* arrow_format(ColumnType type);
+
+// One column of a ColumnBatch in Arrow layout: a validity bitmap (bit i set when row i
+// is not null, least significant bit first), then either fixed-width values or int32
+// offsets (length + 1 entries) into a contiguous data buffer. The buffers are sized for
+// the batch capacity once and reused by the following batches.
+struct ColumnBuffer {
+    std::string Name;
+    ColumnType Type = ColumnType::UTF8;
+    size_t Length = 0;
+    int64_t NullCount = 0;
+    std::vector<uint8_t> Validity;
+    // INT64 and UINT64 (stored bit for bit) values
+    std::vector<int64_t> Ints;
+    std::vector<double> Doubles;
+    std::vector<int32_t> Offsets;
+    std::vector<char> Data;
+
+    // empties the column for up to capacity rows, keeping the allocations
+    void reset(size_t capacity);
+    void append_null();
+    void append_int(int64_t value) { Validity[Length >> 3] |= 1 << (Length & 7); Ints[Length++] = value; }
+    void append_double(double value) { Validity[Length >> 3] |= 1 << (Length & 7); Doubles[Length++] = value; }
+    void append_bytes(const char* data, size_t size);
+    // trims the buffers to Length
+    void finish();
+};
+
+struct ColumnBatch {
+    size_t Rows = 0;
+    std::vector<ColumnBuffer> Columns;
+};
+
+// Decodes a result set into ColumnBatches of up to max_rows rows. Integer and floating
+// point columns go straight into typed buffers without a per-cell string; DECIMAL and
+// temporal columns keep their text form so no precision is lost. Works on any result
+// set, for large reads use a TYPE_FORWARD_ONLY statement so rows are not buffered twice.
+class ColumnarReader {
+public:
+    // res must outlive the reader
+    explicit ColumnarReader(sql::ResultSet* res);
+
+    // the next rows into batch, reusing its buffers; false when no rows were left
+    bool next_batch(ColumnBatch& batch, size_t max_rows);
+
+private:
+    sql::ResultSet* res_;
+    std::vector<std::string> names_;
+    std::vector<ColumnType> types_;
+};
+
+} // namespace polardbx
+} // namespace sql
+
+#endif // COLUMNAR_H
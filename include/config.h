@@ -1,6 +1,7 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -16,12 +17,22 @@
 #define OPT_HA_CHECK_INTERVAL             "haCheckInterval"
 #define OPT_CHECK_LEADER_TRANSFERRING_INTERVAL  "checkLeaderTransferringInterval"
 #define OPT_LEADER_TRANSFERRING_WAIT_TIMEOUT    "leaderTransferringWaitTimeout"
+#define OPT_LEADER_SUSPECT_WINDOW         "leaderSuspectWindow"
 #define OPT_SMOOTH_SWITCHOVER             "smoothSwitchover"
 #define OPT_RECORD_JDBC_URL               "recordJdbcUrl"
 #define OPT_DIRECT_MODE                   "directMode"
 #define OPT_IGNORE_VIP                    "ignoreVip"
 #define OPT_JSON_FILE                     "jsonFile"
 #define OPT_ENABLE_LOG                    "enableLog"
+#define OPT_HOST_LOCAL_PROBE              "hostLocalProbe"
+#define OPT_HA_IDLE_TIMEOUT               "haIdleTimeout"
+#define OPT_HA_IDLE_CHECK_INTERVAL        "haIdleCheckInterval"
+#define OPT_HA_SHUTDOWN_TIMEOUT           "haShutdownTimeout"
+#define OPT_CN_PROBE_QUORUM               "cnProbeQuorum"
+#define OPT_HA_CHECK_MAX_BACKOFF          "haCheckMaxBackoff"
+#define OPT_HA_PROBE_BUDGET               "haProbeBudget"
+#define OPT_CONNECT_CONCURRENCY           "connectConcurrency"
+#define OPT_CONNECT_RATE                  "connectRate"
 
 // Connect related
 #define OPT_POLARDBX_CONNECT_TIMEOUT        "connectTimeout"
@@ -35,10 +46,42 @@
 #define OPT_INSTANCE_NAME                   "instanceName"
 #define OPT_MPP_ROLE                        "mppRole"
 #define OPT_ENABLE_FOLLOWER_READ            "enableFollowerRead"
+#define OPT_WARM_CONNECTIONS                "warmConnections"
+#define OPT_PREP_STMT_CACHE_SIZE            "prepStmtCacheSize"
+#define OPT_ALLOW_MULTI_QUERIES             "allowMultiQueries"
+#define OPT_STREAM_BUFFER_SIZE              "streamBufferSize"
+#define OPT_RESULT_CACHE_SIZE               "resultCacheSize"
+#define OPT_RESULT_CACHE_TTL                "resultCacheTtl"
+#define OPT_CONNECT_PRIORITY                "connectPriority"
 
 namespace sql {
 namespace polardbx {
 
+struct CnFilter;
+
+// order in which waiting connects get a node and a handshake slot, critical first
+enum class ConnectClass : int32_t {
+    CRITICAL = 0,
+    NORMAL = 1,
+    BATCH = 2,
+};
+
+// "critical", "normal" or "batch", case-insensitive
+ConnectClass parse_connect_class(const std::string& name);
+
+// std::atomic that copies its value, so a config holding one keeps its implicit copy constructor
+template <typename T>
+struct CopyableAtomic : std::atomic<T> {
+    using std::atomic<T>::operator=;
+    CopyableAtomic() = default;
+    CopyableAtomic(T value) : std::atomic<T>(value) {}
+    CopyableAtomic(const CopyableAtomic& other) : std::atomic<T>(other.load()) {}
+    CopyableAtomic& operator=(const CopyableAtomic& other) {
+        this->store(other.load());
+        return *this;
+    }
+};
+
 class PolarDBXConfig {
 public:
     PolarDBXConfig();
@@ -55,10 +98,26 @@ public:
     int32_t HaCheckIntervalMillis;
     int32_t CheckLeaderTransferringIntervalMillis;
     int32_t LeaderTransferringWaitTimeoutMillis;
+    // how long a leader that missed one ping is still handed out while it is re-probed, 0 disables
+    int32_t LeaderSuspectWindowMillis;
     bool SmoothSwitchover;
-    std::atomic<bool> IgnoreVip;
+    CopyableAtomic<bool> IgnoreVip;
     std::string JsonFile;
     bool EnableLog;
+    bool HostLocalProbe;
+    int32_t HaIdleTimeoutMillis;
+    int32_t HaIdleCheckIntervalMillis;
+    int32_t HaShutdownTimeoutMillis;
+    // a CN probe cycle ends once this many seeds returned the same show mpp view
+    int32_t CnProbeQuorum;
+    // longest leader ping interval while the cluster stays healthy; the default keeps
+    // pinging every 100ms, a larger value trades failover detection time for fewer pings
+    int32_t HaCheckMaxBackoffMillis;
+    // probe cycles per second a manager may run at most
+    int32_t HaProbeBudget;
+    // handshakes with the cluster's nodes in flight at once / started per second, 0 for no limit
+    int32_t ConnectConcurrency;
+    int32_t ConnectRate;
 
     sql::ConnectOptionsMap conn_properties_;
 };
@@ -79,6 +138,24 @@ public:
     std::string InstanceName;
     std::string MppRole;
     int32_t EnableFollowerRead;
+    // idle connections the manager keeps open per target for these options, 0 disables
+    int32_t WarmConnections;
+    // prepared statements kept per connection for prepareCachedStatement, 0 disables
+    int32_t PrepStmtCacheSize;
+    // connect with CLIENT_MULTI_STATEMENTS so a Pipeline goes out in one packet
+    bool AllowMultiQueries;
+    // bytes of rows a streaming cursor reads ahead before it stops reading the socket
+    int32_t StreamBufferSize;
+    // bytes of the driver wide result cache executeCachedQuery may fill, 0 disables it
+    int32_t ResultCacheSize;
+    int32_t ResultCacheTtlMillis;
+    // critical, normal or batch, see ConnectClass
+    std::string ConnectPriority;
+
+    // zone/role/instance filter above compiled once at parse time, see cn_selector.h
+    std::shared_ptr<const CnFilter> CompiledCnFilter;
+    // ConnectPriority parsed at parse time
+    ConnectClass CompiledConnectClass;
 };
 
 } // namespace polardbx
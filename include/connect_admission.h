@@ -0,0 +1,71 @@
+#ifndef CONNECT_ADMISSION_H
+#define CONNECT_ADMISSION_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include "config.h"
+
+namespace sql {
+namespace polardbx {
+
+// Admission of new handshakes to the nodes of one cluster: at most max_in_flight
+// handshakes at a time and at most rate_per_second started per second, handed out in
+// arrival order. After a failover every waiting connect is released at once; this
+// spreads them over time so a freshly promoted leader is not flooded.
+// 0 disables either limit. Waiting connects are served critical first, then normal,
+// then batch; batch ones may hold only half of the max_in_flight slots and are refused
+// outright while max_in_flight connects already wait.
+class ConnectAdmission {
+public:
+    // releases its slot when destroyed, false when admission timed out
+    class Permit {
+    public:
+        Permit() = default;
+        explicit Permit(ConnectAdmission* owner) : owner_(owner) {}
+        Permit(Permit&& other) noexcept : owner_(other.owner_) { other.owner_ = nullptr; }
+        Permit& operator=(Permit&& other) noexcept;
+        ~Permit() { reset(); }
+        Permit(const Permit&) = delete;
+        Permit& operator=(const Permit&) = delete;
+
+        explicit operator bool() const { return owner_ != nullptr; }
+        void reset();
+
+    private:
+        ConnectAdmission* owner_ = nullptr;
+    };
+
+    ConnectAdmission(int32_t max_in_flight, int32_t rate_per_second);
+
+    // waits its turn until deadline_nanos (steady clock)
+    Permit acquire(int64_t deadline_nanos, ConnectClass cls = ConnectClass::NORMAL);
+    int32_t in_flight();
+
+private:
+    struct Waiter {
+        std::condition_variable cv;
+        ConnectClass cls;
+    };
+
+    void release();
+    int32_t slots_for(ConnectClass cls) const;
+    bool admit_locked(int64_t now, ConnectClass cls);
+    void wake_head_locked();
+
+    std::mutex mutex_;
+    // waiting connects by class, FIFO within a class, only the head may be admitted
+    std::list<Waiter*> queue_;
+    int32_t in_flight_ = 0;
+    int32_t max_in_flight_;
+    int32_t rate_;
+    // token bucket holding up to rate_ handshakes
+    double tokens_;
+    int64_t refill_nanos_;
+};
+
+} // namespace polardbx
+} // namespace sql
+
+#endif // CONNECT_ADMISSION_H
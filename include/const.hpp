@@ -27,8 +27,22 @@ const std::string BLUE {"\033[34m"};
 const std::string MAGENTA {"\033[35m"};
 const std::string CYAN {"\033[36m"};
 
-enum DNState { LEADER_ALIVE = 0, LEADER_TRANSFERRING = 1, LEADER_TRANSFERRED = 2, LEADER_LOST = 3 };
+enum DNState { LEADER_ALIVE = 0, LEADER_TRANSFERRING = 1, LEADER_TRANSFERRED = 2, LEADER_LOST = 3, LEADER_SUSPECT = 4 };
 enum CNState { CN_ALIVE = 0, CN_LOST = 1 };
+// concurrent show mpp probes per manager
+constexpr size_t CN_PROBE_THREADS {4};
+// cap of the reconnect backoff of a CN probe connection
+constexpr int32_t CN_PROBE_MAX_BACKOFF_MILLIS {5000};
+// warm connections are recycled well before a default wait_timeout could close them
+constexpr int32_t WARM_CONNECTION_MAX_AGE_MILLIS {300000};
+// a warm connection idle for longer is pinged before a client adopts it
+constexpr int32_t WARM_CONNECTION_VALIDATE_MILLIS {1000};
+// pause before a warm pool retries after a failed connect
+constexpr int32_t WARM_POOL_RETRY_MILLIS {1000};
+// kept free in max_allowed_packet when a batch packs rows into one statement
+constexpr size_t BATCH_PACKET_HEADROOM {1024};
+// rows an unordered parallel scan buffers per piece it runs concurrently
+constexpr size_t SCAN_QUEUE_ROWS_PER_PIECE {1024};
 
 constexpr std::string_view MYSQL_NATIVE {"mysqlNative"};
 constexpr std::string_view LEADER_ONLY {"leaderOnly"};
@@ -45,6 +59,8 @@ constexpr std::string_view LEAST_CONN {"least_connection"};
 const std::string W {"W"};
 const std::string R {"R"};
 const std::string CR {"CR"};
+// role a prober publishes for a seed it could not reach while no leader is known
+const std::string DN_ROLE_UNREACHABLE {"Unreachable"};
 
 constexpr int DO_NOTHING {-1};
 constexpr int READ_LEADER {0};
@@ -26,7 +26,8 @@ struct XClusterNodeBasic {
     int32_t Port;
     std::string Role;
     std::vector<std::shared_ptr<XClusterNodeBasic>> Peers;
-    std::string UpdateTime;
+    // steady clock nanoseconds of the probe that reported the node
+    int64_t UpdateTime = 0;
 
     XClusterNodeBasic() {};
 
@@ -35,7 +36,7 @@ struct XClusterNodeBasic {
                       int32_t port,
                       const std::string& role,
                       const std::vector<std::shared_ptr<XClusterNodeBasic>>& peers,
-                      const std::string& updateTime)
+                      int64_t updateTime)
         : Tag(tag), Host(host), Port(port), Role(role), Peers(peers), UpdateTime(updateTime) {};
 
     nlohmann::json to_json() const {
@@ -45,17 +46,23 @@ struct XClusterNodeBasic {
             {"port", Port},
             {"role", Role},
             {"peers", nlohmann::json::array()},
-            {"update_time", UpdateTime}
+            // kept a string, the file format is shared with the other PolarDB-X drivers
+            {"update_time", std::to_string(UpdateTime)}
         };
     }
 
     static XClusterNodeBasic from_json(const nlohmann::json &j) {
         XClusterNodeBasic node;
-        node.Tag = j["tag"];
-        node.Host = j["host"];
-        node.Port = j["port"];
-        node.Role = j["role"];
-        node.UpdateTime = j["update_time"];
+        node.Tag = j.at("tag");
+        node.Host = j.at("host");
+        node.Port = j.at("port");
+        node.Role = j.at("role");
+        const auto& update_time = j.at("update_time");
+        if (update_time.is_string()) {
+            node.UpdateTime = std::stoll(update_time.get<std::string>());
+        } else {
+            node.UpdateTime = update_time.get<int64_t>();
+        }
         return node;
     }
 };
@@ -63,6 +70,9 @@ struct XClusterNodeBasic {
 struct XClusterInfo {
     std::shared_ptr<XClusterNodeBasic> LeaderInfo;
     std::shared_ptr<LeaderTransferInfo> leader_transfer_info;
+    // leader whose last ping failed, still routed to until confirmed lost or SuspectSinceNanos + window
+    std::shared_ptr<XClusterNodeBasic> SuspectLeader;
+    int64_t SuspectSinceNanos = 0;
     std::atomic<int32_t> GlobalPortGap;
     std::shared_ptr<sql::Connection> LongConnection;
 
@@ -77,10 +87,10 @@ struct MppInfo {
     std::string Role;
     std::string InstanceName; // ID
     std::vector<std::string> ZoneList; // sub_cluster
-    std::string IsLeader;
+    bool IsLeader = false;
 
     MppInfo() {};
-    MppInfo(const std::string& tag, const std::string& role, const std::string& instance_name, const std::vector<std::string>& zone_list, const std::string& is_leader)
+    MppInfo(const std::string& tag, const std::string& role, const std::string& instance_name, const std::vector<std::string>& zone_list, bool is_leader)
         : Tag(tag), Role(role), InstanceName(instance_name), ZoneList(zone_list), IsLeader(is_leader) {};
 
     nlohmann::json to_json() const {
@@ -89,17 +99,17 @@ struct MppInfo {
             {"role", Role},
             {"instance_name", InstanceName},
             {"zone_list", ZoneList},
-            {"is_leader", IsLeader}
+            {"is_leader", IsLeader ? "Y" : "N"}
         };
     }
 
     static MppInfo from_json(const nlohmann::json &j) {
         MppInfo info;
-        info.Tag = j["tag"];
-        info.Role = j["role"];
-        info.InstanceName = j["instance_name"];
-        info.ZoneList = j["zone_list"];
-        info.IsLeader = j["is_leader"];
+        info.Tag = j.at("tag");
+        info.Role = j.at("role");
+        info.InstanceName = j.at("instance_name");
+        info.ZoneList = j.at("zone_list");
+        info.IsLeader = j.at("is_leader") == "Y";
         return info;
     }
 };
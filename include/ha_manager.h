@@ -4,8 +4,16 @@
 #include <shared_mutex>
 #include <unordered_map>
 #include <thread>
+#include <tuple>
 #include <condition_variable>
 #include "entity.hpp"
+#include "cn_selector.h"
+#include "node_table.h"
+#include "probe_executor.h"
+#include "probe_scheduler.h"
+#include "connect_admission.h"
+#include "waiter_registry.h"
+#include "warm_pool.h"
 #include "config.h"
 #include "logger.h"
 #include "const.hpp"
@@ -19,25 +27,44 @@
 namespace sql {
 namespace polardbx {
 
+// gives benchmarks and tests access to the private routing and probing functions
+struct HaManagerPeer;
+
 class HaManager {
+    friend struct HaManagerPeer;
+
 public:
     explicit HaManager(
         std::atomic<bool> is_dn,
         bool use_ipv6,
         uint32_t version,
         std::shared_ptr<PolarDBXConfig> p_cfg)
-        : is_dn_(is_dn), use_ipv6_(use_ipv6), version_(version), p_cfg_(p_cfg), dn_cluster_info_(std::make_shared<XClusterInfo>()), stop_flag_(false) {
+        : is_dn_(is_dn), use_ipv6_(use_ipv6), version_(version), p_cfg_(p_cfg), dn_cluster_info_(std::make_shared<XClusterInfo>()), stop_flag_(false),
+          ref_cnt_(0), idle_since_nanos_(now_nanos()), probe_scheduler_(p_cfg->HaProbeBudget),
+          connect_admission_(p_cfg->ConnectConcurrency, p_cfg->ConnectRate) {
             driver_logger_ = std::make_shared<Logger>("driver", BLUE);
             monitor_logger_ = std::make_shared<Logger>("monitor", GREEN);
             driver_logger_->setEnabled(p_cfg->EnableLog);
             monitor_logger_->setEnabled(p_cfg->EnableLog);
+            warm_pool_ = std::make_unique<WarmPool>(
+                [this](const std::string& addr, bool leader) { return is_routable(addr, leader); }, connect_admission_,
+                monitor_logger_);
         }
 
     ~HaManager(){
-        stop_flag_ = true;
+        {
+            std::lock_guard<std::mutex> lk(checker_mutex_);
+            stop_flag_ = true;
+        }
+        checker_cv_.notify_all();
         if (checker_thread_ && checker_thread_->joinable()) {
             checker_thread_->join();
         }
+        // probes and warm-up still running use the members below
+        cn_probe_executor_.reset();
+        dn_probe_executor_.reset();
+        warm_pool_.reset();
+        release_probe_lock();
     };
 
     static std::tuple<int, std::string, bool> get_cluster_id_and_version(std::shared_ptr<PolarDBXConfig> p_cfg);
@@ -47,21 +74,40 @@ public:
     static std::shared_mutex managers_rw_mutex_;
 
     std::pair<std::string, bool> get_available_dn_with_wait(int32_t timeoutMs, bool slaveOnly, 
-        int32_t applyDelayThreshold, int32_t slaveWeightThreshold, const std::string& loadBalanceAlgorithm);
+        int32_t applyDelayThreshold, int32_t slaveWeightThreshold, const std::string& loadBalanceAlgorithm,
+        ConnectClass cls = ConnectClass::NORMAL);
 
     std::pair<std::string, bool> get_available_cn_with_wait(int32_t timeoutMs, const std::string& zoneName, 
         int32_t minZoneNodes, const std::string& backupZoneName, bool slaveRead, const std::string& instanceName,
-        const std::string& mppRole, const std::string& loadBalanceAlgorithm);
+        const std::string& mppRole, const std::string& loadBalanceAlgorithm, ConnectClass cls = ConnectClass::NORMAL);
+    std::pair<std::string, bool> get_available_cn_with_wait(int32_t timeoutMs, const std::shared_ptr<const CnFilter>& filter,
+        const std::string& loadBalanceAlgorithm, ConnectClass cls = ConnectClass::NORMAL);
+
+    // live PolarDBX_Connection references, get_manager() hands out an acquired manager
+    bool acquire();
+    void release();
 
     void add_conn_count(const std::string& addr);
     void drop_conn_count(const std::string& addr);
+    // a client could not connect to addr, probe the cluster again soon
+    void report_node_error(const std::string& addr);
+    // a turn to handshake with one of the cluster's nodes, empty when deadline_nanos passed first
+    ConnectAdmission::Permit admit_connect(int64_t deadline_nanos, ConnectClass cls = ConnectClass::NORMAL) {
+        return connect_admission_.acquire(deadline_nanos, cls);
+    }
+    // a pre-established connection to addr for parsed, nullptr when warm-up is off or none is ready
+    std::unique_ptr<sql::Connection> take_warm_connection(const std::shared_ptr<const ParsedOptions>& parsed,
+        const sql::ConnectOptionsMap& options, const std::string& addr);
     bool is_dn() {return is_dn_;};
+    // bumped whenever the DN leader or the CN view changes
+    uint64_t topology_epoch() const { return topology_epoch_.load(); }
+    std::string cluster_tag() const;
 
 private:
     std::shared_mutex rw_mutex_;
-    std::mutex mutex_;
     static std::mutex driver_mutex_;
-    std::condition_variable conn_req_;
+    // connects waiting for a node, keyed "dn:..." and "cn:..." by what they route to
+    WaiterRegistry waiters_;
 
     bool is_dn_;
     bool use_ipv6_;
@@ -70,19 +116,89 @@ private:
     std::shared_ptr<PolarDBXConfig> p_cfg_;
     std::shared_ptr<XClusterInfo> dn_cluster_info_;
     std::vector<std::shared_ptr<MppInfo>> cn_cluster_info_;
+    // bumped under rw_mutex_ whenever cn_cluster_info_ is replaced
+    std::atomic<uint64_t> cn_topology_version_{0};
+    // leader and CN view the current topology epoch was taken for, under rw_mutex_
+    std::atomic<uint64_t> topology_epoch_{0};
+    std::string epoch_leader_;
+    size_t epoch_cn_view_ = 0;
+    std::shared_mutex cn_selector_mutex_;
+    std::shared_ptr<const CnTopology> cn_topology_;
+    std::unordered_map<std::shared_ptr<const CnFilter>, std::shared_ptr<const CnSelector>, CnFilterHash, CnFilterEqual> cn_selectors_;
     std::vector<std::string> connection_addresses_;
-    std::unordered_map<std::string, std::atomic<int64_t>> conn_cnt_;
+    // every node seen so far, also holds the per-node connection counts
+    NodeTable node_table_;
     std::atomic<bool> stop_flag_;
     std::shared_ptr<std::thread> checker_thread_;
+    std::mutex checker_mutex_;
+    std::condition_variable checker_cv_;
+    bool checker_wakeup_ = false;
+    // -1 once the manager is retired and waiting to be swept from managers_
+    std::atomic<int64_t> ref_cnt_;
+    std::atomic<int64_t> idle_since_nanos_;
+    ProbeScheduler probe_scheduler_;
+    ConnectAdmission connect_admission_;
+    std::unique_ptr<WarmPool> warm_pool_;
+    // CN seeds are probed on cn_probe_executor_ in order of their health
+    struct SeedHealth {
+        int32_t Failures = 0;
+        int64_t LatencyNanos = 0;
+    };
+    std::unique_ptr<ProbeExecutor> cn_probe_executor_;
+    // runs suspect leader confirmations, which may overrun the suspect window
+    std::unique_ptr<ProbeExecutor> dn_probe_executor_;
+    std::mutex cn_seed_mutex_;
+    std::unordered_map<std::string, SeedHealth> cn_seed_health_;
+    // long-lived show mpp connection per seed, reconnected with backoff when it breaks
+    struct CnProbeConnection {
+        std::mutex Mutex;
+        std::unique_ptr<sql::Connection> Conn;
+        int32_t BackoffMillis = 0;
+        int64_t RetryAfterNanos = 0;
+    };
+    std::unordered_map<std::string, std::shared_ptr<CnProbeConnection>> cn_probe_conns_;
+    size_t dn_file_digest_ = 0;
+    size_t mpp_file_digest_ = 0;
+
+    // host-local probing: only the process holding the lock file probes the cluster,
+    // the others follow the topology it publishes to JsonFile
+    int probe_lock_fd_ = -1;
+    // mtime, inode and size of the last topology file read from the prober
+    using TopologyFileStamp = std::tuple<int64_t, int64_t, int64_t>;
+    TopologyFileStamp topology_file_stamp_{};
 
     std::shared_ptr<Logger> driver_logger_;
     std::shared_ptr<Logger> monitor_logger_;
 
+    // identifies a show mpp view regardless of row order
+    static size_t mpp_view_digest(const std::vector<std::shared_ptr<MppInfo>>& infos);
+    // moves topology_epoch_ on when leader_tag or the CN view digest changed, under rw_mutex_
+    void advance_epoch_locked(const std::string& leader_tag, size_t cn_view);
+    static int64_t now_nanos() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    bool idle_for(int32_t millis);
+    bool try_retire();
+    int32_t adjust_interval_for_idle(int32_t interval);
+    void wait_for_next_check(int32_t interval);
+
     void dn_ha_checker();
     void cn_ha_checker();
     int32_t ping_leader(const std::shared_ptr<XClusterNodeBasic> &leader, std::shared_ptr<sql::Connection> conn);
+    // LEADER_ALIVE, LEADER_TRANSFERRED or LEADER_TRANSFERRING as reported on conn, throws when it fails
+    static int32_t query_leader_state(sql::Connection &conn);
+    std::shared_ptr<sql::Connection> open_long_connection(const std::string &addr);
+    int32_t confirm_suspect_leader(const std::shared_ptr<XClusterNodeBasic> &suspect);
+    bool is_routable(const std::string& addr, bool leader);
+    void install_leader(const std::shared_ptr<XClusterNodeBasic> &leader, std::shared_ptr<sql::Connection> conn);
     int32_t fully_check();
     std::vector<std::shared_ptr<MppInfo>> get_mpp_info(const std::string &addr) noexcept;
+    std::vector<std::shared_ptr<MppInfo>> query_mpp_info(sql::Connection &conn);
+    std::vector<std::shared_ptr<MppInfo>> get_all_mpp_info_concurrent(const std::vector<std::string> &addresses);
+    std::vector<std::string> order_cn_seeds(const std::vector<std::string> &addresses);
+    void record_cn_seed(const std::string &addr, bool ok, int64_t latency_nanos);
+    // drops the health and the probe connection of seeds no longer in addresses
+    void forget_cn_seeds(const std::vector<std::string> &addresses);
     std::vector<std::string> get_zone_list(const std::string& zone_names);
     bool probe_and_update_leader();
     void update_connection_addresses();
@@ -93,6 +209,12 @@ private:
     bool save_dn_to_file(const std::vector<std::shared_ptr<XClusterNodeBasic>>& nodes, const std::string& filename) noexcept;
     bool save_mpp_to_file(const std::vector<std::shared_ptr<MppInfo>>& mpp, const std::string& filename) noexcept;
     std::pair<std::vector<std::shared_ptr<MppInfo>>, bool> load_mpp_from_file(const std::string& filename) noexcept;
+    bool write_file_atomically(const std::string& content, const std::string& filename) noexcept;
+    bool hold_probe_lock() noexcept;
+    void release_probe_lock() noexcept;
+    bool topology_file_changed() noexcept;
+    void sync_dn_from_file();
+    void sync_mpp_from_file();
 
     std::pair<std::string, bool> get_available_dn_internal(bool slaveOnly, int32_t applyDelayThreshold, 
         int32_t slaveWeightThreshold, const std::string& loadBalanceAlgorithm);
@@ -100,9 +222,13 @@ private:
     std::pair<std::string, bool> get_available_cn_internal(const std::string& zoneName, int32_t minZoneNodes,
         const std::string& backupZoneName, bool slaveRead, const std::string& instanceName,
         const std::string& mppRole, const std::string& loadBalanceAlgorithm);
+    std::pair<std::string, bool> get_available_cn_internal(const std::shared_ptr<const CnFilter>& filter,
+        const std::string& loadBalanceAlgorithm);
+    std::shared_ptr<const CnSelector> get_cn_selector(const std::shared_ptr<const CnFilter>& filter);
     
     std::string get_dn_follower(const std::string& leader, int32_t applyDelayThreshold, int32_t slaveWeightThreshold, const std::string& loadBalanceAlgorithm);
-    std::string get_node_with_load_balance(const std::set<std::string>& candidates, const std::string& loadBalanceAlgorithm);
+    // candidates are in tag order
+    std::string get_node_with_load_balance(const std::vector<NodeId>& candidates, const std::string& loadBalanceAlgorithm);
 };
 
 inline std::string gen_cluster_tag(int cluster_id, const std::string& addr) {
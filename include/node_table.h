@@ -0,0 +1,109 @@
+#ifndef NODE_TABLE_H
+#define NODE_TABLE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "entity.hpp"
+
+namespace sql {
+namespace polardbx {
+
+// Index of a node in its manager's NodeTable, stable for the lifetime of the manager.
+using NodeId = uint32_t;
+constexpr NodeId INVALID_NODE = UINT32_MAX;
+
+enum class NodeRole : uint8_t {
+    UNKNOWN = 0,
+    // DN roles as reported by alisql_cluster_local / alisql_cluster_global
+    LEADER,
+    FOLLOWER,
+    LEARNER,
+    LOGGER,
+    // CN roles as reported by show mpp
+    CN_W,
+    CN_R,
+    CN_CR,
+};
+
+NodeRole parse_dn_role(const std::string& role);
+NodeRole parse_cn_role(const std::string& role);
+
+// IPv4 / IPv6 address and port of a node, Family is 0 when the tag is a host name.
+struct PackedAddr {
+    std::array<uint8_t, 16> Ip{};
+    uint16_t Port = 0;
+    uint8_t Family = 0;
+
+    static PackedAddr parse(const std::string& tag);
+};
+
+// Every DN or CN a manager has ever seen, interned by tag. Probes update records in
+// place, routing and connection counters work on NodeIds and never hash a tag.
+//
+// Records are never freed or moved, so tag() and the counters need no lock; role,
+// timestamps and peers are refreshed by the checker thread.
+class NodeTable {
+public:
+    NodeTable();
+    ~NodeTable();
+    NodeTable(const NodeTable&) = delete;
+    NodeTable& operator=(const NodeTable&) = delete;
+
+    // id of tag, created on first sight; INVALID_NODE once the table is full
+    NodeId intern(const std::string& tag);
+    // INVALID_NODE when tag was never interned
+    NodeId find(const std::string& tag) const;
+    size_t size() const { return size_.load(std::memory_order_acquire); }
+
+    const std::string& tag(NodeId id) const { return node(id).Tag; }
+    const PackedAddr& addr(NodeId id) const { return node(id).Addr; }
+    NodeRole role(NodeId id) const { return node(id).Role.load(std::memory_order_relaxed); }
+    int64_t update_nanos(NodeId id) const { return node(id).UpdateNanos.load(std::memory_order_relaxed); }
+    std::vector<NodeId> peers(NodeId id) const;
+
+    int64_t conn_count(NodeId id) const { return node(id).ConnCount.load(std::memory_order_relaxed); }
+    void add_conn(NodeId id) { node(id).ConnCount.fetch_add(1, std::memory_order_relaxed); }
+    void drop_conn(NodeId id) { node(id).ConnCount.fetch_sub(1, std::memory_order_relaxed); }
+
+    // record a probe round, peers of each node are replaced by the ones it reported
+    void update_dn(const std::vector<std::shared_ptr<XClusterNodeBasic>>& nodes);
+    void update_cn(const std::vector<std::shared_ptr<MppInfo>>& cns, int64_t update_nanos);
+
+private:
+    struct Node {
+        std::string Tag;
+        PackedAddr Addr;
+        std::atomic<NodeRole> Role{NodeRole::UNKNOWN};
+        std::atomic<int64_t> UpdateNanos{0};
+        std::atomic<int64_t> ConnCount{0};
+        // span of peer_index_, guarded by mutex_
+        uint32_t PeerBegin = 0;
+        uint32_t PeerCount = 0;
+    };
+
+    static constexpr uint32_t CHUNK_BITS = 6;
+    static constexpr uint32_t CHUNK_SIZE = 1u << CHUNK_BITS;
+    static constexpr uint32_t MAX_CHUNKS = 1024;
+
+    Node& node(NodeId id) const {
+        return chunks_[id >> CHUNK_BITS].load(std::memory_order_acquire)[id & (CHUNK_SIZE - 1)];
+    }
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, NodeId> ids_;
+    // fixed chunks so a reader never sees a record move while the table grows
+    std::array<std::atomic<Node*>, MAX_CHUNKS> chunks_;
+    std::atomic<uint32_t> size_{0};
+    std::vector<NodeId> peer_index_;
+};
+
+} // namespace polardbx
+} // namespace sql
+
+#endif // NODE_TABLE_H
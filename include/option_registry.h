@@ -0,0 +1,49 @@
+#ifndef OPTION_REGISTRY_H
+#define OPTION_REGISTRY_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include "config.h"
+
+namespace sql {
+namespace polardbx {
+
+enum class OptionType { INT32, BOOL, STRING };
+
+// Result of parsing one ConnectOptionsMap. Instances are shared between every
+// connect that passes an equal map, so they must not be modified after parsing.
+struct ParsedOptions {
+    std::shared_ptr<PolarDBXConfig> p_cfg;
+    std::shared_ptr<ConnectionConfig> c_cfg;
+    bool DirectMode = false;
+    bool RecordJdbcUrl = false;
+    // only built when RecordJdbcUrl is set
+    std::string JdbcUrl;
+    // the equivalent options map, only filled when parsed from a dsn
+    sql::ConnectOptionsMap ConnectOptions;
+    // identifies the options map contents, equal for every parse of an equal map;
+    // empty when some value cannot be represented
+    std::string CacheKey;
+};
+
+struct OptionSpec {
+    std::string_view name;
+    OptionType type;
+    void (*assign)(ParsedOptions& parsed, const sql::ConnectPropertyVal& val);
+    // nullptr for options that are not recorded in the jdbc url
+    void (*serialize)(const ParsedOptions& parsed, std::string& out);
+};
+
+const OptionSpec* find_option(std::string_view name);
+
+std::shared_ptr<const ParsedOptions> parse_connect_options(const sql::ConnectOptionsMap& options);
+
+// polardbx://[user[:password]@]host[:port][,host[:port]...][/schema][?key=value[&key=value...]]
+// user, password and values may be percent-encoded.
+std::shared_ptr<const ParsedOptions> parse_dsn(const std::string& dsn);
+
+} // namespace polardbx
+} // namespace sql
+
+#endif // OPTION_REGISTRY_H
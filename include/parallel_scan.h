@@ -0,0 +1,88 @@
+#ifndef PARALLEL_SCAN_H
+#define PARALLEL_SCAN_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "polardbx_connection.h"
+#include "row_cursor.h"
+
+namespace sql {
+namespace polardbx {
+
+// Runs the pieces of a partitioned scan concurrently, each on its own connection
+// routed by the usual CN filter (zoneName, mppRole, ...) and load balancing, and merges
+// their rows. At most parallelism pieces are open at a time.
+//
+// ORDERED returns all rows of the first piece, then of the second, and so on; later
+// pieces read ahead into their cursors meanwhile. UNORDERED returns rows as they arrive.
+class ParallelScan {
+public:
+    enum class Merge { ORDERED, UNORDERED };
+
+    static constexpr const char* PARTITION_PLACEHOLDER = "{partition}";
+
+    // one query per predicate, every PARTITION_PLACEHOLDER in query_template replaced by it
+    static std::vector<std::string> expand(const std::string& query_template,
+        const std::vector<std::string>& predicates);
+
+    // options are those of a normal connect; without a loadBalanceAlgorithm the pieces
+    // use least_connection so they spread over the CNs
+    ParallelScan(const sql::ConnectOptionsMap& options, std::vector<std::string> queries,
+        size_t parallelism, Merge merge);
+    ~ParallelScan();
+    ParallelScan(const ParallelScan&) = delete;
+    ParallelScan& operator=(const ParallelScan&) = delete;
+
+    // the next row, false once every piece was read; rethrows the first error of any piece
+    bool next(RowCursor::Row& row);
+    // column labels of the pieces, empty until next() returned the first row
+    const std::vector<std::string>& columns() const { return columns_; }
+    void close();
+
+private:
+    struct Piece {
+        // closes the connection, which gives its CN back to least_connection, whether
+        // the piece was read to the end, failed or was abandoned
+        ~Piece();
+
+        // declared first, the cursor has to go before its connection
+        std::unique_ptr<PolarDBX_Connection> Conn;
+        std::unique_ptr<RowCursor> Cursor;
+    };
+
+    void work();
+    std::unique_ptr<Piece> open(size_t index);
+    void fail(const sql::SQLException& e);
+
+    sql::ConnectOptionsMap options_;
+    std::vector<std::string> queries_;
+    Merge merge_;
+    std::vector<std::string> columns_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    size_t next_piece_ = 0;
+    size_t finished_ = 0;
+    std::optional<sql::SQLException> error_;
+    // ORDERED: opened pieces by index, the consumer reads pieces_[current_]
+    std::vector<std::unique_ptr<Piece>> pieces_;
+    size_t current_ = 0;
+    // pieces opened ahead of the consumer in ORDERED mode
+    size_t window_ = 1;
+    // UNORDERED: rows of all pieces
+    std::deque<RowCursor::Row> rows_;
+    size_t max_rows_;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace polardbx
+} // namespace sql
+
+#endif // PARALLEL_SCAN_H
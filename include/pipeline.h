@@ -0,0 +1,60 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "jdbc/cppconn/exception.h"
+#include "jdbc/cppconn/resultset.h"
+#include "jdbc/cppconn/sqlstring.h"
+#include "jdbc/cppconn/statement.h"
+
+namespace sql {
+namespace polardbx {
+
+class PolarDBX_Connection;
+
+// Outcome of one pipelined statement.
+struct PipelineResult {
+    // the statement Rows were read from, declared first so it is closed after them
+    std::shared_ptr<sql::Statement> Source;
+    // rows of a statement that returned a result set, nullptr otherwise
+    std::unique_ptr<sql::ResultSet> Rows;
+    uint64_t UpdateCount = 0;
+    // the statement failed, or was not run because an earlier one failed
+    std::optional<sql::SQLException> Error;
+
+    bool ok() const { return !Error.has_value(); }
+};
+
+// Statements queued on one connection and sent together. With allowMultiQueries the
+// whole queue goes out as one multi-statement packet, one round trip for all of them;
+// without it they run one after the other. Either way the first failing statement
+// stops the pipeline and the ones after it report that they were not run.
+class Pipeline {
+public:
+    Pipeline(PolarDBX_Connection* conn, bool multi_statements);
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    // queues a single statement, a trailing semicolon is dropped. With allowMultiQueries a
+    // statement holding another ';', even in a literal or comment, or an unclosed quote or
+    // comment is rejected, it would change how a proxy splitting the packet naively splits it
+    void add(const sql::SQLString& sql);
+    size_t size() const { return queued_.size(); }
+    void clear() { queued_.clear(); }
+    // one result per queued statement, in order; the queue is empty afterwards
+    std::vector<PipelineResult> execute();
+
+private:
+    PolarDBX_Connection* conn_;
+    bool multi_statements_;
+    std::vector<std::string> queued_;
+};
+
+} // namespace polardbx
+} // namespace sql
+
+#endif // PIPELINE_H
@@ -3,8 +3,16 @@
 
 #include "jdbc/cppconn/connection.h"
 #include "ha_manager.h"
+#include "option_registry.h"
+#include "statement_cache.h"
+#include "batch_statement.h"
+#include "pipeline.h"
+#include "row_cursor.h"
+#include "result_cache.h"
 #include <jdbc/mysql_driver.h>
+#include <map>
 #include <memory>
+#include <optional>
 
 namespace sql
 {
@@ -23,6 +31,9 @@ public:
   PolarDBX_Connection(Driver * _driver,
           std::map< sql::SQLString, sql::ConnectPropertyVal > & options);
 
+  PolarDBX_Connection(Driver * _driver,
+          std::shared_ptr<const ParsedOptions> parsed);
+
   virtual ~PolarDBX_Connection();
 
   void clearWarnings();
@@ -77,6 +88,33 @@ public:
 
   sql::PreparedStatement * prepareStatement(const sql::SQLString& sql, sql::SQLString columnNames[]);
 
+  // server side prepared statement for sql from this connection's cache (prepStmtCacheSize),
+  // with its parameters cleared; the connection owns it, do not delete it
+  CachedStatement prepareCachedStatement(const sql::SQLString& sql);
+
+  // addBatch/executeBatch for sql, rows of a single-row INSERT/REPLACE go out as multi-row statements
+  std::unique_ptr<BatchStatement> prepareBatch(const sql::SQLString& sql);
+
+  // statements queued and sent in one packet when the connection has allowMultiQueries
+  std::unique_ptr<Pipeline> pipeline();
+
+  // rows of sql streamed with at most streamBufferSize bytes read ahead; the connection
+  // is pinned to its node and takes no other call that uses the session until the cursor
+  // is drained or closed. Closing it early reads out the rest first, see RowCursor::close
+  // and bound the query when it may be abandoned.
+  std::unique_ptr<RowCursor> executeStreaming(const sql::SQLString& sql);
+
+  // result of a read query from the driver's result cache (resultCacheSize, resultCacheTtl),
+  // keyed by normalized sql, schema, user, charset options and the session variables set
+  // through this object; runs the query on a miss or when the cache is off. With the cache
+  // on, writes through createStatement/prepareStatement statements, commit and rollback
+  // drop the cluster's cached results
+  std::shared_ptr<const CachedResult> executeCachedQuery(const sql::SQLString& sql);
+
+  // a write went around the driver's statements, e.g. through a prepareCachedStatement
+  // handle or a SQL SET of the session, drop the cluster's cached results
+  void invalidateResultCache();
+
   void releaseSavepoint(Savepoint * savepoint);
 
   void rollback();
@@ -119,10 +157,39 @@ private:
   sql::Connection * real_conn;
   std::shared_ptr<HaManager> ha_manager_;
   std::string conn_addr_;
+  // kept to re-route to a new leader on reconnect, nullptr for host/user/password connections;
+  // options_ holds the credentials for that handshake, as the connector keeps its own for reconnect()
+  std::shared_ptr<const ParsedOptions> parsed_;
+  sql::ConnectOptionsMap options_;
+  // session state set through this object, applied again on the connection a re-route moves to,
+  // like schema_ below; state changed by SQL statements and an open transaction do not survive it
+  std::optional<bool> autocommit_;
+  std::optional<enum_transaction_isolation> isolation_;
+  std::optional<bool> read_only_;
+  std::map<std::string, std::string> session_vars_;
+  StatementCache stmt_cache_;
+  bool multi_statements_ = false;
+  size_t stream_buffer_bytes_ = 0;
+  // the open streaming cursor, nullptr when none
+  RowCursor * cursor_ = nullptr;
+  // cache key parts: the cluster, empty when the cache is off, the user and charset options,
+  // and the schema set through the driver
+  std::string cache_cluster_;
+  std::string cache_session_;
+  std::string schema_;
+  int32_t result_cache_bytes_ = 0;
+  int32_t result_cache_ttl_ = 0;
 
   /* Prevent use of these */
   PolarDBX_Connection(const PolarDBX_Connection &);
   void operator=(PolarDBX_Connection &);
+  void connect(const std::shared_ptr<const ParsedOptions> & parsed, sql::ConnectOptionsMap & options);
+  bool reroute();
+  ConnectAdmission::Permit admit_connect(const std::string & addr, int64_t deadline_nanos, ConnectClass cls);
+  void check_not_streaming();
+  sql::Statement * tracked(sql::Statement * stmt);
+  sql::PreparedStatement * tracked(sql::PreparedStatement * stmt, const sql::SQLString & sql);
+  void init_result_cache(const std::shared_ptr<ConnectionConfig> & c_cfg, const sql::ConnectOptionsMap & options);
   void recordJDBCURL(const std::string & jdbc_url, sql::Connection * conn);
   void enableFollowerRead(int followerReadState, sql::Connection * conn);
 };
@@ -45,9 +45,13 @@
 
 #include "jdbc/cppconn/driver.h"
 #include "jdbc/cppconn/sqlstring.h"
+#include "result_cache.h"
 
+#include <list>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <unordered_map>
 
 extern "C"
 {
@@ -57,6 +61,8 @@ CPPCONN_PUBLIC_FUNC void * sql_polardbx_get_driver_instance();
 namespace sql {
 namespace polardbx {
 
+struct ParsedOptions;
+
 class CPPCONN_PUBLIC_FUNC PolarDBX_Driver : public Driver
 {
 
@@ -74,6 +80,9 @@ public:
 
     Connection* connect(ConnectOptionsMap& properties) override;
 
+    // polardbx://[user[:password]@]host[:port][,host[:port]...][/schema][?key=value[&key=value...]]
+    Connection* connect(const SQLString& dsn);
+
     int getMajorVersion() override;
 
     int getMinorVersion() override;
@@ -90,12 +99,25 @@ public:
 
     void threadEnd() override {};
 
+    // read results shared by every connection of this driver, see executeCachedQuery
+    ResultCache& result_cache() { return result_cache_; }
+
 private:
     PolarDBX_Driver(const PolarDBX_Driver&) = delete;
     void operator=(const PolarDBX_Driver&) = delete;
 
     static std::unique_ptr<PolarDBX_Driver> instance;
     static std::mutex init_mutex;
+
+    std::shared_ptr<const ParsedOptions> get_parsed_dsn(const std::string& dsn);
+
+    // parsed dsn configs, most recently used first
+    static constexpr size_t DSN_CACHE_CAPACITY = 128;
+    std::mutex dsn_cache_mutex_;
+    std::list<std::pair<std::string, std::shared_ptr<const ParsedOptions>>> dsn_lru_;
+    std::unordered_map<std::string, decltype(dsn_lru_)::iterator> dsn_index_;
+
+    ResultCache result_cache_;
 };
 
 CPPCONN_PUBLIC_FUNC sql::polardbx::PolarDBX_Driver * _get_driver_instance_by_name(const char * const clientlib);
@@ -0,0 +1,41 @@
+#ifndef PROBE_EXECUTOR_H
+#define PROBE_EXECUTOR_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sql {
+namespace polardbx {
+
+// Fixed pool of threads running HA probes, so a cycle against many (possibly dead)
+// nodes never spawns more than max_threads connects at once. Tasks still queued when
+// the executor is destroyed are dropped, running ones are waited for.
+class ProbeExecutor {
+public:
+    explicit ProbeExecutor(size_t max_threads);
+    ~ProbeExecutor();
+    ProbeExecutor(const ProbeExecutor&) = delete;
+    ProbeExecutor& operator=(const ProbeExecutor&) = delete;
+
+    void submit(std::function<void()> task);
+
+private:
+    void run();
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> tasks_;
+    std::vector<std::thread> threads_;
+    size_t max_threads_;
+    size_t idle_ = 0;
+    bool stop_ = false;
+};
+
+} // namespace polardbx
+} // namespace sql
+
+#endif // PROBE_EXECUTOR_H
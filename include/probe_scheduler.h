@@ -0,0 +1,47 @@
+#ifndef PROBE_SCHEDULER_H
+#define PROBE_SCHEDULER_H
+
+#include <cstdint>
+#include <mutex>
+#include <random>
+
+namespace sql {
+namespace polardbx {
+
+// Interval range of one cluster state: the first probe after entering the state
+// waits FloorMillis, each further probe in the same state doubles up to CeilingMillis.
+struct ProbeCadence {
+    int32_t FloorMillis;
+    int32_t CeilingMillis;
+};
+
+// Picks the delay before a manager's next HA probe. Backs off while the state stays
+// the same, restarts from the floor when it changes or a client reports an error,
+// jitters every delay so processes started together drift apart, and never exceeds
+// budget probes per second, which also stops a flapping state from spinning.
+class ProbeScheduler {
+public:
+    explicit ProbeScheduler(int32_t budget_per_second);
+
+    // delay in ms before the next probe, the last one ended in state
+    int32_t next_interval(int32_t state, const ProbeCadence& cadence);
+    // the next interval starts from the floor again; false when already tightened or
+    // out of budget, the caller should not wake the checker early then
+    bool tighten();
+
+private:
+    std::mutex mutex_;
+    int32_t last_state_ = -1;
+    int32_t backoff_millis_ = 0;
+    bool tightened_ = false;
+    int32_t budget_;
+    // token bucket holding up to budget_ probes
+    double tokens_;
+    int64_t refill_nanos_;
+    std::mt19937 rng_;
+};
+
+} // namespace polardbx
+} // namespace sql
+
+#endif // PROBE_SCHEDULER_H
@@ -0,0 +1,68 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "row_cursor.h"
+
+namespace sql {
+namespace polardbx {
+
+// A fully read result, shared by every hit on its cache entry.
+struct CachedResult {
+    std::vector<std::string> Columns;
+    std::vector<RowCursor::Row> Rows;
+    size_t Bytes = 0;
+};
+
+// Results of read queries, shared by all connections of a driver and bounded in bytes.
+// An entry belongs to a cluster and is dropped when its TTL passes, when the cluster's
+// topology epoch moves on (leader or CN view changed), or when a write went through the
+// driver to that cluster.
+class ResultCache {
+public:
+    // whitespace runs outside quoted text folded to one space, trailing ';' dropped
+    static std::string normalize(const std::string& sql);
+    // sql starts with a statement that cannot change data, everything else invalidates
+    static bool is_read(const std::string& sql);
+
+    // snapshot to pass to put(), taken before the query runs so a write racing
+    // with it keeps its result out of the cache
+    uint64_t write_generation(const std::string& cluster);
+    std::shared_ptr<const CachedResult> get(const std::string& cluster, const std::string& key, uint64_t epoch);
+    void put(const std::string& cluster, const std::string& key, uint64_t epoch, uint64_t generation,
+        int64_t ttl_millis, size_t capacity_bytes, std::shared_ptr<const CachedResult> result);
+    // a write reached cluster, none of its entries may be served anymore
+    void invalidate(const std::string& cluster);
+    size_t bytes();
+
+private:
+    struct Entry {
+        std::string Key;
+        std::string Cluster;
+        uint64_t Epoch;
+        uint64_t Generation;
+        int64_t ExpireNanos;
+        std::shared_ptr<const CachedResult> Result;
+    };
+    using Lru = std::list<Entry>;
+
+    void erase(Lru::iterator it);
+
+    std::mutex mutex_;
+    // most recently used first
+    Lru lru_;
+    std::unordered_map<std::string, Lru::iterator> index_;
+    std::unordered_map<std::string, uint64_t> generations_;
+    size_t bytes_ = 0;
+};
+
+} // namespace polardbx
+} // namespace sql
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,70 @@
+#ifndef ROW_CURSOR_H
+#define ROW_CURSOR_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "jdbc/cppconn/exception.h"
+#include "jdbc/cppconn/resultset.h"
+#include "jdbc/cppconn/statement.h"
+
+namespace sql {
+namespace polardbx {
+
+// Rows of an unbuffered (TYPE_FORWARD_ONLY) result set, read ahead by a reader thread
+// into a buffer of at most buffer_bytes. When the buffer is full the reader stops
+// reading the socket, so the server is held back by TCP instead of the client growing
+// without bound. The connection the rows come from is pinned until the cursor is
+// drained or closed.
+class RowCursor {
+public:
+    // column values, std::nullopt for SQL NULL
+    using Row = std::vector<std::optional<std::string>>;
+
+    // on_close runs once, when the cursor no longer uses the connection
+    RowCursor(std::unique_ptr<sql::Statement> stmt, std::unique_ptr<sql::ResultSet> res,
+        size_t buffer_bytes, std::function<void()> on_close);
+    ~RowCursor();
+    RowCursor(const RowCursor&) = delete;
+    RowCursor& operator=(const RowCursor&) = delete;
+
+    const std::vector<std::string>& columns() const { return columns_; }
+    // waits for the next row, false once all rows were read; rethrows a read error
+    bool next(Row& row);
+    // stops reading ahead and discards the rows not taken yet. The session can take the
+    // next command only once the rest of the result is read off it, so close() blocks
+    // until the server has sent every remaining row; the connection's close() does too,
+    // it closes the cursor first. A result that may be abandoned early should be bounded
+    // in the query (LIMIT) rather than relying on close().
+    void close();
+
+private:
+    void read_ahead();
+    void release();
+
+    std::unique_ptr<sql::Statement> stmt_;
+    std::unique_ptr<sql::ResultSet> res_;
+    std::vector<std::string> columns_;
+    size_t buffer_bytes_;
+    std::function<void()> on_close_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::pair<size_t, Row>> buffer_;
+    size_t buffered_ = 0;
+    bool done_ = false;
+    bool stop_ = false;
+    std::optional<sql::SQLException> error_;
+    std::thread reader_;
+};
+
+} // namespace polardbx
+} // namespace sql
+
+#endif // ROW_CURSOR_H
@@ -0,0 +1,92 @@
+#ifndef STATEMENT_CACHE_H
+#define STATEMENT_CACHE_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "jdbc/cppconn/connection.h"
+#include "jdbc/cppconn/prepared_statement.h"
+
+namespace sql {
+namespace polardbx {
+
+class StatementCache;
+
+// Handle to a cached prepared statement, checked out of the cache while the handle lives.
+// It stays valid across re-routes of the owning connection: the statement is prepared
+// again on the new physical connection the first time the handle is used after one.
+// Must not outlive the connection it came from.
+class CachedStatement {
+public:
+    CachedStatement() = default;
+    ~CachedStatement();
+    CachedStatement(CachedStatement&& other) noexcept;
+    CachedStatement& operator=(CachedStatement&& other) noexcept;
+    CachedStatement(const CachedStatement&) = delete;
+    CachedStatement& operator=(const CachedStatement&) = delete;
+
+    sql::PreparedStatement* get() const;
+    sql::PreparedStatement* operator->() const { return get(); }
+    explicit operator bool() const { return entry_ != nullptr; }
+
+private:
+    friend class StatementCache;
+    struct Entry;
+    CachedStatement(StatementCache* cache, std::shared_ptr<Entry> entry)
+        : cache_(cache), entry_(std::move(entry)) {}
+
+    StatementCache* cache_ = nullptr;
+    std::shared_ptr<Entry> entry_;
+};
+
+// LRU of server side prepared statements of one physical connection, keyed by SQL text.
+// Not thread safe, like the connection owning it.
+class StatementCache {
+public:
+    explicit StatementCache(size_t capacity = 0) : capacity_(capacity) {}
+    ~StatementCache();
+    StatementCache(const StatementCache&) = delete;
+    StatementCache& operator=(const StatementCache&) = delete;
+
+    void set_capacity(size_t capacity);
+    // statements are prepared on conn from now on, the ones prepared on another connection are released
+    void attach(sql::Connection* conn);
+    // the statement for sql with its parameters cleared, prepared on a miss. While a handle
+    // for sql is still out, another one gets a statement of its own that is not cached.
+    CachedStatement get(const sql::SQLString& sql);
+    // closes every statement, call before the physical connection goes away or reconnects;
+    // handles prepare theirs again on next use
+    void release_statements();
+    size_t size() const { return lru_.size(); }
+
+private:
+    friend class CachedStatement;
+    using Entry = CachedStatement::Entry;
+
+    sql::PreparedStatement* prepare(Entry& entry);
+    CachedStatement uncached(std::shared_ptr<Entry> entry);
+    void evict();
+
+    size_t capacity_;
+    sql::Connection* conn_ = nullptr;
+    // most recently used first
+    std::list<std::shared_ptr<Entry>> lru_;
+    std::unordered_map<std::string, std::list<std::shared_ptr<Entry>>::iterator> index_;
+    // evicted entries that may still be held by a handle
+    std::vector<std::weak_ptr<Entry>> detached_;
+};
+
+struct CachedStatement::Entry {
+    std::string Sql;
+    // nullptr until prepared on the current physical connection
+    std::unique_ptr<sql::PreparedStatement> Stmt;
+    // a handle has it, parameters bound through that handle must not be cleared under it
+    bool CheckedOut = false;
+};
+
+} // namespace polardbx
+} // namespace sql
+
+#endif // STATEMENT_CACHE_H
@@ -0,0 +1,25 @@
+#ifndef TRACKED_STATEMENT_H
+#define TRACKED_STATEMENT_H
+
+#include <memory>
+#include <string>
+#include "jdbc/cppconn/prepared_statement.h"
+#include "jdbc/cppconn/statement.h"
+
+namespace sql {
+namespace polardbx {
+
+class PolarDBX_Connection;
+
+// Statements handed out by a connection with the result cache on. They forward to the
+// connector's statement and drop the cluster's cached results after anything but a read
+// ran through them, also when it failed, as rows may have changed before the failure.
+// getConnection() returns conn.
+sql::Statement* track_writes(PolarDBX_Connection* conn, std::unique_ptr<sql::Statement> stmt);
+sql::PreparedStatement* track_writes(PolarDBX_Connection* conn, std::unique_ptr<sql::PreparedStatement> stmt,
+    const std::string& sql);
+
+} // namespace polardbx
+} // namespace sql
+
+#endif // TRACKED_STATEMENT_H
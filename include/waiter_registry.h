@@ -0,0 +1,61 @@
+#ifndef WAITER_REGISTRY_H
+#define WAITER_REGISTRY_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include "config.h"
+
+namespace sql {
+namespace polardbx {
+
+// Connects waiting for a node, grouped by what they route to (the key). A waiter takes
+// a ticket before it tries to select a node and parks only if no notify for its key
+// came in between, an eventcount: nothing is lost although no lock is held across the
+// selection. A notify runs the key's selector once per parked waiter, in arrival order,
+// and hands each the node picked for it; the waiters the new topology cannot serve stay
+// parked. Waiters of a key without a selector are woken to select by themselves.
+// Within a key critical waiters are served before normal ones, normal before batch.
+class WaiterRegistry {
+public:
+    // picks a node for one waiter, empty when there is none
+    using Select = std::function<std::string()>;
+
+    uint64_t prepare(const std::string& key);
+    // parks until key is notified after ticket or until deadline_nanos (steady clock),
+    // returns the node handed over, empty when the caller has to select again
+    std::string wait(const std::string& key, uint64_t ticket, int64_t deadline_nanos, Select select,
+        ConnectClass cls = ConnectClass::NORMAL);
+    // the part of the topology the keys starting with prefix route to changed
+    void notify(const std::string& prefix);
+    size_t waiting();
+
+private:
+    struct Waiter {
+        std::condition_variable cv;
+        std::string node;
+        ConnectClass cls;
+        bool woken = false;
+    };
+    struct Entry {
+        uint64_t Seq;
+        Select Selector;
+        std::list<Waiter*> Waiters;
+    };
+
+    Entry& entry_locked(const std::string& key);
+
+    std::mutex mutex_;
+    uint64_t seq_ = 0;
+    // ordered, so the keys of a prefix are one range
+    std::map<std::string, Entry> entries_;
+};
+
+} // namespace polardbx
+} // namespace sql
+
+#endif // WAITER_REGISTRY_H
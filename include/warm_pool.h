@@ -0,0 +1,81 @@
+#ifndef WARM_POOL_H
+#define WARM_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include "connect_admission.h"
+#include "logger.h"
+#include "option_registry.h"
+#include "jdbc/cppconn/connection.h"
+
+namespace sql {
+namespace polardbx {
+
+// Pre-established, authenticated connections a manager keeps per connect options and
+// target, so a connect right after process start or a leader change skips the handshake.
+//
+// A pool is created by the first take() for its options and target, then refilled to
+// ConnectionConfig::WarmConnections by a maintainer thread. Leader pools follow the
+// leader; pools of nodes that are no longer routable are drained, pools nobody took
+// from for haIdleTimeout are dropped.
+class WarmPool {
+public:
+    // whether addr can still be routed to, leader is true for the DN leader role
+    using Routable = std::function<bool(const std::string& addr, bool leader)>;
+
+    WarmPool(Routable routable, ConnectAdmission& admission, std::shared_ptr<Logger> logger);
+    ~WarmPool();
+    WarmPool(const WarmPool&) = delete;
+    WarmPool& operator=(const WarmPool&) = delete;
+
+    // a warm connection to addr opened with options, nullptr when none is ready. A
+    // connection idle for longer than WARM_CONNECTION_VALIDATE_MILLIS is pinged first.
+    std::unique_ptr<sql::Connection> take(const std::shared_ptr<const ParsedOptions>& parsed,
+        const sql::ConnectOptionsMap& options, const std::string& addr, bool leader);
+    // leader pools drop their connections and warm up against the new leader
+    void retarget_leader(const std::string& leader);
+    void clear();
+
+private:
+    struct Pool {
+        std::shared_ptr<const ParsedOptions> Parsed;
+        sql::ConnectOptionsMap Options;
+        std::string Addr;
+        bool Leader = false;
+        // bumped whenever Addr changes, connections opened for an older one are discarded
+        uint64_t Generation = 0;
+        size_t Opening = 0;
+        int64_t LastTakenNanos = 0;
+        int64_t RetryAfterNanos = 0;
+        // oldest first, with the time each was opened
+        std::deque<std::pair<int64_t, std::unique_ptr<sql::Connection>>> Idle;
+    };
+    // ParsedOptions::CacheKey and the address; leader pools use an empty address,
+    // since theirs moves. Parsed instances are not unique per map, so not keyed by them
+    using Key = std::pair<std::string, std::string>;
+
+    void maintain();
+    void start_maintainer();
+
+    Routable routable_;
+    // warm-up handshakes queue with the clients' ones
+    ConnectAdmission& admission_;
+    std::shared_ptr<Logger> logger_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::map<Key, std::shared_ptr<Pool>> pools_;
+    std::unique_ptr<std::thread> maintainer_;
+};
+
+} // namespace polardbx
+} // namespace sql
+
+#endif // WARM_POOL_H
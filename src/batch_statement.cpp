@@ -0,0 +1,338 @@
+#include "batch_statement.h"
+#include "polardbx_connection.h"
+#include "const.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <strings.h>
+#include <jdbc/cppconn/resultset.h>
+#include <jdbc/cppconn/statement.h>
+
+namespace sql {
+namespace polardbx {
+
+namespace {
+
+struct Token {
+    enum Kind { WORD, PLACEHOLDER, LPAREN, RPAREN, SEMI, OTHER };
+    Kind kind;
+    size_t begin;
+    size_t end;
+    // parenthesis depth the token is at, an opening parenthesis counts at its outer depth
+    int depth;
+};
+
+bool is_word_char(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+}
+
+// tokens outside of comments, quoted strings and identifiers count as OTHER
+std::vector<Token> tokenize(const std::string& sql) {
+    std::vector<Token> tokens;
+    int depth = 0;
+    size_t i = 0;
+    size_t n = sql.size();
+    while (i < n) {
+        char c = sql[i];
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            i++;
+        } else if (c == '#' || (c == '-' && i + 1 < n && sql[i + 1] == '-' &&
+                                (i + 2 == n || std::isspace(static_cast<unsigned char>(sql[i + 2]))))) {
+            while (i < n && sql[i] != '\n') {
+                i++;
+            }
+        } else if (c == '/' && i + 1 < n && sql[i + 1] == '*') {
+            auto close = sql.find("*/", i + 2);
+            i = close == std::string::npos ? n : close + 2;
+        } else if (c == '\'' || c == '"' || c == '`') {
+            size_t begin = i++;
+            while (i < n) {
+                if (sql[i] == '\\' && c != '`') {
+                    i += 2;
+                } else if (sql[i] == c) {
+                    // a doubled quote stands for itself
+                    if (i + 1 < n && sql[i + 1] == c) {
+                        i += 2;
+                    } else {
+                        i++;
+                        break;
+                    }
+                } else {
+                    i++;
+                }
+            }
+            i = std::min(i, n);
+            tokens.push_back({Token::OTHER, begin, i, depth});
+        } else if (is_word_char(c)) {
+            size_t begin = i;
+            while (i < n && is_word_char(sql[i])) {
+                i++;
+            }
+            tokens.push_back({Token::WORD, begin, i, depth});
+        } else if (c == '?') {
+            tokens.push_back({Token::PLACEHOLDER, i, i + 1, depth});
+            i++;
+        } else if (c == '(') {
+            tokens.push_back({Token::LPAREN, i, i + 1, depth++});
+            i++;
+        } else if (c == ')') {
+            tokens.push_back({Token::RPAREN, i, i + 1, --depth});
+            i++;
+        } else if (c == ';') {
+            tokens.push_back({Token::SEMI, i, i + 1, depth});
+            i++;
+        } else {
+            tokens.push_back({Token::OTHER, i, i + 1, depth});
+            i++;
+        }
+    }
+    return tokens;
+}
+
+bool is_word(const std::string& sql, const Token& token, const char* word) {
+    return token.kind == Token::WORD && token.end - token.begin == strlen(word) &&
+           strncasecmp(sql.data() + token.begin, word, token.end - token.begin) == 0;
+}
+
+std::vector<std::string> split(const std::string& sql, size_t begin, size_t end, const std::vector<size_t>& placeholders) {
+    std::vector<std::string> pieces;
+    size_t from = begin;
+    for (auto pos : placeholders) {
+        if (pos >= begin && pos < end) {
+            pieces.push_back(sql.substr(from, pos - from));
+            from = pos + 1;
+        }
+    }
+    pieces.push_back(sql.substr(from, end - from));
+    return pieces;
+}
+
+} // namespace
+
+BatchTemplate parse_batch_template(const std::string& sql) {
+    BatchTemplate tmpl;
+    auto tokens = tokenize(sql);
+    std::vector<size_t> placeholders;
+    for (const auto& token : tokens) {
+        if (token.kind == Token::PLACEHOLDER) {
+            placeholders.push_back(token.begin);
+        }
+    }
+    tmpl.Pieces = split(sql, 0, sql.size(), placeholders);
+
+    if (tokens.empty() || !(is_word(sql, tokens[0], "INSERT") || is_word(sql, tokens[0], "REPLACE"))) {
+        return tmpl;
+    }
+    size_t values = 1;
+    while (values < tokens.size() &&
+           !(tokens[values].depth == 0 && (is_word(sql, tokens[values], "VALUES") || is_word(sql, tokens[values], "VALUE")))) {
+        values++;
+    }
+    size_t open = values + 1;
+    if (open >= tokens.size() || tokens[open].kind != Token::LPAREN || tokens[open].depth != 0) {
+        return tmpl;
+    }
+    size_t close = open + 1;
+    while (close < tokens.size() && !(tokens[close].kind == Token::RPAREN && tokens[close].depth == 0)) {
+        close++;
+    }
+    if (close >= tokens.size()) {
+        return tmpl;
+    }
+    // a second tuple, ON DUPLICATE KEY UPDATE or a row alias would not survive the rewrite
+    for (size_t i = close + 1; i < tokens.size(); i++) {
+        if (tokens[i].kind != Token::SEMI) {
+            return tmpl;
+        }
+    }
+    auto tuple_begin = tokens[open].begin;
+    auto tuple_end = tokens[close].end;
+    for (auto pos : placeholders) {
+        if (pos < tuple_begin || pos >= tuple_end) {
+            return tmpl;
+        }
+    }
+
+    tmpl.MultiRow = true;
+    tmpl.Head = sql.substr(0, tuple_begin);
+    tmpl.RowPieces = split(sql, tuple_begin, tuple_end, placeholders);
+    return tmpl;
+}
+
+BatchStatement::BatchStatement(PolarDBX_Connection* conn, const sql::SQLString& sql)
+    : conn_(conn), template_(parse_batch_template(sql)) {
+    params_.resize(template_.param_count());
+    bound_.resize(template_.param_count(), false);
+}
+
+void BatchStatement::set(unsigned int parameterIndex, std::string literal) {
+    if (parameterIndex == 0 || parameterIndex > params_.size()) {
+        throw sql::InvalidArgumentException("parameter index " + std::to_string(parameterIndex) + " out of range");
+    }
+    params_[parameterIndex - 1] = std::move(literal);
+    bound_[parameterIndex - 1] = true;
+}
+
+std::string BatchStatement::quote(const std::string& value) {
+    std::string escaped = conn_->escapeString(value);
+    std::string literal;
+    literal.reserve(escaped.size() + 2);
+    literal += '\'';
+    literal += escaped;
+    literal += '\'';
+    return literal;
+}
+
+void BatchStatement::setBigInt(unsigned int parameterIndex, const sql::SQLString& value) {
+    std::string digits = value;
+    size_t i = (!digits.empty() && (digits[0] == '-' || digits[0] == '+')) ? 1 : 0;
+    if (i == digits.size() || digits.find_first_not_of("0123456789", i) != std::string::npos) {
+        throw sql::InvalidArgumentException("invalid BIGINT value: " + digits);
+    }
+    set(parameterIndex, digits);
+}
+
+void BatchStatement::setBlob(unsigned int parameterIndex, std::istream* blob) {
+    if (blob == nullptr) {
+        set(parameterIndex, "NULL");
+        return;
+    }
+    std::string bytes((std::istreambuf_iterator<char>(*blob)), std::istreambuf_iterator<char>());
+    set(parameterIndex, "_binary" + quote(bytes));
+}
+
+void BatchStatement::setBoolean(unsigned int parameterIndex, bool value) {
+    set(parameterIndex, value ? "1" : "0");
+}
+
+void BatchStatement::setDateTime(unsigned int parameterIndex, const sql::SQLString& value) {
+    set(parameterIndex, quote(value));
+}
+
+void BatchStatement::setDouble(unsigned int parameterIndex, double value) {
+    if (!std::isfinite(value)) {
+        throw sql::InvalidArgumentException("DOUBLE value is not finite");
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.17g", value);
+    set(parameterIndex, buffer);
+}
+
+void BatchStatement::setInt(unsigned int parameterIndex, int32_t value) {
+    set(parameterIndex, std::to_string(value));
+}
+
+void BatchStatement::setUInt(unsigned int parameterIndex, uint32_t value) {
+    set(parameterIndex, std::to_string(value));
+}
+
+void BatchStatement::setInt64(unsigned int parameterIndex, int64_t value) {
+    set(parameterIndex, std::to_string(value));
+}
+
+void BatchStatement::setUInt64(unsigned int parameterIndex, uint64_t value) {
+    set(parameterIndex, std::to_string(value));
+}
+
+void BatchStatement::setNull(unsigned int parameterIndex, int /* sqlType */) {
+    set(parameterIndex, "NULL");
+}
+
+void BatchStatement::setString(unsigned int parameterIndex, const sql::SQLString& value) {
+    set(parameterIndex, quote(value));
+}
+
+void BatchStatement::clearParameters() {
+    std::fill(bound_.begin(), bound_.end(), false);
+}
+
+void BatchStatement::addBatch() {
+    for (size_t i = 0; i < bound_.size(); i++) {
+        if (!bound_[i]) {
+            throw sql::InvalidArgumentException("no value set for parameter " + std::to_string(i + 1));
+        }
+    }
+
+    const auto& pieces = template_.MultiRow ? template_.RowPieces : template_.Pieces;
+    size_t size = 0;
+    for (const auto& piece : pieces) {
+        size += piece.size();
+    }
+    for (const auto& param : params_) {
+        size += param.size();
+    }
+    std::string row;
+    row.reserve(size);
+    row += pieces[0];
+    for (size_t i = 0; i < params_.size(); i++) {
+        row += params_[i];
+        row += pieces[i + 1];
+    }
+    rows_.push_back(std::move(row));
+}
+
+void BatchStatement::clearBatch() {
+    rows_.clear();
+}
+
+size_t BatchStatement::max_statement_bytes() {
+    if (max_packet_ == 0) {
+        std::unique_ptr<sql::Statement> stmt(conn_->createStatement());
+        std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("SELECT @@max_allowed_packet"));
+        max_packet_ = res->next() ? res->getUInt64(1) : 0;
+        if (max_packet_ <= BATCH_PACKET_HEADROOM) {
+            max_packet_ = BATCH_PACKET_HEADROOM + 1;
+        }
+    }
+    return max_packet_ - BATCH_PACKET_HEADROOM;
+}
+
+std::vector<int> BatchStatement::executeBatch() {
+    std::vector<int> counts;
+    counts.reserve(rows_.size());
+    try {
+        std::unique_ptr<sql::Statement> stmt(conn_->createStatement());
+        if (!template_.MultiRow) {
+            for (const auto& row : rows_) {
+                counts.push_back(stmt->executeUpdate(row));
+            }
+        } else {
+            auto limit = max_statement_bytes();
+            std::string sql;
+            size_t i = 0;
+            while (i < rows_.size()) {
+                // at least one row per statement, an oversized row is left to the server to reject
+                size_t first = i;
+                sql = template_.Head;
+                sql += rows_[i++];
+                while (i < rows_.size() && sql.size() + 1 + rows_[i].size() <= limit) {
+                    sql += ',';
+                    sql += rows_[i++];
+                }
+                int affected = stmt->executeUpdate(sql);
+                size_t rows = i - first;
+                if (rows == 1) {
+                    counts.push_back(affected);
+                } else {
+                    // REPLACE and INSERT IGNORE count 2 or 0 for some rows, those cannot be told apart
+                    counts.insert(counts.end(), rows, affected == static_cast<int>(rows) ? 1 : BATCH_SUCCESS_NO_INFO);
+                }
+            }
+        }
+    } catch (sql::SQLException& e) {
+        rows_.clear();
+        // rows before the failure may have landed
+        conn_->invalidateResultCache();
+        throw BatchUpdateException(e, std::move(counts));
+    }
+    rows_.clear();
+    conn_->invalidateResultCache();
+    return counts;
+}
+
+} // namespace polardbx
+} // namespace sql
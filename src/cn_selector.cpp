@@ -0,0 +1,151 @@
+#include "cn_selector.h"
+#include "const.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <set>
+#include <sstream>
+
+namespace sql {
+namespace polardbx {
+
+namespace {
+
+std::vector<std::string> split_zones(const std::string& zone_names) {
+    std::set<std::string> zones;
+    std::istringstream iss(zone_names);
+    std::string token;
+    while (getline(iss, token, ',')) {
+        trim(token);
+        if (!token.empty()) {
+            zones.insert(token);
+        }
+    }
+    return {zones.begin(), zones.end()};
+}
+
+void append_key(std::string& key, const std::vector<std::string>& zones) {
+    for (const auto& zone : zones) {
+        key += zone;
+        key += ',';
+    }
+    key += '|';
+}
+
+} // namespace
+
+std::shared_ptr<const CnFilter> CnFilter::compile(const std::string& zoneName, int32_t minZoneNodes,
+    const std::string& backupZoneName, bool slaveRead, const std::string& instanceName, const std::string& mppRole) {
+    auto filter = std::make_shared<CnFilter>();
+    filter->Zones = split_zones(zoneName);
+    filter->BackupZones = split_zones(backupZoneName);
+    filter->InstanceName = instanceName;
+    filter->MinZoneNodes = minZoneNodes;
+
+    // slave read takes any read-only CN unless a writer was asked for,
+    // otherwise only writers when mppRole is W or unset
+    bool want_writer = caseInsensitiveEqual(mppRole, W);
+    if (slaveRead) {
+        filter->RoleMask = want_writer ? 0 : CN_ROLE_RO;
+    } else {
+        filter->RoleMask = (want_writer || mppRole.empty()) ? CN_ROLE_W : 0;
+    }
+
+    append_key(filter->Key, filter->Zones);
+    append_key(filter->Key, filter->BackupZones);
+    filter->Key += filter->InstanceName;
+    filter->Key += '|';
+    filter->Key += std::to_string(filter->MinZoneNodes);
+    filter->Key += '|';
+    filter->Key += std::to_string(filter->RoleMask);
+    filter->Hash = std::hash<std::string>()(filter->Key);
+    return filter;
+}
+
+CnTopology::CnTopology(uint64_t version, const std::vector<std::shared_ptr<MppInfo>>& cns, NodeTable& nodes)
+    : version_(version) {
+    std::vector<std::shared_ptr<MppInfo>> sorted;
+    for (const auto& cn : cns) {
+        if (cn != nullptr) {
+            sorted.push_back(cn);
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a->Tag < b->Tag; });
+
+    for (const auto& cn : sorted) {
+        for (const auto& zone : cn->ZoneList) {
+            zone_ids_.emplace(zone, static_cast<uint32_t>(zone_ids_.size()));
+        }
+        instance_ids_.emplace(cn->InstanceName, static_cast<uint32_t>(instance_ids_.size()));
+    }
+
+    for (const auto& cn : sorted) {
+        auto id = nodes.intern(cn->Tag);
+        if (id == INVALID_NODE) {
+            continue;
+        }
+        ids_.push_back(id);
+        roles_.push_back(caseInsensitiveEqual(cn->Role, W) ? CN_ROLE_W : CN_ROLE_RO);
+        instances_.push_back(instance_ids_[cn->InstanceName]);
+        zones_.push_back(zone_bits(cn->ZoneList));
+    }
+}
+
+CnTopology::ZoneBits CnTopology::zone_bits(const std::vector<std::string>& zones) const {
+    ZoneBits bits((zone_ids_.size() + 63) / 64, 0);
+    for (const auto& zone : zones) {
+        auto it = zone_ids_.find(zone);
+        if (it != zone_ids_.end()) {
+            bits[it->second / 64] |= uint64_t(1) << (it->second % 64);
+        }
+    }
+    return bits;
+}
+
+bool CnTopology::intersects(const ZoneBits& a, const ZoneBits& b) {
+    for (size_t i = 0; i < a.size() && i < b.size(); i++) {
+        if (a[i] & b[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<NodeId> CnTopology::select(const CnFilter& filter) const {
+    std::vector<NodeId> valid, backup;
+    if (filter.RoleMask == 0) {
+        return valid;
+    }
+
+    bool any_instance = filter.InstanceName.empty();
+    uint32_t instance = 0;
+    if (!any_instance) {
+        auto it = instance_ids_.find(filter.InstanceName);
+        if (it == instance_ids_.end()) {
+            return valid;
+        }
+        instance = it->second;
+    }
+
+    auto zones = zone_bits(filter.Zones);
+    auto backup_zones = zone_bits(filter.BackupZones);
+    for (size_t i = 0; i < ids_.size(); i++) {
+        if (!(roles_[i] & filter.RoleMask) || (!any_instance && instances_[i] != instance)) {
+            continue;
+        }
+        if (filter.Zones.empty() || intersects(zones, zones_[i])) {
+            valid.push_back(ids_[i]);
+        }
+        if (intersects(backup_zones, zones_[i])) {
+            backup.push_back(ids_[i]);
+        }
+    }
+
+    // unsigned on purpose: a negative minimum always falls back to the backup zones
+    if (valid.size() >= static_cast<size_t>(filter.MinZoneNodes)) {
+        return valid;
+    }
+    return backup;
+}
+
+} // namespace polardbx
+} // namespace sql
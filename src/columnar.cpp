@@ -0,0 +1,189 @@
+#include "columnar.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <jdbc/cppconn/datatype.h>
+#include <jdbc/cppconn/exception.h>
+#include <jdbc/cppconn/resultset_metadata.h>
+
+namespace sql {
+namespace polardbx {
+
+const char* arrow_format(ColumnType type) {
+    switch (type) {
+        case ColumnType::INT64: return "l";
+        case ColumnType::UINT64: return "L";
+        case ColumnType::DOUBLE: return "g";
+        case ColumnType::UTF8: return "u";
+        case ColumnType::BINARY: return "z";
+    }
+    return "u";
+}
+
+void ColumnBuffer::reset(size_t capacity) {
+    Length = 0;
+    NullCount = 0;
+    // all bits clear, appends set the ones of non-null rows
+    Validity.assign((capacity + 7) / 8, 0);
+    switch (Type) {
+        case ColumnType::INT64:
+        case ColumnType::UINT64:
+            Ints.resize(capacity);
+            break;
+        case ColumnType::DOUBLE:
+            Doubles.resize(capacity);
+            break;
+        case ColumnType::UTF8:
+        case ColumnType::BINARY:
+            Offsets.resize(capacity + 1);
+            Offsets[0] = 0;
+            Data.clear();
+            break;
+    }
+}
+
+void ColumnBuffer::append_null() {
+    NullCount++;
+    switch (Type) {
+        case ColumnType::INT64:
+        case ColumnType::UINT64:
+            Ints[Length] = 0;
+            break;
+        case ColumnType::DOUBLE:
+            Doubles[Length] = 0;
+            break;
+        case ColumnType::UTF8:
+        case ColumnType::BINARY:
+            Offsets[Length + 1] = Offsets[Length];
+            break;
+    }
+    Length++;
+}
+
+void ColumnBuffer::append_bytes(const char* data, size_t size) {
+    if (Data.size() + size > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+        throw sql::SQLException("column " + Name + " exceeds 2 GiB in one batch, use smaller batches");
+    }
+    Validity[Length >> 3] |= 1 << (Length & 7);
+    Data.insert(Data.end(), data, data + size);
+    Offsets[Length + 1] = static_cast<int32_t>(Data.size());
+    Length++;
+}
+
+void ColumnBuffer::finish() {
+    Validity.resize((Length + 7) / 8);
+    switch (Type) {
+        case ColumnType::INT64:
+        case ColumnType::UINT64:
+            Ints.resize(Length);
+            break;
+        case ColumnType::DOUBLE:
+            Doubles.resize(Length);
+            break;
+        case ColumnType::UTF8:
+        case ColumnType::BINARY:
+            Offsets.resize(Length + 1);
+            break;
+    }
+}
+
+ColumnarReader::ColumnarReader(sql::ResultSet* res) : res_(res) {
+    auto meta = res_->getMetaData();
+    for (unsigned int i = 1; i <= meta->getColumnCount(); i++) {
+        names_.push_back(meta->getColumnLabel(i));
+        switch (meta->getColumnType(i)) {
+            case sql::DataType::BIT:
+                types_.push_back(ColumnType::UINT64);
+                break;
+            case sql::DataType::TINYINT:
+            case sql::DataType::SMALLINT:
+            case sql::DataType::MEDIUMINT:
+            case sql::DataType::INTEGER:
+            case sql::DataType::BIGINT:
+            case sql::DataType::YEAR:
+                types_.push_back(meta->isSigned(i) ? ColumnType::INT64 : ColumnType::UINT64);
+                break;
+            case sql::DataType::REAL:
+            case sql::DataType::DOUBLE:
+                types_.push_back(ColumnType::DOUBLE);
+                break;
+            case sql::DataType::BINARY:
+            case sql::DataType::VARBINARY:
+            case sql::DataType::LONGVARBINARY:
+            case sql::DataType::GEOMETRY:
+                types_.push_back(ColumnType::BINARY);
+                break;
+            default:
+                types_.push_back(ColumnType::UTF8);
+                break;
+        }
+    }
+}
+
+bool ColumnarReader::next_batch(ColumnBatch& batch, size_t max_rows) {
+    max_rows = std::max<size_t>(1, max_rows);
+    batch.Columns.resize(types_.size());
+    for (size_t c = 0; c < types_.size(); c++) {
+        auto& column = batch.Columns[c];
+        column.Name = names_[c];
+        column.Type = types_[c];
+        column.reset(max_rows);
+    }
+
+    size_t rows = 0;
+    while (rows < max_rows && res_->next()) {
+        for (size_t c = 0; c < types_.size(); c++) {
+            auto& column = batch.Columns[c];
+            auto index = static_cast<uint32_t>(c + 1);
+            switch (column.Type) {
+                case ColumnType::INT64: {
+                    auto value = res_->getInt64(index);
+                    if (res_->wasNull()) {
+                        column.append_null();
+                    } else {
+                        column.append_int(value);
+                    }
+                    break;
+                }
+                case ColumnType::UINT64: {
+                    auto value = res_->getUInt64(index);
+                    if (res_->wasNull()) {
+                        column.append_null();
+                    } else {
+                        column.append_int(static_cast<int64_t>(value));
+                    }
+                    break;
+                }
+                case ColumnType::DOUBLE: {
+                    auto value = static_cast<double>(res_->getDouble(index));
+                    if (res_->wasNull()) {
+                        column.append_null();
+                    } else {
+                        column.append_double(value);
+                    }
+                    break;
+                }
+                case ColumnType::UTF8:
+                case ColumnType::BINARY: {
+                    sql::SQLString value = res_->getString(index);
+                    if (res_->wasNull()) {
+                        column.append_null();
+                    } else {
+                        column.append_bytes(value.c_str(), value.length());
+                    }
+                    break;
+                }
+            }
+        }
+        rows++;
+    }
+
+    for (auto& column : batch.Columns) {
+        column.finish();
+    }
+    batch.Rows = rows;
+    return rows > 0;
+}
+
+} // namespace polardbx
+} // namespace sql
@@ -9,6 +9,7 @@
 #include <utility>
 #include <vector>
 #include <nlohmann/json.hpp>
+#include <jdbc/cppconn/exception.h>
 
 namespace sql {
 namespace polardbx {
@@ -21,10 +22,20 @@ PolarDBXConfig::PolarDBXConfig()
       HaCheckIntervalMillis(5000),
       CheckLeaderTransferringIntervalMillis(100),
       LeaderTransferringWaitTimeoutMillis(5000),
+      LeaderSuspectWindowMillis(1000),
       SmoothSwitchover(false),
       IgnoreVip(true),
       JsonFile(""),
-      EnableLog(false)
+      EnableLog(false),
+      HostLocalProbe(false),
+      HaIdleTimeoutMillis(60000),
+      HaIdleCheckIntervalMillis(30000),
+      HaShutdownTimeoutMillis(3600000),
+      CnProbeQuorum(2),
+      HaCheckMaxBackoffMillis(100),
+      HaProbeBudget(20),
+      ConnectConcurrency(32),
+      ConnectRate(0)
 {
 }
 
@@ -67,11 +78,33 @@ ConnectionConfig::ConnectionConfig()
       BackupZoneName(""),
       InstanceName(""),
       MppRole(""),
-      EnableFollowerRead(-1)
+      EnableFollowerRead(-1),
+      WarmConnections(0),
+      PrepStmtCacheSize(25),
+      AllowMultiQueries(false),
+      StreamBufferSize(4 * 1024 * 1024),
+      ResultCacheSize(0),
+      ResultCacheTtlMillis(1000),
+      ConnectPriority("normal"),
+      CompiledConnectClass(ConnectClass::NORMAL)
 {
 };
 
 ConnectionConfig::~ConnectionConfig() {};
 
+ConnectClass parse_connect_class(const std::string& name) {
+    if (caseInsensitiveEqual(name, "critical")) {
+        return ConnectClass::CRITICAL;
+    }
+    if (caseInsensitiveEqual(name, "normal")) {
+        return ConnectClass::NORMAL;
+    }
+    if (caseInsensitiveEqual(name, "batch")) {
+        return ConnectClass::BATCH;
+    }
+    throw sql::InvalidArgumentException("Wrong value passed for " + std::string(OPT_CONNECT_PRIORITY) +
+        " expected critical, normal or batch: " + name);
+}
+
 } // namespace polardbx
 } // namespace sql
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include "connect_admission.h"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+namespace sql {
+namespace polardbx {
+
+namespace {
+
+int64_t steady_nanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+ConnectAdmission::Permit& ConnectAdmission::Permit::operator=(Permit&& other) noexcept {
+    if (this != &other) {
+        reset();
+        owner_ = other.owner_;
+        other.owner_ = nullptr;
+    }
+    return *this;
+}
+
+void ConnectAdmission::Permit::reset() {
+    if (owner_ != nullptr) {
+        owner_->release();
+        owner_ = nullptr;
+    }
+}
+
+ConnectAdmission::ConnectAdmission(int32_t max_in_flight, int32_t rate_per_second)
+    : max_in_flight_(std::max(0, max_in_flight)),
+      rate_(std::max(0, rate_per_second)),
+      tokens_(rate_),
+      refill_nanos_(steady_nanos()) {}
+
+ConnectAdmission::Permit ConnectAdmission::acquire(int64_t deadline_nanos, ConnectClass cls) {
+    std::unique_lock<std::mutex> lk(mutex_);
+    if (cls == ConnectClass::BATCH && max_in_flight_ > 0 && queue_.size() >= static_cast<size_t>(max_in_flight_)) {
+        // shed under pressure rather than queue behind the ones users wait for
+        return Permit();
+    }
+    Waiter self;
+    self.cls = cls;
+    auto position = queue_.insert(
+        std::find_if(queue_.begin(), queue_.end(), [cls](const Waiter* w) { return w->cls > cls; }), &self);
+
+    while (true) {
+        auto now = steady_nanos();
+        if (queue_.front() == &self && admit_locked(now, cls)) {
+            queue_.pop_front();
+            // the next one may fit as well
+            wake_head_locked();
+            return Permit(this);
+        }
+        if (now >= deadline_nanos) {
+            bool head = queue_.front() == &self;
+            queue_.erase(position);
+            if (head) {
+                wake_head_locked();
+            }
+            return Permit();
+        }
+
+        auto wake = deadline_nanos;
+        if (queue_.front() == &self && rate_ > 0 && (max_in_flight_ == 0 || in_flight_ < slots_for(cls))) {
+            // only waiting for a token, which no release() announces
+            wake = std::min(wake, now + static_cast<int64_t>((1 - tokens_) * 1e9 / rate_) + 1);
+        }
+        self.cv.wait_until(lk, std::chrono::steady_clock::time_point(std::chrono::nanoseconds(wake)));
+    }
+}
+
+int32_t ConnectAdmission::in_flight() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return in_flight_;
+}
+
+void ConnectAdmission::release() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    in_flight_--;
+    wake_head_locked();
+}
+
+int32_t ConnectAdmission::slots_for(ConnectClass cls) const {
+    return cls == ConnectClass::BATCH ? std::max(1, max_in_flight_ / 2) : max_in_flight_;
+}
+
+bool ConnectAdmission::admit_locked(int64_t now, ConnectClass cls) {
+    if (max_in_flight_ > 0 && in_flight_ >= slots_for(cls)) {
+        return false;
+    }
+    if (rate_ > 0) {
+        tokens_ = std::min<double>(rate_, tokens_ + (now - refill_nanos_) * rate_ / 1e9);
+        refill_nanos_ = now;
+        if (tokens_ < 1) {
+            return false;
+        }
+        tokens_ -= 1;
+    }
+    in_flight_++;
+    return true;
+}
+
+void ConnectAdmission::wake_head_locked() {
+    if (!queue_.empty()) {
+        queue_.front()->cv.notify_one();
+    }
+}
+
+} // namespace polardbx
+} // namespace sql
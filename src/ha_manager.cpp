@@ -7,9 +7,17 @@
 #include <chrono>
 #include <thread>
 #include <map>
+#include <unordered_set>
 #include <functional>
 #include <nlohmann/json.hpp>
 #include <random>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
 #include <jdbc/cppconn/connection.h>
 
 namespace fs = std::filesystem;
@@ -24,12 +32,12 @@ std::shared_ptr<HaManager> HaManager::get_manager(std::shared_ptr<PolarDBXConfig
     if (p_cfg == nullptr) {
         return nullptr;
     }
-    auto tag = gen_cluster_tag(p_cfg->ClusterID, p_cfg->Addr);
+    auto lookup_tag = gen_cluster_tag(p_cfg->ClusterID, p_cfg->Addr);
 
     {
         std::shared_lock<std::shared_mutex> lk(managers_rw_mutex_);
-        auto it = managers_.find(tag);
-        if (it != managers_.end()) {
+        auto it = managers_.find(lookup_tag);
+        if (it != managers_.end() && it->second->acquire()) {
             return it->second;
         }
     }
@@ -37,8 +45,10 @@ std::shared_ptr<HaManager> HaManager::get_manager(std::shared_ptr<PolarDBXConfig
     auto tmp_dir = fs::temp_directory_path();
     auto [cluster_id, version, is_dn] = get_cluster_id_and_version(p_cfg);
     bool use_ipv6 = isIPv6(p_cfg->Addr);
-    std::string json_file;
+    std::string json_file = p_cfg->JsonFile;
 
+    // the caller's config may be shared by concurrent connects, the manager gets its own copy
+    p_cfg = std::make_shared<PolarDBXConfig>(*p_cfg);
     if (p_cfg->JsonFile.empty()) {
         if (is_dn) {
             if (use_ipv6) {
@@ -66,31 +76,53 @@ std::shared_ptr<HaManager> HaManager::get_manager(std::shared_ptr<PolarDBXConfig
         n_file.close();
     }
 
-    tag = gen_cluster_tag(cluster_id, p_cfg->Addr);
+    auto tag = gen_cluster_tag(cluster_id, p_cfg->Addr);
 
+    // destroyed after the lock is released, ~HaManager joins probes that may hang on a dead node
+    std::vector<std::shared_ptr<HaManager>> retired;
     {
         std::unique_lock<std::shared_mutex> lk(managers_rw_mutex_);
-        if (managers_.find(tag) == managers_.end()) {
-            auto manager = std::make_shared<HaManager>(
-                is_dn,
-                use_ipv6,
-                versionString2Int32(version),
-                p_cfg
-            );
-
-            manager->checker_thread_ = std::make_shared<std::thread>([manager]() {
-                if (manager->is_dn_) {
-                    manager->dn_ha_checker();
-                } else {
-                    manager->cn_ha_checker();
-                }
-            });
+        // sweep managers whose checker thread has shut down after being idle
+        for (auto it = managers_.begin(); it != managers_.end();) {
+            if (it->second->ref_cnt_ < 0) {
+                retired.push_back(std::move(it->second));
+                it = managers_.erase(it);
+            } else {
+                ++it;
+            }
+        }
 
-            managers_[tag] = manager;
-            return manager;
-        } else {
-            return managers_[tag];
+        auto it = managers_.find(tag);
+        if (it != managers_.end() && it->second->acquire()) {
+            managers_[lookup_tag] = it->second;
+            return it->second;
         }
+        if (it != managers_.end()) {
+            // retired since the sweep, replaced below
+            retired.push_back(it->second);
+        }
+
+        auto manager = std::make_shared<HaManager>(
+            is_dn,
+            use_ipv6,
+            versionString2Int32(version),
+            p_cfg
+        );
+        manager->acquire();
+
+        // the thread must not own the manager, otherwise the last reference could be dropped on the thread it joins
+        manager->checker_thread_ = std::make_shared<std::thread>([raw = manager.get()]() {
+            if (raw->is_dn_) {
+                raw->dn_ha_checker();
+            } else {
+                raw->cn_ha_checker();
+            }
+        });
+
+        managers_[tag] = manager;
+        // without clusterID the caller looks up by address, alias it so later connects skip the probe
+        managers_[lookup_tag] = manager;
+        return manager;
 
     }
 }
@@ -100,21 +132,30 @@ std::pair<std::string, bool> HaManager::get_available_dn_with_wait(
     bool slaveOnly,
     int32_t applyDelayThreshold,
     int32_t slaveWeightThreshold,
-    const std::string& loadBalanceAlgorithm)
+    const std::string& loadBalanceAlgorithm,
+    ConnectClass cls)
 {
-    using namespace std::chrono;
-
-    auto deadlineNs = high_resolution_clock::now().time_since_epoch().count() +
-                     static_cast<int64_t>(timeoutMs) * 1000000LL;
+    auto deadlineNs = now_nanos() + static_cast<int64_t>(timeoutMs) * 1000000LL;
+
+    // a leader waiter is handed the new leader by the notify; picking a follower
+    // queries the leader, that is left to the woken waiter itself
+    std::string key = "dn:leader";
+    WaiterRegistry::Select select = [this]() { return get_available_dn_internal(false, 0, 0, "").first; };
+    if (slaveOnly) {
+        key = "dn:follower:" + std::to_string(applyDelayThreshold) + ":" + std::to_string(slaveWeightThreshold) + ":" +
+              loadBalanceAlgorithm;
+        select = nullptr;
+    }
 
     while (true) {
-        auto nowNs = high_resolution_clock::now().time_since_epoch().count();
+        auto nowNs = now_nanos();
 
         if (nowNs >= deadlineNs) {
             driver_logger_->info("get_available_dn_with_wait last try");
             return get_available_dn_internal(slaveOnly, applyDelayThreshold, slaveWeightThreshold, loadBalanceAlgorithm);
         }
         driver_logger_->info("get_available_dn_with_wait try");
+        auto ticket = waiters_.prepare(key);
         auto [dn, ok] = get_available_dn_internal(slaveOnly, applyDelayThreshold, slaveWeightThreshold, loadBalanceAlgorithm);
         driver_logger_->debug("get_available_dn_with_wait: " + std::to_string(ok) + ", dn:" + dn);
        
@@ -122,12 +163,11 @@ std::pair<std::string, bool> HaManager::get_available_dn_with_wait(
             return {dn, ok};
         }
 
-        nowNs = high_resolution_clock::now().time_since_epoch().count();
-        int64_t sleepDurationMs = std::max<int64_t>(0, (deadlineNs - nowNs) / 1000000);
-        {
-            driver_logger_->info("get_available_dn failed, wait to be notified, " + std::to_string(sleepDurationMs) + "ms");
-            std::unique_lock<std::mutex> lk(mutex_); 
-            conn_req_.wait_for(lk, std::chrono::milliseconds(sleepDurationMs));
+        driver_logger_->info("get_available_dn failed, wait to be notified, " +
+            std::to_string(std::max<int64_t>(0, (deadlineNs - now_nanos()) / 1000000)) + "ms");
+        auto handed = waiters_.wait(key, ticket, deadlineNs, select, cls);
+        if (!handed.empty()) {
+            return {handed, true};
         }
     }
 }
@@ -143,6 +183,12 @@ std::pair<std::string, bool> HaManager::get_available_dn_internal(
         std::shared_lock<std::shared_mutex> lk(rw_mutex_);
         if (dn_cluster_info_->LeaderInfo != nullptr) {
             leader = dn_cluster_info_->LeaderInfo->Tag;
+        } else if (dn_cluster_info_->SuspectLeader != nullptr &&
+                   now_nanos() - dn_cluster_info_->SuspectSinceNanos <
+                       static_cast<int64_t>(p_cfg_->LeaderSuspectWindowMillis) * 1000000LL) {
+            // stale-while-revalidate: a single missed ping does not stall connects
+            leader = dn_cluster_info_->SuspectLeader->Tag;
+            driver_logger_->debug("leader " + leader + " is suspect, still handed out");
         }
     }
 
@@ -209,37 +255,36 @@ std::string HaManager::get_dn_follower(
         return "";
     }
 
-    return get_node_with_load_balance(followers, loadBalanceAlgorithm);
+    std::vector<NodeId> candidates;
+    for (const auto& follower : followers) {
+        auto id = node_table_.intern(follower);
+        if (id != INVALID_NODE) {
+            candidates.push_back(id);
+        }
+    }
+    return get_node_with_load_balance(candidates, loadBalanceAlgorithm);
 }
 
-std::string HaManager::get_node_with_load_balance(const std::set<std::string>& candidates, const std::string& loadBalanceAlgorithm) {
+std::string HaManager::get_node_with_load_balance(const std::vector<NodeId>& candidates, const std::string& loadBalanceAlgorithm) {
     if (candidates.empty()) {
         return "";
     }
 
-    std::unique_lock<std::shared_mutex> lk(rw_mutex_);
-    std::string conn_node;
+    // counters are per-node atomics, so picking a node takes no manager lock
+    NodeId conn_node = INVALID_NODE;
 
     if (caseInsensitiveEqual(loadBalanceAlgorithm, "random")) {
         static thread_local std::mt19937 rng(static_cast<unsigned int>(
             std::chrono::high_resolution_clock::now().time_since_epoch().count()
         ));
-        std::vector<std::string> candidate_list(candidates.begin(), candidates.end());
-        std::uniform_int_distribution<size_t> dist(0, candidate_list.size() - 1);
+        std::uniform_int_distribution<size_t> dist(0, candidates.size() - 1);
 
-        conn_node = candidate_list[dist(rng)];
+        conn_node = candidates[dist(rng)];
 
     } else if (caseInsensitiveEqual(loadBalanceAlgorithm, "least_connection") || caseInsensitiveEqual(loadBalanceAlgorithm, "least_conn")) {
         int64_t leastCnt = INT64_MAX;
-        for (const auto& node : candidates) {
-            auto it = conn_cnt_.find(node);
-            if (it == conn_cnt_.end()) {
-                conn_cnt_[node] = 0;
-                conn_node = node;
-                break;
-            }
-
-            int64_t cnt = it->second.load();
+        for (auto node : candidates) {
+            int64_t cnt = node_table_.conn_count(node);
             if (cnt < leastCnt) {
                 leastCnt = cnt;
                 conn_node = node;
@@ -247,45 +292,50 @@ std::string HaManager::get_node_with_load_balance(const std::set<std::string>& c
         }
 
     } else {
-        conn_node = *candidates.begin();
+        conn_node = candidates.front();
     }
 
-    if (!conn_node.empty()) {
-        add_conn_count(conn_node);
-    }
-
-    return conn_node;
+    node_table_.add_conn(conn_node);
+    return node_table_.tag(conn_node);
 }
 
 std::pair<std::string, bool> HaManager::get_available_cn_with_wait(int32_t timeoutMs, const std::string& zoneName, 
     int32_t minZoneNodes, const std::string& backupZoneName, bool slaveRead, const std::string& instanceName,
-    const std::string& mppRole, const std::string& loadBalanceAlgorithm) {
-    using namespace std::chrono;
-    auto deadlineNs = high_resolution_clock::now().time_since_epoch().count() +
-                     static_cast<int64_t>(timeoutMs) * 1000000LL;
+    const std::string& mppRole, const std::string& loadBalanceAlgorithm, ConnectClass cls) {
+    auto filter = CnFilter::compile(zoneName, minZoneNodes, backupZoneName, slaveRead, instanceName, mppRole);
+    return get_available_cn_with_wait(timeoutMs, filter, loadBalanceAlgorithm, cls);
+}
+
+std::pair<std::string, bool> HaManager::get_available_cn_with_wait(int32_t timeoutMs, const std::shared_ptr<const CnFilter>& filter,
+    const std::string& loadBalanceAlgorithm, ConnectClass cls) {
+    auto deadlineNs = now_nanos() + static_cast<int64_t>(timeoutMs) * 1000000LL;
+
+    // a CN update wakes only the waiters whose filter now selects a node, each with its node
+    auto key = "cn:" + filter->Key + ":" + loadBalanceAlgorithm;
+    WaiterRegistry::Select select = [this, filter, loadBalanceAlgorithm]() {
+        return get_available_cn_internal(filter, loadBalanceAlgorithm).first;
+    };
 
     while (true) {
-        auto nowNanos = high_resolution_clock::now().time_since_epoch().count();
+        auto nowNanos = now_nanos();
 
         if (nowNanos >= deadlineNs) {
             // last try
             driver_logger_->info("get_available_cn_with_wait last try");
-            return get_available_cn_internal(zoneName, minZoneNodes, backupZoneName, slaveRead, instanceName, mppRole, loadBalanceAlgorithm);
+            return get_available_cn_internal(filter, loadBalanceAlgorithm);
         }
 
-        driver_logger_->info("get_available_cn_with_wait try");
-        auto [cn, ok] = get_available_cn_internal(zoneName, minZoneNodes, backupZoneName, slaveRead, instanceName, mppRole, loadBalanceAlgorithm);
-        driver_logger_->debug("get_available_cn_with_wait: " + std::to_string(ok) + ", cn:" + cn);
+        auto ticket = waiters_.prepare(key);
+        auto [cn, ok] = get_available_cn_internal(filter, loadBalanceAlgorithm);
         if (ok && !cn.empty()) {
             return {cn, ok};
         }
 
-        nowNanos = high_resolution_clock::now().time_since_epoch().count();
-        int64_t sleepDurationMs = std::max<int64_t>(0, (deadlineNs - nowNanos) / 1000000);
-        {
-            driver_logger_->info("get_available_cn failed, wait to be notified, " + std::to_string(sleepDurationMs) + "ms");
-            std::unique_lock<std::mutex> lk(mutex_); 
-            conn_req_.wait_for(lk, std::chrono::milliseconds(sleepDurationMs));
+        driver_logger_->info("get_available_cn failed, wait to be notified, " +
+            std::to_string(std::max<int64_t>(0, (deadlineNs - now_nanos()) / 1000000)) + "ms");
+        auto handed = waiters_.wait(key, ticket, deadlineNs, select, cls);
+        if (!handed.empty()) {
+            return {handed, true};
         }
     }
 }
@@ -293,110 +343,323 @@ std::pair<std::string, bool> HaManager::get_available_cn_with_wait(int32_t timeo
 std::pair<std::string, bool> HaManager::get_available_cn_internal(const std::string& zoneName, int32_t minZoneNodes,
     const std::string& backupZoneName, bool slaveRead, const std::string& instanceName,
     const std::string& mppRole, const std::string& loadBalanceAlgorithm) {
-    driver_logger_->debug("try to get valid cn: " + zoneName + ", minZoneNodes: " + std::to_string(minZoneNodes) + ", instanceName: " + instanceName);
+    auto filter = CnFilter::compile(zoneName, minZoneNodes, backupZoneName, slaveRead, instanceName, mppRole);
+    return get_available_cn_internal(filter, loadBalanceAlgorithm);
+}
 
-    auto zoneSet = get_zone_set(zoneName);
-    auto backupZoneSet = get_zone_set(backupZoneName);
-    std::set<std::string> validCn;
-    std::set<std::string> backupCn;
+std::pair<std::string, bool> HaManager::get_available_cn_internal(const std::shared_ptr<const CnFilter>& filter,
+    const std::string& loadBalanceAlgorithm) {
+    auto selector = get_cn_selector(filter);
+    auto conn_cn = get_node_with_load_balance(selector->Candidates, loadBalanceAlgorithm);
+    return {conn_cn, !conn_cn.empty()};
+}
 
+std::shared_ptr<const CnSelector> HaManager::get_cn_selector(const std::shared_ptr<const CnFilter>& filter) {
+    auto version = cn_topology_version_.load();
     {
-        std::shared_lock<std::shared_mutex> lk(rw_mutex_);
-        for (const auto& cn : cn_cluster_info_) {
-            if ((instanceName.empty() || instanceName == cn->InstanceName) &&
-                ((slaveRead && (!caseInsensitiveEqual(mppRole, W) && !caseInsensitiveEqual(cn->Role, W))) ||
-                    (!slaveRead && (caseInsensitiveEqual(mppRole, W) || mppRole.empty()) && caseInsensitiveEqual(cn->Role, W)))) {
+        std::shared_lock<std::shared_mutex> lk(cn_selector_mutex_);
+        auto it = cn_selectors_.find(filter);
+        if (it != cn_selectors_.end() && it->second->Version == version) {
+            return it->second;
+        }
+    }
 
-                if (zoneSet.empty() || is_overlapped(zoneSet, cn->ZoneList)) {
-                    validCn.insert(cn->Tag);
-                }
-                if (is_overlapped(backupZoneSet, cn->ZoneList)) {
-                    backupCn.insert(cn->Tag);
-                }
-            }
+    std::unique_lock<std::shared_mutex> lk(cn_selector_mutex_);
+    {
+        // read the topology and its version together
+        std::shared_lock<std::shared_mutex> info_lk(rw_mutex_);
+        version = cn_topology_version_.load();
+        if (cn_topology_ == nullptr || cn_topology_->version() != version) {
+            cn_topology_ = std::make_shared<CnTopology>(version, cn_cluster_info_, node_table_);
         }
     }
 
-    std::string conn_cn = "";
-    if (validCn.size() >= minZoneNodes) {
-        conn_cn = get_node_with_load_balance(validCn, loadBalanceAlgorithm);
-    } else if (!backupCn.empty()) {
-        conn_cn = get_node_with_load_balance(backupCn, loadBalanceAlgorithm);
+    auto selector = std::make_shared<CnSelector>();
+    selector->Version = version;
+    selector->Candidates = cn_topology_->select(*filter);
+    driver_logger_->debug("cn selector " + filter->Key + " compiled for topology version " + std::to_string(version) +
+        ", " + std::to_string(selector->Candidates.size()) + " candidates");
+
+    // selectors of filters no longer in use are dropped wholesale
+    if (cn_selectors_.size() >= 256) {
+        cn_selectors_.clear();
     }
-    return {conn_cn, !conn_cn.empty()};
+    cn_selectors_[filter] = selector;
+    return selector;
 }
 
 void HaManager::cn_ha_checker() {
     while (!stop_flag_) {
-        std::unordered_map<std::string, std::shared_ptr<MppInfo>> cn_map;
-
-        if (connection_addresses_.empty()) {
-            update_connection_addresses();
+        if (try_retire()) {
+            break;
         }
 
-        for (const auto& addr : connection_addresses_) {
-            auto mppInfo = get_mpp_info(addr);
-            for (auto& mpp : mppInfo) {
-                cn_map[mpp->Tag] = mpp;
-            }
+        if (p_cfg_->HostLocalProbe && !hold_probe_lock()) {
+            sync_mpp_from_file();
+            wait_for_next_check(std::max(1, std::min(100, p_cfg_->HaCheckIntervalMillis)));
+            continue;
         }
 
-        std::vector<std::shared_ptr<MppInfo>> cn_cluster_info;
-        for (auto& pair : cn_map) {
-            cn_cluster_info.push_back(pair.second);
+        if (connection_addresses_.empty()) {
+            update_connection_addresses();
         }
 
+        auto cn_cluster_info = get_all_mpp_info_concurrent(connection_addresses_);
+
         if (!cn_cluster_info.empty()) {
+            node_table_.update_cn(cn_cluster_info, now_nanos());
             save_mpp_to_file(cn_cluster_info, p_cfg_->JsonFile);
         }
 
         int32_t cluster_state = cn_cluster_info.empty() ? CN_LOST : CN_ALIVE;
         if (cluster_state == CN_ALIVE) {
             monitor_logger_->debug("Cn cluster size is " + std::to_string(cn_cluster_info.size()));
-            std::unique_lock<std::shared_mutex> lk(rw_mutex_);
-            cn_cluster_info_ = cn_cluster_info;
-            conn_req_.notify_all();
+            auto cn_view = mpp_view_digest(cn_cluster_info);
+            bool changed = false;
+            {
+                std::unique_lock<std::shared_mutex> lk(rw_mutex_);
+                cn_cluster_info_ = cn_cluster_info;
+                // selectors are compiled once per version, an unchanged view keeps them
+                changed = cn_view != epoch_cn_view_;
+                if (changed) {
+                    cn_topology_version_++;
+                }
+                advance_epoch_locked(epoch_leader_, cn_view);
+            }
+            if (changed) {
+                // selecting for the waiters reads the topology, so not under rw_mutex_
+                waiters_.notify("cn:");
+            }
         } else {
             cluster_state = CN_LOST;
         }
         
-        auto interval = cluster_state == CN_ALIVE ? p_cfg_->HaCheckIntervalMillis : std::min(500, p_cfg_->HaCheckIntervalMillis);
+        auto check_interval = p_cfg_->HaCheckIntervalMillis;
+        auto cadence = cluster_state == CN_ALIVE ? ProbeCadence{std::min(500, check_interval), check_interval}
+                                                 : ProbeCadence{std::min(100, check_interval), std::min(500, check_interval)};
+        auto interval = probe_scheduler_.next_interval(cluster_state, cadence);
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+        wait_for_next_check(adjust_interval_for_idle(interval));
     }
 }
 
-std::vector<std::shared_ptr<MppInfo>> HaManager::get_mpp_info(const std::string &addr) noexcept {
-    std::vector<std::shared_ptr<MppInfo>> mpp_infos;
-    try {
-        sql::Driver* driver;
-        {
-            std::lock_guard<std::mutex> lock(driver_mutex_);
-            driver = sql::mysql::get_driver_instance();
+std::vector<std::shared_ptr<MppInfo>> HaManager::get_all_mpp_info_concurrent(const std::vector<std::string> &addresses) {
+    // every healthy CN returns the whole cluster, so the cycle ends as soon as enough
+    // seeds agree; seeds still queued then are skipped, running ones finish in the background
+    struct Round {
+        std::mutex mu;
+        std::condition_variable cv;
+        size_t pending = 0;
+        bool finished = false;
+        // identical views keyed by digest, with the number of seeds that returned them
+        std::unordered_map<size_t, std::pair<size_t, std::vector<std::shared_ptr<MppInfo>>>> views;
+        std::map<std::string, std::shared_ptr<MppInfo>> merged;
+    };
+
+    if (addresses.empty()) {
+        return {};
+    }
+    if (cn_probe_executor_ == nullptr) {
+        cn_probe_executor_ = std::make_unique<ProbeExecutor>(CN_PROBE_THREADS);
+    }
+
+    forget_cn_seeds(addresses);
+
+    auto round = std::make_shared<Round>();
+    round->pending = addresses.size();
+    auto quorum = static_cast<size_t>(std::max(1, p_cfg_->CnProbeQuorum));
+    quorum = std::min(quorum, addresses.size());
+
+    for (const auto& addr : order_cn_seeds(addresses)) {
+        cn_probe_executor_->submit([this, round, addr]() {
+            {
+                std::lock_guard<std::mutex> lk(round->mu);
+                if (round->finished) {
+                    return;
+                }
+            }
+
+            auto start = now_nanos();
+            auto infos = get_mpp_info(addr);
+            record_cn_seed(addr, !infos.empty(), now_nanos() - start);
+
+            auto digest = mpp_view_digest(infos);
+
+            std::lock_guard<std::mutex> lk(round->mu);
+            round->pending--;
+            if (!infos.empty()) {
+                auto& entry = round->views[digest];
+                if (entry.first++ == 0) {
+                    entry.second = infos;
+                }
+                for (const auto& info : infos) {
+                    round->merged[info->Tag] = info;
+                }
+            }
+            round->cv.notify_all();
+        });
+    }
+
+    // a hung CN must not hold the checker: wait no longer than one probe may take
+    auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(p_cfg_->HaCheckConnectTimeoutMillis + p_cfg_->HaCheckSocketTimeoutMillis);
+    std::vector<std::shared_ptr<MppInfo>> cn_cluster_info;
+    std::unique_lock<std::mutex> lk(round->mu);
+    round->cv.wait_until(lk, deadline, [&]() {
+        for (const auto& [digest, entry] : round->views) {
+            if (entry.first >= quorum) {
+                cn_cluster_info = entry.second;
+                return true;
+            }
         }
-        sql::ConnectOptionsMap conn_props = p_cfg_->conn_properties_;
-        conn_props["hostName"] = addr;
-        conn_props[OPT_CONNECT_TIMEOUT] = 2;
-        std::unique_ptr<sql::Connection> conn(driver->connect(conn_props));
-        std::unique_ptr<sql::Statement> stmt(conn->createStatement());
-        std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(SHOW_MPP_QUERY));
+        return round->pending == 0;
+    });
+    round->finished = true;
+
+    if (cn_cluster_info.empty()) {
+        // no quorum, the seeds disagree or are down: take the union like a full walk would
+        monitor_logger_->debug("no quorum of " + std::to_string(quorum) + " consistent show mpp views, merging " +
+            std::to_string(round->views.size()) + " views");
+        for (const auto& [tag, info] : round->merged) {
+            cn_cluster_info.push_back(info);
+        }
+    }
+    // the seed answering first decides the row order of a quorum view, so order by tag
+    // as the union is: the same view always lists the CNs the same way
+    std::sort(cn_cluster_info.begin(), cn_cluster_info.end(),
+        [](const auto& a, const auto& b) { return a->Tag < b->Tag; });
+    return cn_cluster_info;
+}
 
-        while (res->next()) {
-            auto instance_name = res->getString(1);
-            auto tag = res->getString(2);
-            auto role = res->getString(3);
-            auto is_leader = res->getString(4);
-            auto zone_names = res->getString(5);
-            std::vector<std::string> zone_list = get_zone_list(zone_names);
+std::vector<std::string> HaManager::order_cn_seeds(const std::vector<std::string> &addresses) {
+    std::vector<std::pair<SeedHealth, std::string>> seeds;
+    {
+        std::lock_guard<std::mutex> lk(cn_seed_mutex_);
+        for (const auto& addr : addresses) {
+            auto it = cn_seed_health_.find(addr);
+            seeds.emplace_back(it == cn_seed_health_.end() ? SeedHealth() : it->second, addr);
+        }
+    }
+
+    // seeds that failed lately go last, then the slow ones
+    std::stable_sort(seeds.begin(), seeds.end(), [](const auto& a, const auto& b) {
+        if (a.first.Failures != b.first.Failures) {
+            return a.first.Failures < b.first.Failures;
+        }
+        return a.first.LatencyNanos < b.first.LatencyNanos;
+    });
+
+    std::vector<std::string> ordered;
+    for (auto& seed : seeds) {
+        ordered.push_back(std::move(seed.second));
+    }
+    return ordered;
+}
+
+void HaManager::record_cn_seed(const std::string &addr, bool ok, int64_t latency_nanos) {
+    std::lock_guard<std::mutex> lk(cn_seed_mutex_);
+    auto& health = cn_seed_health_[addr];
+    if (ok) {
+        health.Failures = 0;
+        health.LatencyNanos = health.LatencyNanos == 0 ? latency_nanos : (3 * health.LatencyNanos + latency_nanos) / 4;
+    } else {
+        health.Failures = std::min(health.Failures + 1, 1000);
+    }
+}
+
+void HaManager::forget_cn_seeds(const std::vector<std::string> &addresses) {
+    std::unordered_set<std::string> seeds(addresses.begin(), addresses.end());
+    std::vector<std::shared_ptr<CnProbeConnection>> dropped;
+    {
+        std::lock_guard<std::mutex> lk(cn_seed_mutex_);
+        for (auto it = cn_probe_conns_.begin(); it != cn_probe_conns_.end();) {
+            if (seeds.count(it->first) == 0) {
+                dropped.push_back(std::move(it->second));
+                it = cn_probe_conns_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for (auto it = cn_seed_health_.begin(); it != cn_seed_health_.end();) {
+            it = seeds.count(it->first) == 0 ? cn_seed_health_.erase(it) : std::next(it);
+        }
+    }
+    // idle connections close here, outside cn_seed_mutex_; one a probe still runs on
+    // closes when that probe lets go of it
+}
 
-            monitor_logger_->debug("instanceName: " + instance_name + ", tag: " + tag);
+std::vector<std::shared_ptr<MppInfo>> HaManager::get_mpp_info(const std::string &addr) noexcept {
+    std::shared_ptr<CnProbeConnection> probe;
+    {
+        std::lock_guard<std::mutex> lk(cn_seed_mutex_);
+        auto& slot = cn_probe_conns_[addr];
+        if (slot == nullptr) {
+            slot = std::make_shared<CnProbeConnection>();
+        }
+        probe = slot;
+    }
 
-            mpp_infos.push_back(std::make_shared<MppInfo>(tag, role, instance_name, zone_list, is_leader));
+    // one probe per seed at a time, the connection is not shared
+    std::lock_guard<std::mutex> lk(probe->Mutex);
+    // a reused connection may have been dropped by the server since the last cycle,
+    // so a failed query on it gets one retry on a fresh connection
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = probe->Conn != nullptr;
+        if (!reused) {
+            if (now_nanos() < probe->RetryAfterNanos) {
+                return {};
+            }
+            try {
+                sql::Driver* driver;
+                {
+                    std::lock_guard<std::mutex> lock(driver_mutex_);
+                    driver = sql::mysql::get_driver_instance();
+                }
+                sql::ConnectOptionsMap conn_props = p_cfg_->conn_properties_;
+                conn_props["hostName"] = addr;
+                // the connector takes whole seconds, rounded up so a probe is not cut shorter than configured
+                conn_props[OPT_CONNECT_TIMEOUT] = std::max(1, (p_cfg_->HaCheckConnectTimeoutMillis + 999) / 1000);
+                conn_props[OPT_READ_TIMEOUT] = std::max(1, p_cfg_->HaCheckSocketTimeoutMillis / 1000);
+                probe->Conn.reset(driver->connect(conn_props));
+                probe->BackoffMillis = 0;
+            } catch (sql::SQLException& e) {
+                probe->BackoffMillis = std::min(CN_PROBE_MAX_BACKOFF_MILLIS, std::max(100, probe->BackoffMillis * 2));
+                probe->RetryAfterNanos = now_nanos() + static_cast<int64_t>(probe->BackoffMillis) * 1000000LL;
+                monitor_logger_->error(std::string("Failed to connect to cn: ") + addr + ", retry in " +
+                    std::to_string(probe->BackoffMillis) + "ms, error: " + e.what());
+                return {};
+            }
         }
 
-        conn->close();
-    } catch (sql::SQLException& e) {
-        monitor_logger_->error(std::string("Failed to get mpp info: ") + addr + ", error: " + e.what());
+        try {
+            return query_mpp_info(*probe->Conn);
+        } catch (sql::SQLException& e) {
+            monitor_logger_->error(std::string("Failed to get mpp info: ") + addr + ", error: " + e.what());
+            probe->Conn.reset();
+            if (!reused) {
+                return {};
+            }
+        }
+    }
+    return {};
+}
+
+std::vector<std::shared_ptr<MppInfo>> HaManager::query_mpp_info(sql::Connection &conn) {
+    std::vector<std::shared_ptr<MppInfo>> mpp_infos;
+    std::unique_ptr<sql::Statement> stmt(conn.createStatement());
+    std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(SHOW_MPP_QUERY));
+
+    while (res->next()) {
+        auto instance_name = res->getString(1);
+        auto tag = res->getString(2);
+        auto role = res->getString(3);
+        auto is_leader = caseInsensitiveEqual(res->getString(4), "Y");
+        auto zone_names = res->getString(5);
+        std::vector<std::string> zone_list = get_zone_list(zone_names);
+
+        monitor_logger_->debug("instanceName: " + instance_name + ", tag: " + tag);
+
+        mpp_infos.push_back(std::make_shared<MppInfo>(tag, role, instance_name, zone_list, is_leader));
     }
     return mpp_infos;
 }
@@ -419,20 +682,27 @@ std::vector<std::string> HaManager::get_zone_list(const std::string& zone_names)
 
 bool HaManager::save_mpp_to_file(const std::vector<std::shared_ptr<MppInfo>>& mpp, const std::string& filename) noexcept {
     try {
-        nlohmann::json jArray;
-        for (const auto& info : mpp) {
+        std::vector<std::shared_ptr<MppInfo>> sorted(mpp.begin(), mpp.end());
+        std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a->Tag < b->Tag; });
+
+        nlohmann::json jArray = nlohmann::json::array();
+        for (const auto& info : sorted) {
             auto item = info->to_json();
             jArray.push_back(item);
         }
 
-        std::ofstream file(filename);
-        if (!file.is_open()) {
-            monitor_logger_->info("Failed to open mpp file: " + filename);
-            return false;
+        std::string content = jArray.dump(4);
+        auto digest = std::hash<std::string>{}(content);
+        if (digest == mpp_file_digest_) {
+            // cn topology is unchanged, skip rewriting
+            return true;
         }
 
-        file << std::setw(4) << jArray << std::endl;
-        file.close();
+        if (!write_file_atomically(content, filename)) {
+            monitor_logger_->info("Failed to write mpp file: " + filename);
+            return false;
+        }
+        mpp_file_digest_ = digest;
     } catch (std::exception &e) {
         monitor_logger_->error(std::string("Failed to save mpp file: ") + filename + ", error: " + e.what());
         return false;
@@ -449,11 +719,17 @@ std::pair<std::vector<std::shared_ptr<MppInfo>>, bool> HaManager::load_mpp_from_
             return {{}, false};
         }
 
+        if (file.peek() == std::ifstream::traits_type::eof()) {
+            // freshly created placeholder
+            return {{}, false};
+        }
+
         nlohmann::json jArray;
         file >> jArray;
         file.close();
 
-        if (jArray.is_null()) {
+        if (!jArray.is_array() || jArray.empty()) {
+            monitor_logger_->info("Ignore malformed mpp file: " + filename);
             return {{}, false};
         }
 
@@ -471,6 +747,16 @@ std::pair<std::vector<std::shared_ptr<MppInfo>>, bool> HaManager::load_mpp_from_
 
 void HaManager::dn_ha_checker() {
     while (!stop_flag_) {
+        if (try_retire()) {
+            break;
+        }
+
+        if (p_cfg_->HostLocalProbe && !hold_probe_lock()) {
+            sync_dn_from_file();
+            wait_for_next_check(std::max(1, std::min(100, p_cfg_->HaCheckIntervalMillis)));
+            continue;
+        }
+
         {
             std::unique_lock<std::shared_mutex> lk(rw_mutex_);
             if (dn_cluster_info_->leader_transfer_info != nullptr) {
@@ -485,31 +771,40 @@ void HaManager::dn_ha_checker() {
         int32_t clusterState = 0;
         auto leader = dn_cluster_info_->LeaderInfo;
         auto conn = dn_cluster_info_->LongConnection;
+        std::shared_ptr<XClusterNodeBasic> suspect;
+        {
+            std::shared_lock<std::shared_mutex> lk(rw_mutex_);
+            suspect = dn_cluster_info_->SuspectLeader;
+        }
         if (leader != nullptr && conn != nullptr) {
             monitor_logger_->info("start ping leader");
             clusterState = ping_leader(leader, conn);
+        } else if (suspect != nullptr) {
+            monitor_logger_->info("start confirming suspect leader " + suspect->Tag);
+            clusterState = confirm_suspect_leader(suspect);
         } else {
             monitor_logger_->info("start full check");
             clusterState = fully_check();
         }
 
-        int interval = 0;
+        auto check_interval = p_cfg_->HaCheckIntervalMillis;
+        auto alive_floor = std::min(100, check_interval);
+        ProbeCadence cadence{0, 0};
         if (clusterState == LEADER_ALIVE) {
-            // leader is alive, retry in (~, 100] ms
-            interval = std::max(0, std::min(100, static_cast<int>(p_cfg_->HaCheckIntervalMillis)));
+            // leader is alive, ping every 100 ms; only backs off when haCheckMaxBackoff is raised
+            cadence = {alive_floor, std::min(check_interval, p_cfg_->HaCheckMaxBackoffMillis)};
         } else if (clusterState == LEADER_LOST) {
-            // leader is lost, retry in (~, 3000] ms
-            interval = std::max(0, std::min(3000, static_cast<int>(p_cfg_->HaCheckIntervalMillis)));
+            // leader is lost, retry in 100 ms backing off to 3000 ms
+            cadence = {alive_floor, std::min(3000, check_interval)};
         } else if (clusterState == LEADER_TRANSFERRING) {
-            // leader is transferring, retry in (~, transfer_time_out] ms
-            interval = std::max(0, static_cast<int>(p_cfg_->CheckLeaderTransferringIntervalMillis));
-        } else if (clusterState == LEADER_TRANSFERRED) {
-            // leader has transferrred, retry now
-            interval = 0;
+            // leader is transferring, retry in transfer_time_out ms
+            cadence = {p_cfg_->CheckLeaderTransferringIntervalMillis, p_cfg_->CheckLeaderTransferringIntervalMillis};
         }
+        // LEADER_TRANSFERRED / LEADER_SUSPECT retry now, the probe budget keeps a flapping state from spinning
 
+        auto interval = adjust_interval_for_idle(probe_scheduler_.next_interval(clusterState, cadence));
         if (interval > 0) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+            wait_for_next_check(interval);
         }
     }
 }
@@ -520,38 +815,176 @@ int32_t HaManager::ping_leader(const std::shared_ptr<XClusterNodeBasic> &leader,
     }
 
     try {
-        std::unique_ptr<sql::Statement> stmt(conn->createStatement());
-        std::unique_ptr<sql::ResultSet> res1(stmt->executeQuery(CLUSTER_LOCAL_QUERY));
-        while (res1->next()) {
-            auto role = res1->getString(2);
-            if (!caseInsensitiveEqual(role, "Leader")) {
-                std::unique_lock<std::shared_mutex> lk(rw_mutex_);
-                dn_cluster_info_->LeaderInfo.reset();
-                return LEADER_TRANSFERRED;
-            }
+        auto state = query_leader_state(*conn);
+        if (state == LEADER_TRANSFERRED) {
+            std::unique_lock<std::shared_mutex> lk(rw_mutex_);
+            dn_cluster_info_->LeaderInfo.reset();
+            return LEADER_TRANSFERRED;
         }
-    
-        std::unique_ptr<sql::ResultSet> res2(stmt->executeQuery(CHECK_LEADER_TRANSFER_QUERY));
-        while (res2->next()) {
-            auto is_transferring = res2->getInt(2);
-            if (is_transferring) {
-                std::unique_lock<std::shared_mutex> lk(rw_mutex_);
-                dn_cluster_info_->LeaderInfo.reset();
-                dn_cluster_info_->leader_transfer_info = std::make_shared<LeaderTransferInfo>(leader->Tag, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
-                return LEADER_TRANSFERRING;
-            }
+        if (state == LEADER_TRANSFERRING) {
+            std::unique_lock<std::shared_mutex> lk(rw_mutex_);
+            dn_cluster_info_->LeaderInfo.reset();
+            dn_cluster_info_->leader_transfer_info = std::make_shared<LeaderTransferInfo>(leader->Tag, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+            return LEADER_TRANSFERRING;
         }
-        
     } catch (sql::SQLException &e) {
         monitor_logger_->error(std::string("ping_leader failed: ") + e.what());
         std::unique_lock<std::shared_mutex> lk(rw_mutex_);
         dn_cluster_info_->LeaderInfo.reset();
+        if (p_cfg_->LeaderSuspectWindowMillis > 0) {
+            dn_cluster_info_->SuspectLeader = leader;
+            dn_cluster_info_->SuspectSinceNanos = now_nanos();
+            return LEADER_SUSPECT;
+        }
         return LEADER_LOST;
     }
 
     return LEADER_ALIVE;
 }
 
+int32_t HaManager::query_leader_state(sql::Connection &conn) {
+    std::unique_ptr<sql::Statement> stmt(conn.createStatement());
+    std::unique_ptr<sql::ResultSet> res1(stmt->executeQuery(CLUSTER_LOCAL_QUERY));
+    while (res1->next()) {
+        auto role = res1->getString(2);
+        if (!caseInsensitiveEqual(role, "Leader")) {
+            return LEADER_TRANSFERRED;
+        }
+    }
+
+    std::unique_ptr<sql::ResultSet> res2(stmt->executeQuery(CHECK_LEADER_TRANSFER_QUERY));
+    while (res2->next()) {
+        if (res2->getInt(2)) {
+            return LEADER_TRANSFERRING;
+        }
+    }
+    return LEADER_ALIVE;
+}
+
+std::shared_ptr<sql::Connection> HaManager::open_long_connection(const std::string &addr) {
+    sql::Driver* driver;
+    {
+        std::lock_guard<std::mutex> lock(driver_mutex_);
+        driver = sql::mysql::get_driver_instance();
+    }
+    sql::ConnectOptionsMap conn_props = p_cfg_->conn_properties_;
+    conn_props["hostName"] = addr;
+    conn_props[OPT_CONNECT_TIMEOUT] = 2;
+    return std::shared_ptr<sql::Connection>(driver->connect(conn_props));
+}
+
+int32_t HaManager::confirm_suspect_leader(const std::shared_ptr<XClusterNodeBasic> &suspect) {
+    // one short probe of the suspect alone; only when it fails do connects wait for the full check.
+    // It has to fit the suspect window, half for the connect and half for the ping. The connector
+    // takes whole seconds, so the window itself is enforced by the wait below and a probe that
+    // overruns it finishes on dn_probe_executor_ unheeded.
+    auto window_millis = std::max(1, p_cfg_->LeaderSuspectWindowMillis);
+    auto half_seconds = std::max(1, (window_millis / 2 + 999) / 1000);
+    sql::ConnectOptionsMap conn_props = p_cfg_->conn_properties_;
+    conn_props["hostName"] = suspect->Tag;
+    conn_props[OPT_CONNECT_TIMEOUT] = half_seconds;
+    conn_props[OPT_READ_TIMEOUT] = half_seconds;
+
+    struct Probe {
+        std::mutex mu;
+        std::condition_variable cv;
+        bool done = false;
+        int32_t state = LEADER_LOST;
+        std::string error;
+    };
+    auto probe = std::make_shared<Probe>();
+    if (dn_probe_executor_ == nullptr) {
+        dn_probe_executor_ = std::make_unique<ProbeExecutor>(2);
+    }
+    // touches no member, it may still run when the manager is gone
+    dn_probe_executor_->submit([probe, conn_props]() mutable {
+        int32_t state = LEADER_LOST;
+        std::string error;
+        try {
+            sql::Driver* driver;
+            {
+                std::lock_guard<std::mutex> lock(driver_mutex_);
+                driver = sql::mysql::get_driver_instance();
+            }
+            std::unique_ptr<sql::Connection> conn(driver->connect(conn_props));
+            state = query_leader_state(*conn);
+            conn->close();
+        } catch (sql::SQLException &e) {
+            error = e.what();
+        }
+        std::lock_guard<std::mutex> lk(probe->mu);
+        probe->state = state;
+        probe->error = error;
+        probe->done = true;
+        probe->cv.notify_all();
+    });
+
+    int32_t state = LEADER_LOST;
+    {
+        std::unique_lock<std::mutex> lk(probe->mu);
+        if (!probe->cv.wait_for(lk, std::chrono::milliseconds(window_millis), [&]() { return probe->done; })) {
+            monitor_logger_->error("confirm_suspect_leader timed out after " + std::to_string(window_millis) + "ms");
+        } else if (!probe->error.empty()) {
+            monitor_logger_->error("confirm_suspect_leader failed: " + probe->error);
+        }
+        state = probe->state;
+    }
+
+    if (state == LEADER_ALIVE) {
+        try {
+            // the probe connection carries the short read timeout, the long connection may not
+            install_leader(suspect, open_long_connection(suspect->Tag));
+            monitor_logger_->info("suspect leader " + suspect->Tag + " confirmed alive");
+            return LEADER_ALIVE;
+        } catch (sql::SQLException &e) {
+            monitor_logger_->error(std::string("confirm_suspect_leader failed: ") + e.what());
+        }
+    }
+
+    monitor_logger_->info("leader " + suspect->Tag + " confirmed lost");
+    {
+        std::unique_lock<std::shared_mutex> lk(rw_mutex_);
+        dn_cluster_info_->SuspectLeader.reset();
+    }
+    return fully_check();
+}
+
+void HaManager::install_leader(const std::shared_ptr<XClusterNodeBasic> &leader, std::shared_ptr<sql::Connection> conn) {
+    {
+        std::unique_lock<std::shared_mutex> lk(rw_mutex_);
+        dn_cluster_info_->LeaderInfo = leader;
+        dn_cluster_info_->SuspectLeader.reset();
+        dn_cluster_info_->leader_transfer_info.reset();
+        advance_epoch_locked(leader->Tag, epoch_cn_view_);
+        if (dn_cluster_info_->LongConnection != nullptr && !dn_cluster_info_->LongConnection->isClosed()) {
+            dn_cluster_info_->LongConnection->close();
+        }
+        dn_cluster_info_->LongConnection = conn;
+    }
+    waiters_.notify("dn:");
+    // warm up against the new leader before clients arrive there
+    warm_pool_->retarget_leader(leader->Tag);
+}
+
+bool HaManager::is_routable(const std::string& addr, bool leader) {
+    std::shared_lock<std::shared_mutex> lk(rw_mutex_);
+    if (is_dn_) {
+        if (leader) {
+            // a suspect leader keeps its warm connections until the loss is confirmed
+            auto current = dn_cluster_info_->LeaderInfo != nullptr ? dn_cluster_info_->LeaderInfo : dn_cluster_info_->SuspectLeader;
+            return current != nullptr && current->Tag == addr;
+        }
+        auto id = node_table_.find(addr);
+        return id != INVALID_NODE && node_table_.role(id) == NodeRole::FOLLOWER;
+    }
+    for (const auto& cn : cn_cluster_info_) {
+        if (cn != nullptr && cn->Tag == addr) {
+            return true;
+        }
+    }
+    return false;
+}
+
 int32_t HaManager::fully_check() {
     auto leader_exist = probe_and_update_leader();
     auto leader_transfer_info = dn_cluster_info_->leader_transfer_info;
@@ -577,6 +1010,22 @@ bool HaManager::probe_and_update_leader() {
 
     auto [leader, leader_exist] = check_leader_exist(dn_info_map);
     if (!leader_exist) {
+        // publish the loss, otherwise followers of a host-local prober keep routing to the old leader
+        std::vector<std::shared_ptr<XClusterNodeBasic>> dn_info_list;
+        for (const auto& [addr, info] : dn_info_map) {
+            if (info != nullptr) {
+                dn_info_list.push_back(info);
+            }
+        }
+        for (const auto& addr : connection_addresses_) {
+            if (dn_info_map.count(addr) == 0) {
+                // kept in the file as a seed for the next start
+                auto [host, port] = parseHostPort(addr);
+                dn_info_list.push_back(std::make_shared<XClusterNodeBasic>(addr, host, port, DN_ROLE_UNREACHABLE,
+                    std::vector<std::shared_ptr<XClusterNodeBasic>>{}, now_nanos()));
+            }
+        }
+        save_dn_to_file(dn_info_list, p_cfg_->JsonFile);
         return false;
     }
 
@@ -586,18 +1035,11 @@ bool HaManager::probe_and_update_leader() {
             dn_info_list.push_back(info);
         }
     }
+    node_table_.update_dn(dn_info_list);
     save_dn_to_file(dn_info_list, p_cfg_->JsonFile);
     
     try {
-        sql::Driver* driver;
-        {
-            std::lock_guard<std::mutex> lock(driver_mutex_);
-            driver = sql::mysql::get_driver_instance();
-        }
-        sql::ConnectOptionsMap conn_props = p_cfg_->conn_properties_;
-        conn_props["hostName"] = leader->Tag;
-        conn_props[OPT_CONNECT_TIMEOUT] = 2;
-        std::shared_ptr<sql::Connection> conn(driver->connect(conn_props));
+        auto conn = open_long_connection(leader->Tag);
         std::unique_ptr<sql::Statement> stmt(conn->createStatement());
         std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(CHECK_LEADER_TRANSFER_QUERY));
         while (res->next()) {
@@ -614,17 +1056,8 @@ bool HaManager::probe_and_update_leader() {
             }
         }
 
-        {
-            std::unique_lock<std::shared_mutex> lk(rw_mutex_);
-            dn_cluster_info_->LeaderInfo = leader;
-            dn_cluster_info_->leader_transfer_info.reset();
-            if (dn_cluster_info_->LongConnection != nullptr && !dn_cluster_info_->LongConnection->isClosed()) {
-                dn_cluster_info_->LongConnection->close();
-            }
-            dn_cluster_info_->LongConnection = conn;
-            conn_req_.notify_all();
-            return true;
-        }
+        install_leader(leader, conn);
+        return true;
     } catch (sql::SQLException &e) {
         monitor_logger_->error(std::string("probe_and_update_leader failed: ") + e.what());
         return false;
@@ -647,7 +1080,8 @@ void HaManager::update_connection_addresses() {
             if (success) {
                 for (const auto& node : nodes) {
                     if (node && (caseInsensitiveEqual(node->Role, "Leader") ||
-                                 caseInsensitiveEqual(node->Role, "Follower"))) {
+                                 caseInsensitiveEqual(node->Role, "Follower") ||
+                                 caseInsensitiveEqual(node->Role, DN_ROLE_UNREACHABLE))) {
                         connection_addresses.insert(get_address_without_protocol(node->Tag));
                     }
                 }
@@ -748,7 +1182,7 @@ std::shared_ptr<XClusterNodeBasic> HaManager::get_dn_info(const std::string &add
                 leader_port,
                 "Leader",
                 std::vector<std::shared_ptr<XClusterNodeBasic>>(),
-                std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count())
+                now_nanos()
             );
             dn_info = std::make_shared<XClusterNodeBasic>(
                 addr,
@@ -756,7 +1190,7 @@ std::shared_ptr<XClusterNodeBasic> HaManager::get_dn_info(const std::string &add
                 port,
                 role,
                 std::vector<std::shared_ptr<XClusterNodeBasic>>({leader_peer}),
-                std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count())
+                now_nanos()
             );
         } else {
             auto paxos_port_gap = port - leader_paxos_port;
@@ -778,7 +1212,7 @@ std::shared_ptr<XClusterNodeBasic> HaManager::get_dn_info(const std::string &add
                         peer_port,
                         peer_role,
                         std::vector<std::shared_ptr<XClusterNodeBasic>>(),
-                        std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count())
+                        now_nanos()
                     ));
                 }
             }
@@ -789,7 +1223,7 @@ std::shared_ptr<XClusterNodeBasic> HaManager::get_dn_info(const std::string &add
                 port,
                 role,
                 peers,
-                std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count())
+                now_nanos()
             );
         }
         conn->close();
@@ -818,31 +1252,31 @@ std::pair<std::shared_ptr<XClusterNodeBasic>, bool> HaManager::check_leader_exis
 
 bool HaManager::save_dn_to_file(const std::vector<std::shared_ptr<XClusterNodeBasic>>& nodes, const std::string& filename) noexcept {
     try {
-        nlohmann::json arr;
+        std::vector<std::shared_ptr<XClusterNodeBasic>> sorted;
         for (const auto& node : nodes) {
             if (node) {
-                arr.push_back(node->to_json());
+                sorted.push_back(node);
             }
         }
+        std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a->Tag < b->Tag; });
+
+        // update_time changes on every probe, so it is left out of the digest
+        std::string topology;
+        nlohmann::json arr = nlohmann::json::array();
+        for (const auto& node : sorted) {
+            topology += node->Tag + "|" + node->Role + ";";
+            arr.push_back(node->to_json());
+        }
 
-        std::string content = arr.dump(2);
-
-        auto temp_filename = filename + ".tmp";
-
-        std::ofstream ofs(temp_filename, std::ios::out | std::ios::trunc);
-        if (!ofs.is_open()) {
-            return false;
+        auto digest = std::hash<std::string>{}(topology);
+        if (digest == dn_file_digest_) {
+            return true;
         }
-        ofs << content << std::flush;
-        ofs.close();
 
-        if (!ofs.good()) {
-            fs::remove(temp_filename);
+        if (!write_file_atomically(arr.dump(2), filename)) {
             return false;
         }
-
-        fs::rename(temp_filename, filename);
-
+        dn_file_digest_ = digest;
         return true;
 
     } catch (const std::exception& e) {
@@ -851,6 +1285,50 @@ bool HaManager::save_dn_to_file(const std::vector<std::shared_ptr<XClusterNodeBa
     }
 }
 
+bool HaManager::write_file_atomically(const std::string& content, const std::string& filename) noexcept {
+    // temp file is private to this process, so concurrent writers never interleave
+    auto temp_filename = filename + ".tmp." + std::to_string(::getpid());
+
+    int fd = ::open(temp_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        monitor_logger_->error("Failed to open temp file: " + temp_filename + ", error: " + std::strerror(errno));
+        return false;
+    }
+
+    const char* data = content.data();
+    size_t remaining = content.size();
+    bool ok = true;
+    while (remaining > 0) {
+        ssize_t n = ::write(fd, data, remaining);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ok = false;
+            break;
+        }
+        data += n;
+        remaining -= static_cast<size_t>(n);
+    }
+    ok = ok && ::fsync(fd) == 0;
+    ok = (::close(fd) == 0) && ok;
+
+    if (!ok || ::rename(temp_filename.c_str(), filename.c_str()) != 0) {
+        monitor_logger_->error("Failed to replace file: " + filename + ", error: " + std::strerror(errno));
+        ::unlink(temp_filename.c_str());
+        return false;
+    }
+
+    // persist the rename itself
+    auto dir = fs::path(filename).parent_path();
+    int dir_fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+    if (dir_fd >= 0) {
+        ::fsync(dir_fd);
+        ::close(dir_fd);
+    }
+    return true;
+}
+
 std::pair<std::vector<std::shared_ptr<XClusterNodeBasic>>, bool> HaManager::load_dn_from_file(const std::string& filepath) noexcept {
     std::ifstream file(filepath);
     if (!file.is_open()) {
@@ -858,8 +1336,18 @@ std::pair<std::vector<std::shared_ptr<XClusterNodeBasic>>, bool> HaManager::load
     }
 
     try {
+        if (file.peek() == std::ifstream::traits_type::eof()) {
+            return {{}, false};
+        }
+
         nlohmann::json j;
         file >> j;
+        // an empty array is a valid publish: no node answered
+        if (!j.is_array()) {
+            monitor_logger_->info("Ignore malformed dn file: " + filepath);
+            return {{}, false};
+        }
+
         std::vector<std::shared_ptr<XClusterNodeBasic>> nodes;
         for (auto& item : j) {
             auto node = std::make_shared<XClusterNodeBasic>(XClusterNodeBasic::from_json(item));
@@ -872,6 +1360,220 @@ std::pair<std::vector<std::shared_ptr<XClusterNodeBasic>>, bool> HaManager::load
     }
 }
 
+bool HaManager::acquire() {
+    auto cnt = ref_cnt_.load();
+    while (cnt >= 0) {
+        bool was_idle = cnt == 0 && idle_for(p_cfg_->HaIdleTimeoutMillis);
+        if (ref_cnt_.compare_exchange_weak(cnt, cnt + 1)) {
+            if (cnt == 0) {
+                idle_since_nanos_ = 0;
+            }
+            if (was_idle) {
+                // leave the idle cadence right away so the first connects see fresh topology
+                std::lock_guard<std::mutex> lk(checker_mutex_);
+                checker_wakeup_ = true;
+                checker_cv_.notify_all();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void HaManager::release() {
+    if (ref_cnt_.fetch_sub(1) == 1) {
+        idle_since_nanos_ = now_nanos();
+    }
+}
+
+bool HaManager::idle_for(int32_t millis) {
+    if (ref_cnt_ != 0) {
+        return false;
+    }
+    auto since = idle_since_nanos_.load();
+    return since != 0 && now_nanos() - since >= static_cast<int64_t>(millis) * 1000000LL;
+}
+
+bool HaManager::try_retire() {
+    if (p_cfg_->HaShutdownTimeoutMillis <= 0 || !idle_for(p_cfg_->HaShutdownTimeoutMillis)) {
+        return false;
+    }
+
+    int64_t expected = 0;
+    if (!ref_cnt_.compare_exchange_strong(expected, -1)) {
+        return false;
+    }
+
+    monitor_logger_->info("No connection for " + std::to_string(p_cfg_->HaShutdownTimeoutMillis) + "ms, shut down ha checker");
+    // nobody rewrites the topology file from here on, let a follower take over probing
+    release_probe_lock();
+    std::unique_lock<std::shared_mutex> lk(rw_mutex_);
+    dn_cluster_info_->LongConnection.reset();
+    dn_cluster_info_->LeaderInfo.reset();
+    dn_cluster_info_->SuspectLeader.reset();
+    cn_cluster_info_.clear();
+    cn_topology_version_++;
+    advance_epoch_locked("", 0);
+    lk.unlock();
+
+    // a retired manager keeps no sessions open
+    warm_pool_->clear();
+    std::lock_guard<std::mutex> seed_lk(cn_seed_mutex_);
+    cn_probe_conns_.clear();
+    return true;
+}
+
+int32_t HaManager::adjust_interval_for_idle(int32_t interval) {
+    if (idle_for(p_cfg_->HaIdleTimeoutMillis)) {
+        return std::max(interval, p_cfg_->HaIdleCheckIntervalMillis);
+    }
+    return interval;
+}
+
+void HaManager::wait_for_next_check(int32_t interval) {
+    std::unique_lock<std::mutex> lk(checker_mutex_);
+    checker_cv_.wait_for(lk, std::chrono::milliseconds(interval), [this]() {
+        return stop_flag_.load() || checker_wakeup_;
+    });
+    checker_wakeup_ = false;
+}
+
+bool HaManager::hold_probe_lock() noexcept {
+    if (probe_lock_fd_ >= 0) {
+        return true;
+    }
+
+    auto lock_file = p_cfg_->JsonFile + ".lock";
+    int fd = ::open(lock_file.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        monitor_logger_->error("Failed to open probe lock file: " + lock_file + ", error: " + std::strerror(errno));
+        return false;
+    }
+
+    // the kernel drops the lock when the holder exits, which lets a follower take over
+    if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    monitor_logger_->info("Became host-local prober for " + p_cfg_->JsonFile);
+    probe_lock_fd_ = fd;
+    return true;
+}
+
+void HaManager::release_probe_lock() noexcept {
+    if (probe_lock_fd_ >= 0) {
+        ::flock(probe_lock_fd_, LOCK_UN);
+        ::close(probe_lock_fd_);
+        probe_lock_fd_ = -1;
+    }
+}
+
+bool HaManager::topology_file_changed() noexcept {
+    std::error_code ec;
+    auto mtime = fs::last_write_time(p_cfg_->JsonFile, ec);
+    struct stat st;
+    if (ec || ::stat(p_cfg_->JsonFile.c_str(), &st) != 0) {
+        return false;
+    }
+
+    // every publish renames a new file into place, so the inode tells rewrites apart
+    // even when the mtime granularity does not
+    TopologyFileStamp stamp{static_cast<int64_t>(mtime.time_since_epoch().count()), static_cast<int64_t>(st.st_ino),
+        static_cast<int64_t>(st.st_size)};
+    if (stamp == topology_file_stamp_) {
+        return false;
+    }
+    topology_file_stamp_ = stamp;
+    return true;
+}
+
+void HaManager::sync_dn_from_file() {
+    if (!topology_file_changed()) {
+        return;
+    }
+
+    auto [nodes, success] = load_dn_from_file(p_cfg_->JsonFile);
+    if (!success) {
+        return;
+    }
+    node_table_.update_dn(nodes);
+
+    std::string leader_tag;
+    for (const auto& node : nodes) {
+        if (caseInsensitiveEqual(node->Role, "Leader")) {
+            leader_tag = node->Tag;
+            break;
+        }
+    }
+
+    if (leader_tag.empty()) {
+        // the prober lost the leader, stop handing it out until one is published again
+        std::unique_lock<std::shared_mutex> lk(rw_mutex_);
+        if (dn_cluster_info_->LeaderInfo != nullptr || dn_cluster_info_->SuspectLeader != nullptr) {
+            monitor_logger_->info("Host-local prober published no leader");
+            dn_cluster_info_->LeaderInfo.reset();
+            dn_cluster_info_->SuspectLeader.reset();
+            advance_epoch_locked("", epoch_cn_view_);
+        }
+        return;
+    }
+
+    {
+        std::shared_lock<std::shared_mutex> lk(rw_mutex_);
+        if (dn_cluster_info_->LeaderInfo != nullptr && dn_cluster_info_->LeaderInfo->Tag == leader_tag) {
+            return;
+        }
+    }
+
+    // confirm the published leader once, this also refreshes GlobalPortGap for follower reads
+    auto leader = get_dn_info(leader_tag);
+    if (leader == nullptr || !caseInsensitiveEqual(leader->Role, "Leader")) {
+        // retry on the next poll
+        topology_file_stamp_ = {};
+        return;
+    }
+
+    monitor_logger_->info("Leader published by host-local prober: " + leader_tag);
+    {
+        std::unique_lock<std::shared_mutex> lk(rw_mutex_);
+        dn_cluster_info_->LeaderInfo = leader;
+        dn_cluster_info_->SuspectLeader.reset();
+        dn_cluster_info_->leader_transfer_info.reset();
+        advance_epoch_locked(leader->Tag, epoch_cn_view_);
+    }
+    waiters_.notify("dn:");
+    warm_pool_->retarget_leader(leader->Tag);
+}
+
+void HaManager::sync_mpp_from_file() {
+    if (!topology_file_changed()) {
+        return;
+    }
+
+    auto [mpp, success] = load_mpp_from_file(p_cfg_->JsonFile);
+    if (!success) {
+        return;
+    }
+
+    monitor_logger_->debug("Cn topology published by host-local prober, size is " + std::to_string(mpp.size()));
+    node_table_.update_cn(mpp, now_nanos());
+    auto cn_view = mpp_view_digest(mpp);
+    bool changed = false;
+    {
+        std::unique_lock<std::shared_mutex> lk(rw_mutex_);
+        cn_cluster_info_ = mpp;
+        changed = cn_view != epoch_cn_view_;
+        if (changed) {
+            cn_topology_version_++;
+        }
+        advance_epoch_locked(epoch_leader_, cn_view);
+    }
+    if (changed) {
+        waiters_.notify("cn:");
+    }
+}
+
 std::tuple<int, std::string, bool> HaManager::get_cluster_id_and_version(std::shared_ptr<PolarDBXConfig> p_cfg) {
     std::istringstream iss(p_cfg->Addr);
     std::string conn_addr;
@@ -922,13 +1624,60 @@ std::tuple<int, std::string, bool> HaManager::get_cluster_id_and_version(std::sh
     }
 }
 
+std::unique_ptr<sql::Connection> HaManager::take_warm_connection(const std::shared_ptr<const ParsedOptions>& parsed,
+    const sql::ConnectOptionsMap& options, const std::string& addr) {
+    bool leader = is_dn_ && !parsed->c_cfg->SlaveOnly;
+    return warm_pool_->take(parsed, options, addr, leader);
+}
+
+std::string HaManager::cluster_tag() const {
+    return gen_cluster_tag(p_cfg_->ClusterID, p_cfg_->Addr);
+}
+
+size_t HaManager::mpp_view_digest(const std::vector<std::shared_ptr<MppInfo>>& infos) {
+    std::vector<std::shared_ptr<MppInfo>> sorted(infos.begin(), infos.end());
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a->Tag < b->Tag; });
+    std::string view;
+    for (const auto& info : sorted) {
+        view += info->Tag + "|" + info->Role + "|" + info->InstanceName + "|" + (info->IsLeader ? "Y" : "N") + "|";
+        for (const auto& zone : info->ZoneList) {
+            view += zone + ",";
+        }
+        view += ";";
+    }
+    return std::hash<std::string>{}(view);
+}
+
+void HaManager::advance_epoch_locked(const std::string& leader_tag, size_t cn_view) {
+    if (leader_tag != epoch_leader_ || cn_view != epoch_cn_view_) {
+        epoch_leader_ = leader_tag;
+        epoch_cn_view_ = cn_view;
+        topology_epoch_++;
+    }
+}
+
+void HaManager::report_node_error(const std::string& addr) {
+    if (!probe_scheduler_.tighten()) {
+        return;
+    }
+    driver_logger_->info("connect to " + addr + " failed, check the cluster now");
+    std::lock_guard<std::mutex> lk(checker_mutex_);
+    checker_wakeup_ = true;
+    checker_cv_.notify_all();
+}
+
 void HaManager::add_conn_count(const std::string& addr) {
-    conn_cnt_[addr]++;
+    auto id = node_table_.intern(addr);
+    if (id != INVALID_NODE) {
+        node_table_.add_conn(id);
+    }
 }
 
 void HaManager::drop_conn_count(const std::string& addr) {
-    std::unique_lock<std::shared_mutex> lk(rw_mutex_);
-    conn_cnt_[addr]--;
+    auto id = node_table_.intern(addr);
+    if (id != INVALID_NODE) {
+        node_table_.drop_conn(id);
+    }
 }
 
 } // namespace polardbx
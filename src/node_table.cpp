@@ -0,0 +1,175 @@
+#include "node_table.h"
+#include "const.hpp"
+#include "utils.hpp"
+#include <mutex>
+#include <tuple>
+
+namespace sql {
+namespace polardbx {
+
+NodeRole parse_dn_role(const std::string& role) {
+    if (caseInsensitiveEqual(role, "Leader")) {
+        return NodeRole::LEADER;
+    } else if (caseInsensitiveEqual(role, "Follower")) {
+        return NodeRole::FOLLOWER;
+    } else if (caseInsensitiveEqual(role, "Learner")) {
+        return NodeRole::LEARNER;
+    } else if (caseInsensitiveEqual(role, "Logger")) {
+        return NodeRole::LOGGER;
+    }
+    return NodeRole::UNKNOWN;
+}
+
+NodeRole parse_cn_role(const std::string& role) {
+    if (caseInsensitiveEqual(role, W)) {
+        return NodeRole::CN_W;
+    } else if (caseInsensitiveEqual(role, R)) {
+        return NodeRole::CN_R;
+    } else if (caseInsensitiveEqual(role, CR)) {
+        return NodeRole::CN_CR;
+    }
+    return NodeRole::UNKNOWN;
+}
+
+PackedAddr PackedAddr::parse(const std::string& tag) {
+    PackedAddr addr;
+    std::string host;
+    try {
+        uint32_t port;
+        std::tie(host, port) = parseHostPort(tag);
+        addr.Port = static_cast<uint16_t>(port);
+    } catch (std::exception& e) {
+        // not host:port, e.g. a bracketed IPv6 address; routing only needs the tag
+        return addr;
+    }
+    if (inet_pton(AF_INET, host.c_str(), addr.Ip.data()) == 1) {
+        addr.Family = AF_INET;
+    } else if (inet_pton(AF_INET6, host.c_str(), addr.Ip.data()) == 1) {
+        addr.Family = AF_INET6;
+    } else {
+        addr.Ip.fill(0);
+    }
+    return addr;
+}
+
+NodeTable::NodeTable() {
+    for (auto& chunk : chunks_) {
+        chunk.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+NodeTable::~NodeTable() {
+    for (auto& chunk : chunks_) {
+        delete[] chunk.load(std::memory_order_relaxed);
+    }
+}
+
+NodeId NodeTable::find(const std::string& tag) const {
+    std::shared_lock<std::shared_mutex> lk(mutex_);
+    auto it = ids_.find(tag);
+    return it == ids_.end() ? INVALID_NODE : it->second;
+}
+
+NodeId NodeTable::intern(const std::string& tag) {
+    auto id = find(tag);
+    if (id != INVALID_NODE) {
+        return id;
+    }
+
+    std::unique_lock<std::shared_mutex> lk(mutex_);
+    auto it = ids_.find(tag);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+
+    id = size_.load(std::memory_order_relaxed);
+    if ((id >> CHUNK_BITS) >= MAX_CHUNKS) {
+        return INVALID_NODE;
+    }
+    if ((id & (CHUNK_SIZE - 1)) == 0) {
+        chunks_[id >> CHUNK_BITS].store(new Node[CHUNK_SIZE], std::memory_order_release);
+    }
+    auto& record = node(id);
+    record.Tag = tag;
+    record.Addr = PackedAddr::parse(tag);
+    ids_.emplace(tag, id);
+    size_.store(id + 1, std::memory_order_release);
+    return id;
+}
+
+std::vector<NodeId> NodeTable::peers(NodeId id) const {
+    std::shared_lock<std::shared_mutex> lk(mutex_);
+    const auto& record = node(id);
+    auto begin = peer_index_.begin() + record.PeerBegin;
+    return {begin, begin + record.PeerCount};
+}
+
+void NodeTable::update_dn(const std::vector<std::shared_ptr<XClusterNodeBasic>>& nodes) {
+    // intern outside the write lock below, intern takes it itself
+    std::vector<std::pair<NodeId, std::vector<NodeId>>> reported;
+    for (const auto& info : nodes) {
+        if (info == nullptr) {
+            continue;
+        }
+        auto id = intern(info->Tag);
+        if (id == INVALID_NODE) {
+            continue;
+        }
+        node(id).Role.store(parse_dn_role(info->Role), std::memory_order_relaxed);
+        node(id).UpdateNanos.store(info->UpdateTime, std::memory_order_relaxed);
+
+        std::vector<NodeId> peer_ids;
+        for (const auto& peer : info->Peers) {
+            auto peer_id = peer == nullptr ? INVALID_NODE : intern(peer->Tag);
+            if (peer_id != INVALID_NODE) {
+                peer_ids.push_back(peer_id);
+            }
+        }
+        // a node reported without peers, e.g. only seen as someone else's peer, keeps its old ones
+        if (!peer_ids.empty()) {
+            reported.emplace_back(id, std::move(peer_ids));
+        }
+    }
+    if (reported.empty()) {
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> lk(mutex_);
+    uint32_t count = size_.load(std::memory_order_relaxed);
+    std::vector<const std::vector<NodeId>*> replaced(count, nullptr);
+    for (const auto& [id, peer_ids] : reported) {
+        replaced[id] = &peer_ids;
+    }
+
+    // compact rebuild: the index holds exactly one span per node
+    std::vector<NodeId> index;
+    for (NodeId id = 0; id < count; id++) {
+        auto& record = node(id);
+        auto begin = static_cast<uint32_t>(index.size());
+        if (replaced[id] != nullptr) {
+            index.insert(index.end(), replaced[id]->begin(), replaced[id]->end());
+        } else {
+            index.insert(index.end(), peer_index_.begin() + record.PeerBegin,
+                         peer_index_.begin() + record.PeerBegin + record.PeerCount);
+        }
+        record.PeerBegin = begin;
+        record.PeerCount = static_cast<uint32_t>(index.size()) - begin;
+    }
+    peer_index_.swap(index);
+}
+
+void NodeTable::update_cn(const std::vector<std::shared_ptr<MppInfo>>& cns, int64_t update_nanos) {
+    for (const auto& cn : cns) {
+        if (cn == nullptr) {
+            continue;
+        }
+        auto id = intern(cn->Tag);
+        if (id != INVALID_NODE) {
+            node(id).Role.store(parse_cn_role(cn->Role), std::memory_order_relaxed);
+            node(id).UpdateNanos.store(update_nanos, std::memory_order_relaxed);
+        }
+    }
+}
+
+} // namespace polardbx
+} // namespace sql
@@ -0,0 +1,489 @@
+#include "option_registry.h"
+#include "cn_selector.h"
+#include "utils.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <jdbc/cppconn/exception.h>
+
+namespace sql {
+namespace polardbx {
+
+namespace {
+
+template <typename T> struct member_traits;
+template <typename C, typename T> struct member_traits<T C::*> {
+    using class_type = C;
+    using value_type = T;
+};
+
+template <typename T> constexpr OptionType option_type_of() {
+    if constexpr (std::is_same_v<T, int32_t>) {
+        return OptionType::INT32;
+    } else if constexpr (std::is_same_v<T, bool> || std::is_same_v<T, CopyableAtomic<bool>>) {
+        return OptionType::BOOL;
+    } else {
+        static_assert(std::is_same_v<T, std::string>, "unsupported option field type");
+        return OptionType::STRING;
+    }
+}
+
+const char* type_name(OptionType type) {
+    switch (type) {
+        case OptionType::INT32: return "int32_t";
+        case OptionType::BOOL: return "bool";
+        case OptionType::STRING: return "string (SQLString)";
+    }
+    return "";
+}
+
+template <typename C, typename P> auto& config_of(P& parsed) {
+    if constexpr (std::is_same_v<C, PolarDBXConfig>) {
+        return *parsed.p_cfg;
+    } else if constexpr (std::is_same_v<C, ConnectionConfig>) {
+        return *parsed.c_cfg;
+    } else {
+        return parsed;
+    }
+}
+
+void store(int32_t& target, const sql::ConnectPropertyVal& val) { target = *val.get<int32_t>(); }
+void store(bool& target, const sql::ConnectPropertyVal& val) { target = *val.get<bool>(); }
+void store(CopyableAtomic<bool>& target, const sql::ConnectPropertyVal& val) { target.store(*val.get<bool>()); }
+void store(std::string& target, const sql::ConnectPropertyVal& val) { target = std::string(*val.get<sql::SQLString>()); }
+
+void append_value(std::string& out, int32_t v) { out += std::to_string(v); }
+void append_value(std::string& out, bool v) { out += std::to_string(v); }
+void append_value(std::string& out, const CopyableAtomic<bool>& v) { out += std::to_string(v.load()); }
+void append_value(std::string& out, const std::string& v) { out += v; }
+
+template <auto Field>
+void assign_option(ParsedOptions& parsed, const sql::ConnectPropertyVal& val) {
+    using traits = member_traits<decltype(Field)>;
+    store(config_of<typename traits::class_type>(parsed).*Field, val);
+}
+
+template <auto Field>
+void serialize_option(const ParsedOptions& parsed, std::string& out) {
+    using traits = member_traits<decltype(Field)>;
+    append_value(out, config_of<typename traits::class_type>(parsed).*Field);
+}
+
+template <auto Field, bool Recorded = true>
+constexpr OptionSpec option(std::string_view name) {
+    using traits = member_traits<decltype(Field)>;
+    return {name, option_type_of<typename traits::value_type>(), &assign_option<Field>,
+            Recorded ? &serialize_option<Field> : nullptr};
+}
+
+// To add an option: define OPT_* in config.h, add the field to the config, and add a row here.
+constexpr std::array OPTIONS {
+    option<&PolarDBXConfig::ClusterID>(OPT_CLUSTERID),
+    option<&PolarDBXConfig::HaCheckConnectTimeoutMillis>(OPT_HA_CHECK_CONNECT_TIMEOUT),
+    option<&PolarDBXConfig::HaCheckSocketTimeoutMillis>(OPT_HA_CHECK_SOCKET_TIMEOUT),
+    option<&PolarDBXConfig::HaCheckIntervalMillis>(OPT_HA_CHECK_INTERVAL),
+    option<&PolarDBXConfig::CheckLeaderTransferringIntervalMillis>(OPT_CHECK_LEADER_TRANSFERRING_INTERVAL),
+    option<&PolarDBXConfig::LeaderTransferringWaitTimeoutMillis>(OPT_LEADER_TRANSFERRING_WAIT_TIMEOUT),
+    option<&PolarDBXConfig::LeaderSuspectWindowMillis>(OPT_LEADER_SUSPECT_WINDOW),
+    option<&PolarDBXConfig::SmoothSwitchover>(OPT_SMOOTH_SWITCHOVER),
+    option<&PolarDBXConfig::IgnoreVip>(OPT_IGNORE_VIP),
+    option<&PolarDBXConfig::JsonFile>(OPT_JSON_FILE),
+    option<&PolarDBXConfig::EnableLog>(OPT_ENABLE_LOG),
+    option<&PolarDBXConfig::HostLocalProbe>(OPT_HOST_LOCAL_PROBE),
+    option<&PolarDBXConfig::HaIdleTimeoutMillis>(OPT_HA_IDLE_TIMEOUT),
+    option<&PolarDBXConfig::HaIdleCheckIntervalMillis>(OPT_HA_IDLE_CHECK_INTERVAL),
+    option<&PolarDBXConfig::HaShutdownTimeoutMillis>(OPT_HA_SHUTDOWN_TIMEOUT),
+    option<&PolarDBXConfig::CnProbeQuorum>(OPT_CN_PROBE_QUORUM),
+    option<&PolarDBXConfig::HaCheckMaxBackoffMillis>(OPT_HA_CHECK_MAX_BACKOFF),
+    option<&PolarDBXConfig::HaProbeBudget>(OPT_HA_PROBE_BUDGET),
+    option<&PolarDBXConfig::ConnectConcurrency>(OPT_CONNECT_CONCURRENCY),
+    option<&PolarDBXConfig::ConnectRate>(OPT_CONNECT_RATE),
+    option<&ConnectionConfig::ConnectTimeoutMillis>(OPT_POLARDBX_CONNECT_TIMEOUT),
+    option<&ConnectionConfig::SlaveOnly>(OPT_SLAVE_ONLY),
+    option<&ConnectionConfig::SlaveWeightThreshold>(OPT_SLAVE_WEIGHT_THRESHOLD),
+    option<&ConnectionConfig::ApplyDelayThreshold>(OPT_APPLY_DELAY_THRESHOLD),
+    option<&ConnectionConfig::LoadBalanceAlgorithm>(OPT_LOAD_BALANCE_ALGORITHM),
+    option<&ConnectionConfig::ZoneName>(OPT_ZONE_NAME),
+    option<&ConnectionConfig::MinZoneNodes>(OPT_MIN_ZONE_NODES),
+    option<&ConnectionConfig::BackupZoneName>(OPT_BACKUP_ZONE_NAME),
+    option<&ConnectionConfig::InstanceName>(OPT_INSTANCE_NAME),
+    option<&ConnectionConfig::MppRole>(OPT_MPP_ROLE),
+    option<&ConnectionConfig::EnableFollowerRead>(OPT_ENABLE_FOLLOWER_READ),
+    option<&ConnectionConfig::WarmConnections>(OPT_WARM_CONNECTIONS),
+    option<&ConnectionConfig::PrepStmtCacheSize>(OPT_PREP_STMT_CACHE_SIZE),
+    option<&ConnectionConfig::AllowMultiQueries>(OPT_ALLOW_MULTI_QUERIES),
+    option<&ConnectionConfig::StreamBufferSize>(OPT_STREAM_BUFFER_SIZE),
+    option<&ConnectionConfig::ResultCacheSize>(OPT_RESULT_CACHE_SIZE),
+    option<&ConnectionConfig::ResultCacheTtlMillis>(OPT_RESULT_CACHE_TTL),
+    option<&ConnectionConfig::ConnectPriority>(OPT_CONNECT_PRIORITY),
+    option<&ParsedOptions::RecordJdbcUrl, false>(OPT_RECORD_JDBC_URL),
+    option<&ParsedOptions::DirectMode, false>(OPT_DIRECT_MODE),
+};
+
+// perfect hash: a seed under which every option name lands in its own slot
+constexpr size_t OPTION_SLOTS = 128;
+static_assert(OPTIONS.size() <= OPTION_SLOTS / 2, "grow OPTION_SLOTS");
+
+constexpr uint32_t fnv1a(std::string_view s, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (char c : s) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 16777619u;
+    }
+    // fold the high bits in, the low bits of a plain fnv1a barely depend on the seed
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    return h;
+}
+
+constexpr bool is_perfect(uint32_t seed) {
+    std::array<bool, OPTION_SLOTS> used {};
+    for (const auto& spec : OPTIONS) {
+        auto slot = fnv1a(spec.name, seed) % OPTION_SLOTS;
+        if (used[slot]) {
+            return false;
+        }
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t find_seed() {
+    uint32_t seed = 0;
+    while (!is_perfect(seed)) {
+        ++seed;
+    }
+    return seed;
+}
+
+constexpr uint32_t OPTION_SEED = find_seed();
+
+constexpr std::array<int8_t, OPTION_SLOTS> build_slots() {
+    std::array<int8_t, OPTION_SLOTS> slots {};
+    for (auto& slot : slots) {
+        slot = -1;
+    }
+    for (size_t i = 0; i < OPTIONS.size(); ++i) {
+        slots[fnv1a(OPTIONS[i].name, OPTION_SEED) % OPTION_SLOTS] = static_cast<int8_t>(i);
+    }
+    return slots;
+}
+
+constexpr std::array<int8_t, OPTION_SLOTS> SLOTS = build_slots();
+
+// Standard connector options that are only passed through, typed so the cache key needs no probing.
+const std::unordered_map<std::string, OptionType>& passthrough_types() {
+    static const std::unordered_map<std::string, OptionType> types {
+        {OPT_HOSTNAME, OptionType::STRING},
+        {OPT_USERNAME, OptionType::STRING},
+        {OPT_PASSWORD, OptionType::STRING},
+        {OPT_SCHEMA, OptionType::STRING},
+        {OPT_PORT, OptionType::INT32},
+        {OPT_CONNECT_TIMEOUT, OptionType::INT32},
+        {OPT_READ_TIMEOUT, OptionType::INT32},
+        {OPT_WRITE_TIMEOUT, OptionType::INT32},
+        {OPT_RETRY_COUNT, OptionType::INT32},
+        {OPT_RECONNECT, OptionType::BOOL},
+    };
+    return types;
+}
+
+bool append_typed(std::string& key, OptionType type, const sql::ConnectPropertyVal& val) {
+    switch (type) {
+        case OptionType::INT32:
+            key += 'i';
+            key += std::to_string(*val.get<int32_t>());
+            return true;
+        case OptionType::BOOL:
+            key += *val.get<bool>() ? "b1" : "b0";
+            return true;
+        case OptionType::STRING: {
+            const std::string& s = *val.get<sql::SQLString>();
+            key += 's';
+            key += std::to_string(s.size());
+            key += ':';
+            key += s;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Builds a key identifying the map contents, returns false if some value cannot be represented.
+bool build_cache_key(const sql::ConnectOptionsMap& options, std::string& key) {
+    for (const auto& [name, val] : options) {
+        const std::string& n = name;
+        key += n;
+        key += '=';
+
+        auto spec = find_option(n);
+        if (spec != nullptr) {
+            try {
+                append_typed(key, spec->type, val);
+            } catch (sql::InvalidArgumentException&) {
+                throw sql::InvalidArgumentException("Wrong type passed for " + n + " expected " + type_name(spec->type));
+            }
+        } else {
+            auto it = passthrough_types().find(n);
+            bool done = false;
+            if (it != passthrough_types().end()) {
+                try {
+                    done = append_typed(key, it->second, val);
+                } catch (sql::InvalidArgumentException&) {
+                }
+            }
+            for (auto type : {OptionType::STRING, OptionType::INT32, OptionType::BOOL}) {
+                if (done) {
+                    break;
+                }
+                try {
+                    done = append_typed(key, type, val);
+                } catch (sql::InvalidArgumentException&) {
+                }
+            }
+            if (!done) {
+                return false;
+            }
+        }
+        key += ';';
+    }
+    return true;
+}
+
+std::shared_ptr<ParsedOptions> parse_uncached(const sql::ConnectOptionsMap& options) {
+    auto parsed = std::make_shared<ParsedOptions>();
+    parsed->p_cfg = std::make_shared<PolarDBXConfig>();
+    parsed->c_cfg = std::make_shared<ConnectionConfig>();
+
+    std::string host_name = "127.0.0.1";
+    int port = 3306;
+
+    for (const auto& [name, val] : options) {
+        const std::string& n = name;
+        auto spec = find_option(n);
+        if (spec != nullptr) {
+            try {
+                spec->assign(*parsed, val);
+            } catch (sql::InvalidArgumentException&) {
+                throw sql::InvalidArgumentException("Wrong type passed for " + n + " expected " + type_name(spec->type));
+            }
+        } else if (n == OPT_HOSTNAME) {
+            try {
+                host_name = *val.get<sql::SQLString>();
+            } catch (sql::InvalidArgumentException&) {
+                throw sql::InvalidArgumentException("Wrong type passed for hostName expected sql::SQLString");
+            }
+        } else if (n == OPT_PORT) {
+            try {
+                port = *val.get<int>();
+            } catch (sql::InvalidArgumentException&) {
+                throw sql::InvalidArgumentException("Wrong type passed for port expected int");
+            }
+        }
+    }
+
+    if (parsed->DirectMode) {
+        return parsed;
+    }
+
+    const auto& c_cfg = *parsed->c_cfg;
+    parsed->c_cfg->CompiledCnFilter = CnFilter::compile(c_cfg.ZoneName, c_cfg.MinZoneNodes, c_cfg.BackupZoneName,
+        c_cfg.SlaveOnly, c_cfg.InstanceName, c_cfg.MppRole);
+    parsed->c_cfg->CompiledConnectClass = parse_connect_class(c_cfg.ConnectPriority);
+
+    parsed->p_cfg->set_addr(host_name, port);
+    parsed->p_cfg->set_conn_props(options);
+
+    if (parsed->RecordJdbcUrl) {
+        // [&param1=value1&param2=value2]
+        for (const auto& [name, val] : options) {
+            auto spec = find_option(static_cast<const std::string&>(name));
+            if (spec != nullptr && spec->serialize != nullptr) {
+                parsed->JdbcUrl += '&';
+                parsed->JdbcUrl += spec->name;
+                parsed->JdbcUrl += '=';
+                spec->serialize(*parsed, parsed->JdbcUrl);
+            }
+        }
+        parsed->JdbcUrl += '&';
+        parsed->JdbcUrl += OPT_HOSTNAME;
+        parsed->JdbcUrl += '=';
+        parsed->JdbcUrl += parsed->p_cfg->Addr;
+    }
+    return parsed;
+}
+
+std::string percent_decode(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '%' && i + 2 < s.size() && std::isxdigit(static_cast<unsigned char>(s[i + 1])) &&
+            std::isxdigit(static_cast<unsigned char>(s[i + 2]))) {
+            out += static_cast<char>(std::stoi(s.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            out += s[i];
+        }
+    }
+    return out;
+}
+
+sql::ConnectPropertyVal typed_value(const std::string& name, OptionType type, const std::string& value) {
+    switch (type) {
+        case OptionType::INT32: {
+            size_t end = 0;
+            int v = 0;
+            try {
+                v = std::stoi(value, &end);
+            } catch (std::exception&) {
+                end = 0;
+            }
+            if (end == 0 || end != value.size()) {
+                throw sql::InvalidArgumentException("Wrong value passed for " + name + " expected int32_t");
+            }
+            return v;
+        }
+        case OptionType::BOOL:
+            if (value == "1" || caseInsensitiveEqual(value, "true")) {
+                return true;
+            } else if (value == "0" || caseInsensitiveEqual(value, "false")) {
+                return false;
+            }
+            throw sql::InvalidArgumentException("Wrong value passed for " + name + " expected bool");
+        case OptionType::STRING:
+            break;
+    }
+    return sql::SQLString(value);
+}
+
+// unknown options are forwarded to the connector, numbers and true/false keep their natural type
+sql::ConnectPropertyVal guess_value(const std::string& value) {
+    if (!value.empty() && value.size() < 10 &&
+        std::all_of(value.begin(), value.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        return std::stoi(value);
+    }
+    if (caseInsensitiveEqual(value, "true")) {
+        return true;
+    }
+    if (caseInsensitiveEqual(value, "false")) {
+        return false;
+    }
+    return sql::SQLString(value);
+}
+
+} // namespace
+
+const OptionSpec* find_option(std::string_view name) {
+    auto idx = SLOTS[fnv1a(name, OPTION_SEED) % OPTION_SLOTS];
+    if (idx < 0 || OPTIONS[idx].name != name) {
+        return nullptr;
+    }
+    return &OPTIONS[idx];
+}
+
+std::shared_ptr<const ParsedOptions> parse_connect_options(const sql::ConnectOptionsMap& options) {
+    constexpr size_t MAX_CACHED_OPTIONS = 256;
+    static std::mutex cache_mutex;
+    static std::unordered_map<std::string, std::shared_ptr<const ParsedOptions>> cache;
+
+    std::string key;
+    if (!build_cache_key(options, key)) {
+        return parse_uncached(options);
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(cache_mutex);
+        auto it = cache.find(key);
+        if (it != cache.end()) {
+            return it->second;
+        }
+    }
+
+    auto parsed = parse_uncached(options);
+    parsed->CacheKey = key;
+
+    std::lock_guard<std::mutex> lk(cache_mutex);
+    if (cache.size() >= MAX_CACHED_OPTIONS) {
+        cache.clear();
+    }
+    cache.emplace(std::move(key), parsed);
+    return parsed;
+}
+
+std::shared_ptr<const ParsedOptions> parse_dsn(const std::string& dsn) {
+    const std::string scheme = "polardbx://";
+    if (dsn.compare(0, scheme.size(), scheme) != 0) {
+        throw sql::InvalidArgumentException("Invalid dsn, expected " + scheme + " prefix");
+    }
+
+    std::string rest = dsn.substr(scheme.size());
+    std::string query;
+    auto pos = rest.find('?');
+    if (pos != std::string::npos) {
+        query = rest.substr(pos + 1);
+        rest.resize(pos);
+    }
+
+    sql::ConnectOptionsMap options;
+    pos = rest.find('@');
+    if (pos != std::string::npos) {
+        auto user_info = rest.substr(0, pos);
+        rest = rest.substr(pos + 1);
+        auto colon = user_info.find(':');
+        options[OPT_USERNAME] = sql::SQLString(percent_decode(user_info.substr(0, colon)));
+        if (colon != std::string::npos) {
+            options[OPT_PASSWORD] = sql::SQLString(percent_decode(user_info.substr(colon + 1)));
+        }
+    }
+
+    pos = rest.find('/');
+    if (pos != std::string::npos) {
+        auto schema = percent_decode(rest.substr(pos + 1));
+        if (!schema.empty()) {
+            options[OPT_SCHEMA] = sql::SQLString(schema);
+        }
+        rest.resize(pos);
+    }
+    if (rest.empty()) {
+        throw sql::InvalidArgumentException("Invalid dsn, no host given");
+    }
+    options[OPT_HOSTNAME] = sql::SQLString(rest);
+
+    std::istringstream iss(query);
+    std::string param;
+    while (getline(iss, param, '&')) {
+        if (param.empty()) {
+            continue;
+        }
+        auto eq = param.find('=');
+        auto name = percent_decode(param.substr(0, eq));
+        auto value = eq == std::string::npos ? std::string("true") : percent_decode(param.substr(eq + 1));
+
+        auto spec = find_option(name);
+        if (spec != nullptr) {
+            options[name] = typed_value(name, spec->type, value);
+            continue;
+        }
+        auto it = passthrough_types().find(name);
+        if (it != passthrough_types().end()) {
+            options[name] = typed_value(name, it->second, value);
+        } else {
+            options[name] = guess_value(value);
+        }
+    }
+
+    auto parsed = parse_uncached(options);
+    if (!build_cache_key(options, parsed->CacheKey)) {
+        parsed->CacheKey.clear();
+    }
+    parsed->ConnectOptions = std::move(options);
+    return parsed;
+}
+
+} // namespace polardbx
+} // namespace sql
@@ -0,0 +1,224 @@
+#include "parallel_scan.h"
+#include "polardbx_driver.h"
+#include "config.h"
+#include "const.hpp"
+#include <algorithm>
+
+namespace sql {
+namespace polardbx {
+
+std::vector<std::string> ParallelScan::expand(const std::string& query_template,
+    const std::vector<std::string>& predicates) {
+    std::string placeholder = PARTITION_PLACEHOLDER;
+    if (query_template.find(placeholder) == std::string::npos) {
+        throw sql::InvalidArgumentException("query template has no " + placeholder + " placeholder");
+    }
+    std::vector<std::string> queries;
+    for (const auto& predicate : predicates) {
+        std::string query;
+        size_t from = 0;
+        for (auto pos = query_template.find(placeholder); pos != std::string::npos;
+             pos = query_template.find(placeholder, from)) {
+            query.append(query_template, from, pos - from);
+            query += "(" + predicate + ")";
+            from = pos + placeholder.size();
+        }
+        query.append(query_template, from, std::string::npos);
+        queries.push_back(std::move(query));
+    }
+    return queries;
+}
+
+ParallelScan::ParallelScan(const sql::ConnectOptionsMap& options, std::vector<std::string> queries,
+    size_t parallelism, Merge merge)
+    : options_(options), queries_(std::move(queries)), merge_(merge) {
+    if (options_.find(OPT_LOAD_BALANCE_ALGORITHM) == options_.end()) {
+        options_[OPT_LOAD_BALANCE_ALGORITHM] = std::string(LEAST_CONN);
+    }
+    parallelism = std::clamp<size_t>(parallelism, 1, std::max<size_t>(1, queries_.size()));
+    window_ = parallelism;
+    max_rows_ = SCAN_QUEUE_ROWS_PER_PIECE * parallelism;
+    pieces_.resize(queries_.size());
+    for (size_t i = 0; i < parallelism; i++) {
+        workers_.emplace_back([this]() { work(); });
+    }
+}
+
+ParallelScan::~ParallelScan() {
+    close();
+}
+
+void ParallelScan::close() {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers_.clear();
+    // pieces not read to the end release their connections here
+    pieces_.clear();
+    rows_.clear();
+}
+
+ParallelScan::Piece::~Piece() {
+    Cursor.reset();
+    if (Conn == nullptr) {
+        return;
+    }
+    try {
+        if (!Conn->isClosed()) {
+            Conn->close();
+        }
+    } catch (sql::SQLException&) {
+        // nothing left to give back, the connector only refuses to close a closed session
+    }
+}
+
+std::unique_ptr<ParallelScan::Piece> ParallelScan::open(size_t index) {
+    auto options = options_;
+    auto piece = std::make_unique<Piece>();
+    piece->Conn = std::make_unique<PolarDBX_Connection>(get_polardbx_driver_instance(), options);
+    piece->Cursor = piece->Conn->executeStreaming(queries_[index]);
+    return piece;
+}
+
+void ParallelScan::fail(const sql::SQLException& e) {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (!error_) {
+            error_ = e;
+        }
+        stop_ = true;
+    }
+    cv_.notify_all();
+}
+
+void ParallelScan::work() {
+    while (true) {
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lk(mutex_);
+            if (merge_ == Merge::ORDERED) {
+                // pieces the consumer has not reached yet stay within the window
+                cv_.wait(lk, [this]() { return stop_ || next_piece_ >= queries_.size() || next_piece_ < current_ + window_; });
+            }
+            if (stop_ || next_piece_ >= queries_.size()) {
+                return;
+            }
+            index = next_piece_++;
+        }
+
+        std::unique_ptr<Piece> piece;
+        try {
+            piece = open(index);
+        } catch (sql::SQLException& e) {
+            fail(e);
+            return;
+        } catch (std::exception& e) {
+            // e.g. a bad option rejected by the connection, on this thread it would terminate the process
+            fail(sql::SQLException(std::string("parallel scan failed: ") + e.what()));
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            if (columns_.empty()) {
+                columns_ = piece->Cursor->columns();
+            }
+            if (merge_ == Merge::ORDERED) {
+                if (!stop_) {
+                    pieces_[index] = std::move(piece);
+                }
+            }
+        }
+        cv_.notify_all();
+        if (merge_ == Merge::ORDERED) {
+            // a piece dropped because of stop_ closes here, outside the lock
+            continue;
+        }
+
+        try {
+            RowCursor::Row row;
+            while (piece->Cursor->next(row)) {
+                std::unique_lock<std::mutex> lk(mutex_);
+                cv_.wait(lk, [this]() { return stop_ || rows_.size() < max_rows_; });
+                if (stop_) {
+                    break;
+                }
+                rows_.push_back(std::move(row));
+                lk.unlock();
+                cv_.notify_all();
+            }
+        } catch (sql::SQLException& e) {
+            fail(e);
+        } catch (std::exception& e) {
+            fail(sql::SQLException(std::string("parallel scan failed: ") + e.what()));
+        }
+        piece.reset();
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            finished_++;
+        }
+        cv_.notify_all();
+    }
+}
+
+bool ParallelScan::next(RowCursor::Row& row) {
+    if (merge_ == Merge::UNORDERED) {
+        std::unique_lock<std::mutex> lk(mutex_);
+        cv_.wait(lk, [this]() { return error_ || stop_ || !rows_.empty() || finished_ == queries_.size(); });
+        if (error_) {
+            throw *error_;
+        }
+        if (rows_.empty()) {
+            return false;
+        }
+        row = std::move(rows_.front());
+        rows_.pop_front();
+        lk.unlock();
+        cv_.notify_all();
+        return true;
+    }
+
+    while (true) {
+        Piece* piece;
+        {
+            std::unique_lock<std::mutex> lk(mutex_);
+            cv_.wait(lk, [this]() {
+                return error_ || stop_ || current_ >= queries_.size() || pieces_[current_] != nullptr;
+            });
+            if (error_) {
+                throw *error_;
+            }
+            if (stop_ || current_ >= queries_.size()) {
+                return false;
+            }
+            piece = pieces_[current_].get();
+        }
+
+        try {
+            if (piece->Cursor->next(row)) {
+                return true;
+            }
+        } catch (sql::SQLException& e) {
+            fail(e);
+            throw;
+        }
+
+        std::unique_ptr<Piece> done;
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            done = std::move(pieces_[current_]);
+            current_++;
+        }
+        cv_.notify_all();
+    }
+}
+
+} // namespace polardbx
+} // namespace sql
@@ -0,0 +1,123 @@
+#include "pipeline.h"
+#include "polardbx_connection.h"
+#include <algorithm>
+#include <cctype>
+#include <jdbc/cppconn/statement.h>
+
+namespace sql {
+namespace polardbx {
+
+namespace {
+
+void read_result(const std::shared_ptr<sql::Statement>& stmt, bool has_rows, PipelineResult& result) {
+    if (has_rows) {
+        result.Source = stmt;
+        result.Rows.reset(stmt->getResultSet());
+    } else {
+        result.UpdateCount = stmt->getUpdateCount();
+    }
+}
+
+// every quote and block comment opened in sql is closed again
+bool terminated(const std::string& sql) {
+    char quote = 0;
+    for (size_t i = 0; i < sql.size(); i++) {
+        char c = sql[i];
+        if (quote) {
+            if (c == '\\' && quote != '`') {
+                i++;
+            } else if (c == quote) {
+                quote = 0;
+            }
+        } else if (c == '\'' || c == '"' || c == '`') {
+            quote = c;
+        } else if (c == '/' && i + 1 < sql.size() && sql[i + 1] == '*') {
+            auto end = sql.find("*/", i + 2);
+            if (end == std::string::npos) {
+                return false;
+            }
+            i = end + 1;
+        }
+    }
+    return quote == 0;
+}
+
+void skip_rest(std::vector<PipelineResult>& results, size_t from) {
+    for (size_t i = from; i < results.size(); i++) {
+        results[i].Error = sql::SQLException("not executed, an earlier statement of the pipeline failed");
+    }
+}
+
+} // namespace
+
+Pipeline::Pipeline(PolarDBX_Connection* conn, bool multi_statements)
+    : conn_(conn), multi_statements_(multi_statements) {}
+
+void Pipeline::add(const sql::SQLString& sql) {
+    std::string text = sql;
+    while (!text.empty() && (text.back() == ';' || std::isspace(static_cast<unsigned char>(text.back())))) {
+        text.pop_back();
+    }
+    if (text.empty()) {
+        throw sql::InvalidArgumentException("empty statement");
+    }
+    if (multi_statements_ && (text.find(';') != std::string::npos || !terminated(text))) {
+        throw sql::InvalidArgumentException("pipelined statement must be a single statement without ';' "
+            "in literals or comments: " + text.substr(0, 64));
+    }
+    queued_.push_back(std::move(text));
+}
+
+std::vector<PipelineResult> Pipeline::execute() {
+    std::vector<PipelineResult> results(queued_.size());
+    auto queued = std::move(queued_);
+    queued_.clear();
+    if (queued.empty()) {
+        return results;
+    }
+
+    bool writes = !std::all_of(queued.begin(), queued.end(), ResultCache::is_read);
+    // shared with the results holding its result sets
+    std::shared_ptr<sql::Statement> stmt(conn_->createStatement());
+    if (!multi_statements_ || queued.size() == 1) {
+        for (size_t i = 0; i < queued.size(); i++) {
+            try {
+                read_result(stmt, stmt->execute(queued[i]), results[i]);
+            } catch (sql::SQLException& e) {
+                results[i].Error = e;
+                skip_rest(results, i + 1);
+                break;
+            }
+        }
+        if (writes) {
+            conn_->invalidateResultCache();
+        }
+        return results;
+    }
+
+    std::string packet;
+    for (const auto& sql : queued) {
+        if (!packet.empty()) {
+            packet += ";\n";
+        }
+        packet += sql;
+    }
+    // the server stops at the first failing statement and reports it in its place
+    for (size_t i = 0; i < queued.size(); i++) {
+        try {
+            bool has_rows = i == 0 ? stmt->execute(packet) : stmt->getMoreResults();
+            read_result(stmt, has_rows, results[i]);
+        } catch (sql::SQLException& e) {
+            results[i].Error = e;
+            skip_rest(results, i + 1);
+            break;
+        }
+    }
+    if (writes) {
+        conn_->invalidateResultCache();
+    }
+    return results;
+}
+
+} // namespace polardbx
+} // namespace sql
@@ -1,8 +1,14 @@
 #include "polardbx_connection.h"
 #include "polardbx_driver.h"
 #include "ha_manager.h"
+#include "option_registry.h"
+#include "tracked_statement.h"
 #include "const.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <optional>
+
 #include <jdbc/mysql_connection.h>
 #include <jdbc/mysql_driver.h>
 #include <jdbc/cppconn/exception.h>
@@ -10,12 +16,34 @@
 #include <jdbc/cppconn/prepared_statement.h>
 #include <jdbc/cppconn/metadata.h>
 #include <jdbc/cppconn/resultset.h>
+#include <jdbc/cppconn/resultset_metadata.h>
 #include <jdbc/cppconn/warning.h>
 #include <jdbc/cppconn/sqlstring.h>
 
 namespace sql {
 namespace polardbx {
 
+namespace {
+
+int64_t steady_nanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the connect timeout covers waiting for a node, for a handshake slot and the handshake itself
+int64_t connect_deadline(const std::shared_ptr<ConnectionConfig> & c_cfg) {
+    return steady_nanos() + static_cast<int64_t>(c_cfg->ConnectTimeoutMillis) * 1000000LL;
+}
+
+// ends a transaction: its writes become visible to everyone, or are undone while reads
+// in it may have cached them; either way, or when the outcome is unknown, the cluster's
+// cached results go
+struct InvalidateOnExit {
+    PolarDBX_Connection * conn;
+    ~InvalidateOnExit() { conn->invalidateResultCache(); }
+};
+
+} // namespace
+
 PolarDBX_Connection::PolarDBX_Connection(Driver * _driver,
         const sql::SQLString& hostName,
         const sql::SQLString& userName,
@@ -24,6 +52,7 @@ PolarDBX_Connection::PolarDBX_Connection(Driver * _driver,
 {
     auto p_cfg = std::make_shared<PolarDBXConfig>();
     auto c_cfg = std::make_shared<ConnectionConfig>();
+    auto deadline = connect_deadline(c_cfg);
 
     p_cfg->set_addr(hostName, 3306);
     std::map< sql::SQLString, sql::ConnectPropertyVal > options;
@@ -38,22 +67,42 @@ PolarDBX_Connection::PolarDBX_Connection(Driver * _driver,
     bool ok = false;
     if (ha_manager_->is_dn()) {
         auto [conn_addr, is_ok] = ha_manager_->get_available_dn_with_wait(c_cfg->ConnectTimeoutMillis, c_cfg->SlaveOnly, 
-        c_cfg->ApplyDelayThreshold, c_cfg->SlaveWeightThreshold, c_cfg->LoadBalanceAlgorithm);
+        c_cfg->ApplyDelayThreshold, c_cfg->SlaveWeightThreshold, c_cfg->LoadBalanceAlgorithm,
+        c_cfg->CompiledConnectClass);
         ok = is_ok;
         conn_addr_ = conn_addr;
     } else {
         auto [conn_addr, is_ok] = ha_manager_->get_available_cn_with_wait(c_cfg->ConnectTimeoutMillis, c_cfg->ZoneName, 
-        c_cfg->MinZoneNodes, c_cfg->BackupZoneName, c_cfg->SlaveOnly, c_cfg->InstanceName, c_cfg->MppRole, c_cfg->LoadBalanceAlgorithm);
+        c_cfg->MinZoneNodes, c_cfg->BackupZoneName, c_cfg->SlaveOnly, c_cfg->InstanceName, c_cfg->MppRole, c_cfg->LoadBalanceAlgorithm,
+        c_cfg->CompiledConnectClass);
         ok = is_ok;
         conn_addr_ = conn_addr;
     }
 
     if (!ok) {
         ha_manager_->drop_conn_count(conn_addr_);
+        ha_manager_->release();
         throw sql::SQLException("No available dn/cn");
     } else {
-        Driver * driver = sql::mysql::get_driver_instance();
-        real_conn = driver->connect(conn_addr_, userName, password);
+        try {
+            Driver * driver = sql::mysql::get_driver_instance();
+            auto permit = admit_connect(conn_addr_, deadline, c_cfg->CompiledConnectClass);
+            try {
+                real_conn = driver->connect(conn_addr_, userName, password);
+            } catch (sql::SQLException& e) {
+                ha_manager_->report_node_error(conn_addr_);
+                throw;
+            }
+            stmt_cache_.set_capacity(std::max(0, c_cfg->PrepStmtCacheSize));
+            stream_buffer_bytes_ = std::max(0, c_cfg->StreamBufferSize);
+            init_result_cache(c_cfg, options);
+            stmt_cache_.attach(real_conn);
+        } catch (...) {
+            // not admitted or the handshake failed, the selection's count goes back
+            ha_manager_->drop_conn_count(conn_addr_);
+            ha_manager_->release();
+            throw;
+        }
     }
 }
 
@@ -61,268 +110,41 @@ PolarDBX_Connection::PolarDBX_Connection(Driver * _driver,
         std::map< sql::SQLString, sql::ConnectPropertyVal > & options)
     : driver(_driver)
 {
-    if (options.find(OPT_DIRECT_MODE) != options.end()) {
-        try {
-            auto direct_mode = options[OPT_DIRECT_MODE].get<bool>();
-            if (direct_mode) {
-                real_conn = sql::mysql::get_driver_instance()->connect(options);
-                return;
-            }
-        } catch (sql::InvalidArgumentException&) {
-            throw sql::InvalidArgumentException("Wrong type passed for directMode expected bool");
-        }
-    }
-
-    auto p_cfg = std::make_shared<PolarDBXConfig>();
-    auto c_cfg = std::make_shared<ConnectionConfig>();
-
-    bool record_jdbc_url = false;
-    std::string jdbc_url = "";
+    connect(parse_connect_options(options), options);
+}
 
-    for (auto it = options.begin(); it != options.end(); it++) {
-        if (!it->first.compare(OPT_CLUSTERID)) {
-            try {
-                auto cluster_id = it->second.get<int>();
-                p_cfg->ClusterID = *cluster_id;
-                jdbc_url += OPT_CLUSTERID;
-                jdbc_url += "=";
-                jdbc_url += std::to_string(p_cfg->ClusterID);
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for clusterId expected int64_t");
-            }
-        } else if (!it->first.compare(OPT_HA_CHECK_CONNECT_TIMEOUT)) {
-            try {
-                auto val = it->second.get<int32_t>();
-                p_cfg->HaCheckConnectTimeoutMillis = *val;
-                jdbc_url += OPT_HA_CHECK_CONNECT_TIMEOUT;
-                jdbc_url += "=";
-                jdbc_url += std::to_string(p_cfg->HaCheckConnectTimeoutMillis);
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for haCheckConnectTimeout expected int32_t");
-            }
-        } else if (!it->first.compare(OPT_HA_CHECK_SOCKET_TIMEOUT)) {
-            try {
-                auto val = it->second.get<int32_t>();
-                p_cfg->HaCheckSocketTimeoutMillis = *val;
-                jdbc_url += OPT_HA_CHECK_SOCKET_TIMEOUT;
-                jdbc_url += "=";
-                jdbc_url += std::to_string(p_cfg->HaCheckSocketTimeoutMillis);
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for haCheckSocketTimeout expected int32_t");
-            }
-        } else if (!it->first.compare(OPT_HA_CHECK_INTERVAL)) {
-            try {
-                auto val = it->second.get<int32_t>();
-                p_cfg->HaCheckIntervalMillis = *val;
-                jdbc_url += OPT_HA_CHECK_INTERVAL;
-                jdbc_url += "=";
-                jdbc_url += std::to_string(p_cfg->HaCheckIntervalMillis);
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for haCheckInterval expected int32_t");
-            }
-        } else if (!it->first.compare(OPT_CHECK_LEADER_TRANSFERRING_INTERVAL)) {
-            try {
-                auto val = it->second.get<int32_t>();
-                p_cfg->CheckLeaderTransferringIntervalMillis = *val;
-                jdbc_url += OPT_CHECK_LEADER_TRANSFERRING_INTERVAL;
-                jdbc_url += "=";
-                jdbc_url += std::to_string(p_cfg->CheckLeaderTransferringIntervalMillis);
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for checkLeaderTransferringInterval expected int32_t");
-            }
-        } else if (!it->first.compare(OPT_LEADER_TRANSFERRING_WAIT_TIMEOUT)) {
-            try {
-                auto val = it->second.get<int32_t>();
-                p_cfg->LeaderTransferringWaitTimeoutMillis = *val;
-                jdbc_url += OPT_LEADER_TRANSFERRING_WAIT_TIMEOUT;
-                jdbc_url += "=";
-                jdbc_url += std::to_string(p_cfg->LeaderTransferringWaitTimeoutMillis);
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for leaderTransferringWaitTimeout expected int32_t");
-            }
-        } else if (!it->first.compare(OPT_SMOOTH_SWITCHOVER)) {
-            try {
-                auto val = it->second.get<bool>();
-                p_cfg->SmoothSwitchover = *val;
-                jdbc_url += OPT_SMOOTH_SWITCHOVER;
-                jdbc_url += "=";
-                jdbc_url += std::to_string(p_cfg->SmoothSwitchover);
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for smoothSwitchover expected bool");
-            }
-        } else if (!it->first.compare(OPT_RECORD_JDBC_URL)) {
-            try {
-                auto val = it->second.get<bool>();
-                record_jdbc_url = *val;
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for recordJdbcUrl expected bool");
-            }
-        } else if (!it->first.compare(OPT_IGNORE_VIP)) {
-            try {
-                auto val = it->second.get<bool>();
-                p_cfg->IgnoreVip.store(*val);
-                jdbc_url += OPT_IGNORE_VIP;
-                jdbc_url += "=";
-                jdbc_url += std::to_string(p_cfg->IgnoreVip.load());
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for ignoreVip expected bool");
-            }
-        } else if (!it->first.compare(OPT_JSON_FILE)) {
-            try {
-                auto val = it->second.get<std::string>();
-                p_cfg->JsonFile = *val;
-                jdbc_url += OPT_JSON_FILE;
-                jdbc_url += "=";
-                jdbc_url += p_cfg->JsonFile;
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for jsonFile expected std::string");
-            }
-        } else if (!it->first.compare(OPT_ENABLE_LOG)) {
-            try {
-                auto val = it->second.get<bool>();
-                p_cfg->EnableLog = *val;
-                jdbc_url += OPT_ENABLE_LOG;
-                jdbc_url += "=";
-                jdbc_url += std::to_string(p_cfg->EnableLog);
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for enableLog expected bool");
-            }
-        } else if (!it->first.compare(OPT_SLAVE_ONLY)) {
-            try {
-                auto val = it->second.get<bool>();
-                c_cfg->SlaveOnly = *val;
-                jdbc_url += OPT_SLAVE_ONLY;
-                jdbc_url += "=";
-                jdbc_url += std::to_string(c_cfg->SlaveOnly);
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for slaveOnly expected bool");
-            }
-        } else if (!it->first.compare(OPT_SLAVE_WEIGHT_THRESHOLD)) {
-            try {
-                auto val = it->second.get<int32_t>();
-                c_cfg->SlaveWeightThreshold = *val;
-                jdbc_url += OPT_SLAVE_WEIGHT_THRESHOLD;
-                jdbc_url += "=";
-                jdbc_url += std::to_string(c_cfg->SlaveWeightThreshold);
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for slaveWeightThreshold expected int32_t");
-            }
-        } else if (!it->first.compare(OPT_APPLY_DELAY_THRESHOLD)) {
-            try {
-                auto val = it->second.get<int32_t>();
-                c_cfg->ApplyDelayThreshold = *val;
-                jdbc_url += OPT_APPLY_DELAY_THRESHOLD;
-                jdbc_url += "=";
-                jdbc_url += std::to_string(c_cfg->ApplyDelayThreshold);
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for applyDelayThreshold expected int32_t");
-            }
-        } else if (!it->first.compare(OPT_LOAD_BALANCE_ALGORITHM)) {
-            try {
-                auto val = it->second.get<sql::SQLString>();
-                c_cfg->LoadBalanceAlgorithm = std::string(*val);
-                jdbc_url += OPT_LOAD_BALANCE_ALGORITHM;
-                jdbc_url += "=";
-                jdbc_url += c_cfg->LoadBalanceAlgorithm;
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for loadBalanceAlgorithm expected string (SQLString)");
-            }
-        } else if (!it->first.compare(OPT_ZONE_NAME)) {
-            try {
-                auto val = it->second.get<sql::SQLString>();
-                c_cfg->ZoneName = std::string(*val);
-                jdbc_url += OPT_ZONE_NAME;
-                jdbc_url += "=";
-                jdbc_url += c_cfg->ZoneName;
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for zoneName expected string (SQLString)");
-            }
-        } else if (!it->first.compare(OPT_MIN_ZONE_NODES)) {
-            try {
-                auto val = it->second.get<int32_t>();
-                c_cfg->MinZoneNodes = *val;
-                jdbc_url += OPT_MIN_ZONE_NODES;
-                jdbc_url += "=";
-                jdbc_url += std::to_string(c_cfg->MinZoneNodes);
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for minZoneNodes expected int32_t");
-            }
-        } else if (!it->first.compare(OPT_BACKUP_ZONE_NAME)) {
-            try {
-                auto val = it->second.get<sql::SQLString>();
-                c_cfg->BackupZoneName = std::string(*val);
-                jdbc_url += OPT_BACKUP_ZONE_NAME;
-                jdbc_url += "=";
-                jdbc_url += c_cfg->BackupZoneName;
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for backupZoneName expected string (SQLString)");
-            }
-        } else if (!it->first.compare(OPT_INSTANCE_NAME)) {
-            try {
-                auto val = it->second.get<sql::SQLString>();
-                c_cfg->InstanceName = std::string(*val);
-                jdbc_url += OPT_INSTANCE_NAME;
-                jdbc_url += "=";
-                jdbc_url += c_cfg->InstanceName;
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for instanceName expected string (SQLString)");
-            }
-        } else if (!it->first.compare(OPT_MPP_ROLE)) {
-            try {
-                auto val = it->second.get<sql::SQLString>();
-                c_cfg->MppRole = std::string(*val);
-                jdbc_url += OPT_MPP_ROLE;
-                jdbc_url += "=";
-                jdbc_url += c_cfg->MppRole;
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for mppRole expected string (SQLString)");
-            }
-        } else if (!it->first.compare(OPT_ENABLE_FOLLOWER_READ)) {
-            try {
-                auto val = it->second.get<int32_t>();
-                c_cfg->EnableFollowerRead = *val;
-                jdbc_url += OPT_ENABLE_FOLLOWER_READ;
-                jdbc_url += "=";
-                jdbc_url += std::to_string(c_cfg->EnableFollowerRead);
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for enableFollowerRead expected int32_t");
-            }
-        } else if (!it->first.compare(OPT_POLARDBX_CONNECT_TIMEOUT)) {
-            try {
-                auto connect_timeout = it->second.get<int32_t>();
-                c_cfg->ConnectTimeoutMillis = *connect_timeout;
-                jdbc_url += OPT_POLARDBX_CONNECT_TIMEOUT;
-                jdbc_url += "=";
-                jdbc_url += std::to_string(c_cfg->ConnectTimeoutMillis);
-            } catch (sql::InvalidArgumentException&) {
-                throw sql::InvalidArgumentException("Wrong type passed for connectTimeout expected int32_t");
-            }
-        }
-    }
+PolarDBX_Connection::PolarDBX_Connection(Driver * _driver,
+        std::shared_ptr<const ParsedOptions> parsed)
+    : driver(_driver)
+{
+    // the cached map is shared, connect on a private copy
+    sql::ConnectOptionsMap options = parsed->ConnectOptions;
+    connect(parsed, options);
+}
 
-    std::string host_name = "127.0.0.1";
-    int port = 3306;
-    if (options.find("hostName") != options.end()) {
-        try {
-            host_name = *(options["hostName"].get<sql::SQLString>());
-        } catch (sql::InvalidArgumentException&) {
-            throw sql::InvalidArgumentException("Wrong type passed for hostName expected sql::SQLString");
-        }
+void PolarDBX_Connection::connect(const std::shared_ptr<const ParsedOptions> & parsed,
+        sql::ConnectOptionsMap & caller_options)
+{
+    stmt_cache_.set_capacity(std::max(0, parsed->c_cfg->PrepStmtCacheSize));
+    stream_buffer_bytes_ = std::max(0, parsed->c_cfg->StreamBufferSize);
+    // only for connections that asked for it, with the flag an injected ';' runs extra statements;
+    // set on a copy, the caller may reuse its map for connects through the plain driver
+    std::optional<sql::ConnectOptionsMap> multi_options;
+    if (parsed->c_cfg->AllowMultiQueries) {
+        multi_options.emplace(caller_options);
+        (*multi_options)["CLIENT_MULTI_STATEMENTS"] = true;
+        multi_statements_ = true;
     }
-
-    if (options.find("port") != options.end()) {
-        try {
-            port = *(options["port"].get< int >());
-        } catch (sql::InvalidArgumentException&) {
-            throw sql::InvalidArgumentException("Wrong type passed for port expected int");
-        }
+    auto & options = multi_options ? *multi_options : caller_options;
+    if (parsed->DirectMode) {
+        real_conn = sql::mysql::get_driver_instance()->connect(options);
+        stmt_cache_.attach(real_conn);
+        return;
     }
-    p_cfg->set_addr(host_name, port);
-    p_cfg->set_conn_props(options);
 
-    jdbc_url += OPT_HOSTNAME;
-    jdbc_url += "=";
-    jdbc_url += p_cfg->Addr;
+    auto p_cfg = parsed->p_cfg;
+    auto c_cfg = parsed->c_cfg;
+    auto deadline = connect_deadline(c_cfg);
 
     ha_manager_ = HaManager::get_manager(p_cfg);
     if (!ha_manager_) {
@@ -332,29 +154,70 @@ PolarDBX_Connection::PolarDBX_Connection(Driver * _driver,
     bool ok = false;
     if (ha_manager_->is_dn()) {
         auto [conn_addr, is_ok] = ha_manager_->get_available_dn_with_wait(c_cfg->ConnectTimeoutMillis, c_cfg->SlaveOnly, 
-        c_cfg->ApplyDelayThreshold, c_cfg->SlaveWeightThreshold, c_cfg->LoadBalanceAlgorithm);
+        c_cfg->ApplyDelayThreshold, c_cfg->SlaveWeightThreshold, c_cfg->LoadBalanceAlgorithm,
+        c_cfg->CompiledConnectClass);
         ok = is_ok;
         conn_addr_ = conn_addr;
     } else {
-        auto [conn_addr, is_ok] = ha_manager_->get_available_cn_with_wait(c_cfg->ConnectTimeoutMillis, c_cfg->ZoneName, 
-        c_cfg->MinZoneNodes, c_cfg->BackupZoneName, c_cfg->SlaveOnly, c_cfg->InstanceName, c_cfg->MppRole, c_cfg->LoadBalanceAlgorithm);
+        auto [conn_addr, is_ok] = ha_manager_->get_available_cn_with_wait(c_cfg->ConnectTimeoutMillis, c_cfg->CompiledCnFilter,
+        c_cfg->LoadBalanceAlgorithm, c_cfg->CompiledConnectClass);
         ok = is_ok;
         conn_addr_ = conn_addr;
     }
 
     if (!ok) {
         ha_manager_->drop_conn_count(conn_addr_);
+        ha_manager_->release();
         throw sql::SQLException("No available dn/cn");
     } else {
-        options["hostName"] = conn_addr_;
-        Driver * driver = sql::mysql::get_driver_instance();
-        real_conn = driver->connect(options);
-
-        if (record_jdbc_url) {
-            recordJDBCURL(jdbc_url, real_conn);
+        // route to the selected node without leaving it in the caller's map,
+        // otherwise the next connect with the same map would start from that node
+        auto host_it = options.find(OPT_HOSTNAME);
+        std::optional<sql::ConnectPropertyVal> orig_host;
+        if (host_it != options.end()) {
+            orig_host = host_it->second;
         }
-        if (!ha_manager_->is_dn() && !c_cfg->SlaveOnly) {
-            enableFollowerRead(c_cfg->EnableFollowerRead, real_conn);
+        auto restore_host = [&]() {
+            if (orig_host) {
+                options[OPT_HOSTNAME] = *orig_host;
+            } else {
+                options.erase(OPT_HOSTNAME);
+            }
+        };
+
+        try {
+            options[OPT_HOSTNAME] = conn_addr_;
+            auto warm = ha_manager_->take_warm_connection(parsed, options, conn_addr_);
+            if (warm != nullptr) {
+                real_conn = warm.release();
+            } else {
+                Driver * driver = sql::mysql::get_driver_instance();
+                auto permit = admit_connect(conn_addr_, deadline, c_cfg->CompiledConnectClass);
+                try {
+                    real_conn = driver->connect(options);
+                } catch (sql::SQLException& e) {
+                    ha_manager_->report_node_error(conn_addr_);
+                    throw;
+                }
+            }
+            parsed_ = parsed;
+            options_ = options;
+            restore_host();
+            init_result_cache(c_cfg, options);
+            stmt_cache_.attach(real_conn);
+
+            if (parsed->RecordJdbcUrl) {
+                recordJDBCURL(parsed->JdbcUrl, real_conn);
+            }
+            if (!ha_manager_->is_dn() && !c_cfg->SlaveOnly) {
+                enableFollowerRead(c_cfg->EnableFollowerRead, real_conn);
+            }
+        } catch (...) {
+            restore_host();
+            // not admitted or the handshake failed, the selection's count goes back
+            ha_manager_->drop_conn_count(conn_addr_);
+            ha_manager_->release();
+            throw;
         }
     }
 }
@@ -395,42 +258,54 @@ void PolarDBX_Connection::enableFollowerRead(int followerReadState, sql::Connect
 
 PolarDBX_Connection::~PolarDBX_Connection()
 {
+    if (cursor_ != nullptr) cursor_->close();
+    stmt_cache_.attach(nullptr);
     delete real_conn;
+    if (ha_manager_ != nullptr) ha_manager_->release();
 }
 
 void PolarDBX_Connection::clearWarnings()
 {
+    check_not_streaming();
     real_conn->clearWarnings();
 }
 
 void PolarDBX_Connection::close()
 {
+    if (cursor_ != nullptr) cursor_->close();
+    stmt_cache_.release_statements();
     real_conn->close();
     if (ha_manager_ != nullptr) ha_manager_->drop_conn_count(conn_addr_);
 }
 
 void PolarDBX_Connection::commit()
 {
+    check_not_streaming();
+    InvalidateOnExit invalidate{this};
     real_conn->commit();
 }
 
 sql::Statement * PolarDBX_Connection::createStatement()
 {
-    return real_conn->createStatement();
+    check_not_streaming();
+    return tracked(real_conn->createStatement());
 }
 
 sql::SQLString PolarDBX_Connection::escapeString(const sql::SQLString & s)
 {
+    check_not_streaming();
     return dynamic_cast<sql::mysql::MySQL_Connection *>(real_conn)->escapeString(s);
 }
 
 bool PolarDBX_Connection::getAutoCommit()
 {
+    check_not_streaming();
     return real_conn->getAutoCommit();
 }
 
 sql::SQLString PolarDBX_Connection::getCatalog()
 {
+    check_not_streaming();
     return real_conn->getCatalog();
 }
 
@@ -441,36 +316,43 @@ Driver * PolarDBX_Connection::getDriver()
 
 sql::SQLString PolarDBX_Connection::getSchema()
 {
+    check_not_streaming();
     return real_conn->getSchema();
 }
 
 sql::SQLString PolarDBX_Connection::getClientInfo()
 {
+    check_not_streaming();
     return real_conn->getClientInfo();
 }
 
 void PolarDBX_Connection::getClientOption(const sql::SQLString & optionName, void * optionValue)
 {
+    check_not_streaming();
     real_conn->getClientOption(optionName, optionValue);
 }
 
 sql::SQLString PolarDBX_Connection::getClientOption(const sql::SQLString & optionName)
 {
+    check_not_streaming();
     return real_conn->getClientOption(optionName);
 }
 
 sql::DatabaseMetaData * PolarDBX_Connection::getMetaData()
 {
+    check_not_streaming();
     return real_conn->getMetaData();
 }
 
 enum_transaction_isolation PolarDBX_Connection::getTransactionIsolation()
 {
+    check_not_streaming();
     return real_conn->getTransactionIsolation();
 }
 
 const sql::SQLWarning * PolarDBX_Connection::getWarnings()
 {
+    check_not_streaming();
     return real_conn->getWarnings();
 }
 
@@ -481,136 +363,395 @@ bool PolarDBX_Connection::isClosed()
 
 bool PolarDBX_Connection::isReadOnly()
 {
+    check_not_streaming();
     return real_conn->isReadOnly();
 }
 
 bool PolarDBX_Connection::isValid()
 {
+    check_not_streaming();
     return real_conn->isValid();
 }
 
 bool PolarDBX_Connection::reconnect()
 {
+    // a re-route would cut the stream, the cursor has to be drained or closed first
+    check_not_streaming();
+    // server side statements do not survive the session, cached ones are prepared again on first use
+    stmt_cache_.release_statements();
+    if (reroute()) {
+        return true;
+    }
     return real_conn->reconnect();
 }
 
+// moves a leader connection to the current leader when it changed since the connect,
+// false when there is nothing to move and the caller should reconnect in place
+bool PolarDBX_Connection::reroute()
+{
+    if (parsed_ == nullptr || ha_manager_ == nullptr || !ha_manager_->is_dn() || parsed_->c_cfg->SlaveOnly) {
+        return false;
+    }
+    auto c_cfg = parsed_->c_cfg;
+    auto deadline = connect_deadline(c_cfg);
+    auto [leader, ok] = ha_manager_->get_available_dn_with_wait(c_cfg->ConnectTimeoutMillis, false,
+        c_cfg->ApplyDelayThreshold, c_cfg->SlaveWeightThreshold, c_cfg->LoadBalanceAlgorithm,
+        c_cfg->CompiledConnectClass);
+    if (!ok || leader == conn_addr_) {
+        return false;
+    }
+
+    // options_ stays as connected, with the caller's host list
+    auto options = options_;
+    options[OPT_HOSTNAME] = leader;
+    auto conn = ha_manager_->take_warm_connection(parsed_, options, leader);
+    if (conn == nullptr) {
+        try {
+            auto permit = admit_connect(leader, deadline, c_cfg->CompiledConnectClass);
+            try {
+                conn.reset(sql::mysql::get_driver_instance()->connect(options));
+            } catch (sql::SQLException& e) {
+                ha_manager_->report_node_error(leader);
+                throw;
+            }
+        } catch (...) {
+            // the connection stays on conn_addr_, the count taken for leader goes back
+            ha_manager_->drop_conn_count(leader);
+            throw;
+        }
+    }
+    if (parsed_->RecordJdbcUrl) {
+        recordJDBCURL(parsed_->JdbcUrl, conn.get());
+    }
+    if (!schema_.empty()) {
+        conn->setSchema(schema_);
+    }
+    if (autocommit_) {
+        conn->setAutoCommit(*autocommit_);
+    }
+    if (isolation_) {
+        conn->setTransactionIsolation(*isolation_);
+    }
+    if (read_only_) {
+        conn->setReadOnly(*read_only_);
+    }
+    for (const auto & [name, value] : session_vars_) {
+        dynamic_cast<sql::mysql::MySQL_Connection *>(conn.get())->setSessionVariable(name, value);
+    }
+
+    stmt_cache_.attach(conn.get());
+    delete real_conn;
+    real_conn = conn.release();
+    conn_addr_ = leader;
+    return true;
+}
+
+// a turn to handshake with addr, after a failover the waiting connects reach the new
+// leader in arrival order instead of all at once
+ConnectAdmission::Permit PolarDBX_Connection::admit_connect(const std::string & addr, int64_t deadline_nanos,
+        ConnectClass cls)
+{
+    auto permit = ha_manager_->admit_connect(deadline_nanos, cls);
+    if (!permit) {
+        throw sql::SQLException("connect to " + addr + " not admitted within the connect timeout");
+    }
+    return permit;
+}
+
 sql::SQLString PolarDBX_Connection::nativeSQL(const sql::SQLString& sql)
 {
+    check_not_streaming();
     return real_conn->nativeSQL(sql);
 }
 
 sql::PreparedStatement * PolarDBX_Connection::prepareStatement(const sql::SQLString& sql)
 {
-    return real_conn->prepareStatement(sql);
+    check_not_streaming();
+    return tracked(real_conn->prepareStatement(sql), sql);
 }
 
 sql::PreparedStatement * PolarDBX_Connection::prepareStatement(const sql::SQLString& sql, int autoGeneratedKeys)
 {
-    return real_conn->prepareStatement(sql, autoGeneratedKeys);
+    check_not_streaming();
+    return tracked(real_conn->prepareStatement(sql, autoGeneratedKeys), sql);
 }
 
 sql::PreparedStatement * PolarDBX_Connection::prepareStatement(const sql::SQLString& sql, int columnIndexes[])
 {
-    return real_conn->prepareStatement(sql, columnIndexes);
+    check_not_streaming();
+    return tracked(real_conn->prepareStatement(sql, columnIndexes), sql);
 }
 
 sql::PreparedStatement * PolarDBX_Connection::prepareStatement(const sql::SQLString& sql, int resultSetType, int resultSetConcurrency)
 {
-    return real_conn->prepareStatement(sql, resultSetType, resultSetConcurrency);
+    check_not_streaming();
+    return tracked(real_conn->prepareStatement(sql, resultSetType, resultSetConcurrency), sql);
 }
 
 sql::PreparedStatement * PolarDBX_Connection::prepareStatement(const sql::SQLString& sql, int resultSetType, int resultSetConcurrency, int resultSetHoldability)
 {
-    return real_conn->prepareStatement(sql, resultSetType, resultSetConcurrency, resultSetHoldability);
+    check_not_streaming();
+    return tracked(real_conn->prepareStatement(sql, resultSetType, resultSetConcurrency, resultSetHoldability), sql);
 }
 
 sql::PreparedStatement * PolarDBX_Connection::prepareStatement(const sql::SQLString& sql, sql::SQLString columnNames[])
 {
-    return real_conn->prepareStatement(sql, columnNames);
+    check_not_streaming();
+    return tracked(real_conn->prepareStatement(sql, columnNames), sql);
+}
+
+CachedStatement PolarDBX_Connection::prepareCachedStatement(const sql::SQLString& sql)
+{
+    check_not_streaming();
+    return stmt_cache_.get(sql);
+}
+
+std::unique_ptr<BatchStatement> PolarDBX_Connection::prepareBatch(const sql::SQLString& sql)
+{
+    return std::make_unique<BatchStatement>(this, sql);
+}
+
+std::unique_ptr<Pipeline> PolarDBX_Connection::pipeline()
+{
+    return std::make_unique<Pipeline>(this, multi_statements_);
+}
+
+std::unique_ptr<RowCursor> PolarDBX_Connection::executeStreaming(const sql::SQLString& sql)
+{
+    check_not_streaming();
+    std::unique_ptr<sql::Statement> stmt(real_conn->createStatement());
+    // forward only result sets are not buffered by the driver, rows are read as they are fetched
+    stmt->setResultSetType(sql::ResultSet::TYPE_FORWARD_ONLY);
+    std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(sql));
+    auto cursor = std::make_unique<RowCursor>(std::move(stmt), std::move(res), stream_buffer_bytes_,
+        [this]() { cursor_ = nullptr; });
+    cursor_ = cursor.get();
+    return cursor;
+}
+
+std::shared_ptr<const CachedResult> PolarDBX_Connection::executeCachedQuery(const sql::SQLString& sql)
+{
+    check_not_streaming();
+    ResultCache * cache = nullptr;
+    std::string key;
+    uint64_t epoch = 0;
+    uint64_t generation = 0;
+    if (!cache_cluster_.empty()) {
+        cache = &static_cast<PolarDBX_Driver *>(driver)->result_cache();
+        key = cache_cluster_ + '\x1f' + cache_session_ + '\x1f';
+        for (const auto & [name, value] : session_vars_) {
+            key += name + '=' + value + '\x1e';
+        }
+        key += '\x1f' + schema_ + '\x1f' + ResultCache::normalize(sql);
+        // both taken before the query runs, a change while it runs keeps its result out
+        epoch = ha_manager_->topology_epoch();
+        auto hit = cache->get(cache_cluster_, key, epoch);
+        if (hit != nullptr) {
+            return hit;
+        }
+        generation = cache->write_generation(cache_cluster_);
+    }
+
+    auto result = std::make_shared<CachedResult>();
+    std::unique_ptr<sql::Statement> stmt(real_conn->createStatement());
+    std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(sql));
+    auto meta = res->getMetaData();
+    auto columns = meta->getColumnCount();
+    for (unsigned int i = 1; i <= columns; i++) {
+        result->Columns.push_back(meta->getColumnLabel(i));
+    }
+    while (res->next()) {
+        RowCursor::Row row(columns);
+        size_t bytes = sizeof(RowCursor::Row);
+        for (unsigned int i = 0; i < columns; i++) {
+            std::string value = res->getString(i + 1);
+            if (!res->wasNull()) {
+                bytes += value.size();
+                row[i] = std::move(value);
+            }
+        }
+        result->Bytes += bytes;
+        result->Rows.push_back(std::move(row));
+    }
+
+    if (cache != nullptr) {
+        cache->put(cache_cluster_, key, epoch, generation, result_cache_ttl_, result_cache_bytes_, result);
+    }
+    return result;
+}
+
+void PolarDBX_Connection::invalidateResultCache()
+{
+    if (!cache_cluster_.empty()) {
+        static_cast<PolarDBX_Driver *>(driver)->result_cache().invalidate(cache_cluster_);
+    }
+}
+
+// statements go straight to the connector; with the cache on, their writes are watched
+sql::Statement * PolarDBX_Connection::tracked(sql::Statement * stmt)
+{
+    if (cache_cluster_.empty()) {
+        return stmt;
+    }
+    return track_writes(this, std::unique_ptr<sql::Statement>(stmt));
+}
+
+sql::PreparedStatement * PolarDBX_Connection::tracked(sql::PreparedStatement * stmt, const sql::SQLString & sql)
+{
+    if (cache_cluster_.empty()) {
+        return stmt;
+    }
+    return track_writes(this, std::unique_ptr<sql::PreparedStatement>(stmt), sql);
+}
+
+void PolarDBX_Connection::init_result_cache(const std::shared_ptr<ConnectionConfig> & c_cfg,
+        const sql::ConnectOptionsMap & options)
+{
+    // the cache lives in the driver, connections made through another driver go without
+    if (c_cfg->ResultCacheSize <= 0 || c_cfg->ResultCacheTtlMillis <= 0 ||
+        dynamic_cast<PolarDBX_Driver *>(driver) == nullptr) {
+        return;
+    }
+    cache_cluster_ = ha_manager_->cluster_tag();
+    result_cache_bytes_ = c_cfg->ResultCacheSize;
+    result_cache_ttl_ = c_cfg->ResultCacheTtlMillis;
+    auto schema = options.find(OPT_SCHEMA);
+    if (schema != options.end()) {
+        schema_ = *schema->second.get<sql::SQLString>();
+    }
+    // results differ by user (privileges, CURRENT_USER()) and by the charsets they come in
+    for (const char * name : {OPT_USERNAME, OPT_CHARSET_NAME, OPT_CHARACTERSET_RESULTS}) {
+        auto option = options.find(name);
+        if (option != options.end()) {
+            cache_session_ += *option->second.get<sql::SQLString>();
+        }
+        cache_session_ += '\x1f';
+    }
+}
+
+void PolarDBX_Connection::check_not_streaming()
+{
+    if (cursor_ != nullptr) {
+        throw sql::SQLException("connection is pinned by an open streaming cursor");
+    }
 }
 
 void PolarDBX_Connection::releaseSavepoint(sql::Savepoint * savepoint)
 {
+    check_not_streaming();
     real_conn->releaseSavepoint(savepoint);
 }
 
 void PolarDBX_Connection::rollback()
 {
+    check_not_streaming();
+    InvalidateOnExit invalidate{this};
     real_conn->rollback();
 }
 
 void PolarDBX_Connection::rollback(sql::Savepoint * savepoint)
 {
+    check_not_streaming();
+    InvalidateOnExit invalidate{this};
     real_conn->rollback(savepoint);
 }
 
 void PolarDBX_Connection::setAutoCommit(bool autoCommit)
 {
+    check_not_streaming();
     real_conn->setAutoCommit(autoCommit);
+    autocommit_ = autoCommit;
 }
 
 void PolarDBX_Connection::setCatalog(const sql::SQLString& catalog)
 {
+    check_not_streaming();
     real_conn->setCatalog(catalog);
 }
 
 void PolarDBX_Connection::setSchema(const sql::SQLString& schema)
 {
+    check_not_streaming();
     real_conn->setSchema(schema);
+    schema_ = schema;
 }
 
 sql::Connection * PolarDBX_Connection::setClientOption(const sql::SQLString & optionName, const void * optionValue)
 {
-    return real_conn->setClientOption(optionName, optionValue);
+    check_not_streaming();
+    auto conn = real_conn->setClientOption(optionName, optionValue);
+    if (std::string(optionName) == OPT_CHARACTERSET_RESULTS) {
+        // the connector sets it as a session variable, kept like one
+        session_vars_["character_set_results"] = optionValue ? static_cast<const char *>(optionValue) : "NULL";
+    }
+    return conn;
 }
 
 sql::Connection * PolarDBX_Connection::setClientOption(const sql::SQLString & optionName, const sql::SQLString & optionValue)
 {
-    return real_conn->setClientOption(optionName, optionValue);
+    check_not_streaming();
+    auto conn = real_conn->setClientOption(optionName, optionValue);
+    if (std::string(optionName) == OPT_CHARACTERSET_RESULTS) {
+        session_vars_["character_set_results"] = optionValue;
+    }
+    return conn;
 }
 
 void PolarDBX_Connection::setHoldability(int holdability)
 {
+    check_not_streaming();
     real_conn->setHoldability(holdability);
 }
 
 void PolarDBX_Connection::setReadOnly(bool readOnly)
 {
+    check_not_streaming();
     real_conn->setReadOnly(readOnly);
+    read_only_ = readOnly;
 }
 
 sql::Savepoint * PolarDBX_Connection::setSavepoint()
 {
+    check_not_streaming();
     return real_conn->setSavepoint();
 }
 
 sql::Savepoint * PolarDBX_Connection::setSavepoint(const sql::SQLString& name)
 {
+    check_not_streaming();
     return real_conn->setSavepoint(name);
 }
 
 void PolarDBX_Connection::setTransactionIsolation(enum_transaction_isolation level)
 {
+    check_not_streaming();
     real_conn->setTransactionIsolation(level);
+    isolation_ = level;
 }
 
 sql::SQLString PolarDBX_Connection::getSessionVariable(const sql::SQLString & varname)
 {
+    check_not_streaming();
     return dynamic_cast<sql::mysql::MySQL_Connection *>(real_conn)->getSessionVariable(varname);
 }
 
 void PolarDBX_Connection::setSessionVariable(const sql::SQLString & varname, const sql::SQLString & value)
 {
+    check_not_streaming();
     dynamic_cast<sql::mysql::MySQL_Connection *>(real_conn)->setSessionVariable(varname, value);
+    session_vars_[varname] = value;
 }
 
 void PolarDBX_Connection::setSessionVariable(const sql::SQLString & varname, unsigned int value)
 {
+    check_not_streaming();
     dynamic_cast<sql::mysql::MySQL_Connection *>(real_conn)->setSessionVariable(varname, value);
+    session_vars_[varname] = std::to_string(value);
 }
 
 sql::SQLString PolarDBX_Connection::getLastStatementInfo()
 {
+    check_not_streaming();
     return dynamic_cast<sql::mysql::MySQL_Connection *>(real_conn)->getLastStatementInfo();
 }
 
@@ -34,6 +34,7 @@
 
 #include "polardbx_driver.h"
 #include "polardbx_connection.h"
+#include "option_registry.h"
 
 #include <jdbc/cppconn/exception.h>
 #include "version_info.h"
@@ -110,6 +111,41 @@ Connection* PolarDBX_Driver::connect(ConnectOptionsMap& properties)
 }
 
 
+Connection* PolarDBX_Driver::connect(const SQLString& dsn)
+{
+    return new PolarDBX_Connection(this, get_parsed_dsn(dsn));
+}
+
+
+std::shared_ptr<const ParsedOptions> PolarDBX_Driver::get_parsed_dsn(const std::string& dsn)
+{
+    {
+        std::lock_guard<std::mutex> lk(dsn_cache_mutex_);
+        auto it = dsn_index_.find(dsn);
+        if (it != dsn_index_.end()) {
+            dsn_lru_.splice(dsn_lru_.begin(), dsn_lru_, it->second);
+            return it->second->second;
+        }
+    }
+
+    auto parsed = parse_dsn(dsn);
+
+    std::lock_guard<std::mutex> lk(dsn_cache_mutex_);
+    auto it = dsn_index_.find(dsn);
+    if (it != dsn_index_.end()) {
+        // parsed concurrently, keep the interned one
+        return it->second->second;
+    }
+    dsn_lru_.emplace_front(dsn, parsed);
+    dsn_index_[dsn] = dsn_lru_.begin();
+    if (dsn_lru_.size() > DSN_CACHE_CAPACITY) {
+        dsn_index_.erase(dsn_lru_.back().first);
+        dsn_lru_.pop_back();
+    }
+    return parsed;
+}
+
+
 int PolarDBX_Driver::getMajorVersion()
 {
     return POLARDBX_CPPCONN_MAJOR_VERSION;  // 在 version_info.h.cmake 中定义
@@ -0,0 +1,52 @@
+#include "probe_executor.h"
+
+namespace sql {
+namespace polardbx {
+
+ProbeExecutor::ProbeExecutor(size_t max_threads) : max_threads_(max_threads == 0 ? 1 : max_threads) {}
+
+ProbeExecutor::~ProbeExecutor() {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        stop_ = true;
+        tasks_.clear();
+    }
+    cv_.notify_all();
+    for (auto& t : threads_) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+}
+
+void ProbeExecutor::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        tasks_.push_back(std::move(task));
+        // threads are started on demand, a cluster with two seeds never needs more than two
+        if (idle_ < tasks_.size() && threads_.size() < max_threads_) {
+            threads_.emplace_back([this]() { run(); });
+        }
+    }
+    cv_.notify_one();
+}
+
+void ProbeExecutor::run() {
+    std::unique_lock<std::mutex> lk(mutex_);
+    while (true) {
+        idle_++;
+        cv_.wait(lk, [this]() { return stop_ || !tasks_.empty(); });
+        idle_--;
+        if (stop_) {
+            return;
+        }
+        auto task = std::move(tasks_.front());
+        tasks_.pop_front();
+        lk.unlock();
+        task();
+        lk.lock();
+    }
+}
+
+} // namespace polardbx
+} // namespace sql
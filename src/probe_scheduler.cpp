@@ -0,0 +1,64 @@
+#include "probe_scheduler.h"
+#include <algorithm>
+#include <chrono>
+
+namespace sql {
+namespace polardbx {
+
+namespace {
+
+int64_t steady_nanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+ProbeScheduler::ProbeScheduler(int32_t budget_per_second)
+    : budget_(std::max(1, budget_per_second)),
+      tokens_(budget_),
+      refill_nanos_(steady_nanos()),
+      rng_(std::random_device{}()) {}
+
+bool ProbeScheduler::tighten() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (tightened_) {
+        return false;
+    }
+    tightened_ = true;
+    auto now = steady_nanos();
+    return tokens_ + (now - refill_nanos_) * budget_ / 1e9 >= 1;
+}
+
+int32_t ProbeScheduler::next_interval(int32_t state, const ProbeCadence& cadence) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto floor = std::max(0, cadence.FloorMillis);
+    auto ceiling = std::max(floor, cadence.CeilingMillis);
+
+    if (state != last_state_ || tightened_) {
+        backoff_millis_ = floor;
+        tightened_ = false;
+    } else {
+        backoff_millis_ = std::min(ceiling, std::max(floor, backoff_millis_ * 2));
+    }
+    last_state_ = state;
+
+    // +-20% so managers that saw the same event do not probe in lockstep
+    int32_t interval = backoff_millis_;
+    if (interval > 0) {
+        std::uniform_int_distribution<int32_t> jitter(-interval / 5, interval / 5);
+        interval = std::max(1, interval + jitter(rng_));
+    }
+
+    auto now = steady_nanos();
+    tokens_ = std::min<double>(budget_, tokens_ + (now - refill_nanos_) * budget_ / 1e9);
+    refill_nanos_ = now;
+    tokens_ -= 1;
+    if (tokens_ < 0) {
+        // over budget, wait until the token this probe borrowed has been refilled
+        interval = std::max(interval, static_cast<int32_t>(-tokens_ * 1000 / budget_) + 1);
+    }
+    return interval;
+}
+
+} // namespace polardbx
+} // namespace sql
@@ -0,0 +1,139 @@
+#include "result_cache.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iterator>
+#include <strings.h>
+
+namespace sql {
+namespace polardbx {
+
+namespace {
+
+int64_t steady_nanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+bool ResultCache::is_read(const std::string& sql) {
+    auto begin = std::find_if(sql.begin(), sql.end(), [](char c) { return !std::isspace(static_cast<unsigned char>(c)); });
+    auto end = std::find_if(begin, sql.end(), [](char c) { return !std::isalpha(static_cast<unsigned char>(c)); });
+    std::string word(begin, end);
+    for (const char* read : {"SELECT", "SHOW", "DESC", "DESCRIBE", "EXPLAIN"}) {
+        if (strcasecmp(word.c_str(), read) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string ResultCache::normalize(const std::string& sql) {
+    std::string out;
+    out.reserve(sql.size());
+    bool space = false;
+    size_t i = 0;
+    size_t n = sql.size();
+    while (i < n) {
+        char c = sql[i];
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            space = true;
+            i++;
+            continue;
+        }
+        if (space && !out.empty()) {
+            out += ' ';
+        }
+        space = false;
+        if (c == '\'' || c == '"' || c == '`') {
+            // quoted text is kept as is
+            size_t begin = i++;
+            while (i < n) {
+                if (sql[i] == '\\' && c != '`') {
+                    i += 2;
+                } else if (sql[i++] == c) {
+                    if (i < n && sql[i] == c) {
+                        i++;
+                    } else {
+                        break;
+                    }
+                }
+            }
+            i = std::min(i, n);
+            out.append(sql, begin, i - begin);
+        } else {
+            out += c;
+            i++;
+        }
+    }
+    while (!out.empty() && (out.back() == ';' || out.back() == ' ')) {
+        out.pop_back();
+    }
+    return out;
+}
+
+uint64_t ResultCache::write_generation(const std::string& cluster) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto it = generations_.find(cluster);
+    return it == generations_.end() ? 0 : it->second;
+}
+
+std::shared_ptr<const CachedResult> ResultCache::get(const std::string& cluster, const std::string& key, uint64_t epoch) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return nullptr;
+    }
+    auto entry = it->second;
+    auto gen = generations_.find(cluster);
+    if (entry->Epoch != epoch || entry->Generation != (gen == generations_.end() ? 0 : gen->second) ||
+        steady_nanos() >= entry->ExpireNanos) {
+        erase(entry);
+        return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, entry);
+    return entry->Result;
+}
+
+void ResultCache::put(const std::string& cluster, const std::string& key, uint64_t epoch, uint64_t generation,
+    int64_t ttl_millis, size_t capacity_bytes, std::shared_ptr<const CachedResult> result) {
+    if (ttl_millis <= 0 || result->Bytes > capacity_bytes) {
+        return;
+    }
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto gen = generations_.find(cluster);
+    if (generation != (gen == generations_.end() ? 0 : gen->second)) {
+        // written while the query ran
+        return;
+    }
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        erase(it->second);
+    }
+    lru_.push_front({key, cluster, epoch, generation, steady_nanos() + ttl_millis * 1000000LL, std::move(result)});
+    index_[key] = lru_.begin();
+    bytes_ += lru_.front().Result->Bytes;
+    while (bytes_ > capacity_bytes) {
+        erase(std::prev(lru_.end()));
+    }
+}
+
+void ResultCache::invalidate(const std::string& cluster) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    // entries of the older generation are dropped lazily, by get() or by eviction
+    generations_[cluster]++;
+}
+
+size_t ResultCache::bytes() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return bytes_;
+}
+
+void ResultCache::erase(Lru::iterator it) {
+    bytes_ -= it->Result->Bytes;
+    index_.erase(it->Key);
+    lru_.erase(it);
+}
+
+} // namespace polardbx
+} // namespace sql
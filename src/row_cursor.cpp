@@ -0,0 +1,116 @@
+#include "row_cursor.h"
+#include <jdbc/mysql_driver.h>
+#include <jdbc/cppconn/resultset_metadata.h>
+
+namespace sql {
+namespace polardbx {
+
+RowCursor::RowCursor(std::unique_ptr<sql::Statement> stmt, std::unique_ptr<sql::ResultSet> res,
+    size_t buffer_bytes, std::function<void()> on_close)
+    : stmt_(std::move(stmt)), res_(std::move(res)), buffer_bytes_(buffer_bytes), on_close_(std::move(on_close)) {
+    auto meta = res_->getMetaData();
+    for (unsigned int i = 1; i <= meta->getColumnCount(); i++) {
+        columns_.push_back(meta->getColumnLabel(i));
+    }
+    reader_ = std::thread([this]() { read_ahead(); });
+}
+
+RowCursor::~RowCursor() {
+    close();
+}
+
+bool RowCursor::next(Row& row) {
+    std::unique_lock<std::mutex> lk(mutex_);
+    cv_.wait(lk, [this]() { return !buffer_.empty() || done_; });
+    if (buffer_.empty()) {
+        if (error_) {
+            auto error = *error_;
+            error_.reset();
+            lk.unlock();
+            release();
+            throw error;
+        }
+        lk.unlock();
+        // drained, the connection is free again
+        release();
+        return false;
+    }
+    buffered_ -= buffer_.front().first;
+    row = std::move(buffer_.front().second);
+    buffer_.pop_front();
+    lk.unlock();
+    cv_.notify_all();
+    return true;
+}
+
+void RowCursor::close() {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        stop_ = true;
+        buffer_.clear();
+        buffered_ = 0;
+    }
+    cv_.notify_all();
+    release();
+}
+
+void RowCursor::release() {
+    if (reader_.joinable()) {
+        reader_.join();
+    }
+    // the result set reads whatever is left of an unbuffered result before the connection can
+    // be used, this is where close() waits for the rest of a large result
+    res_.reset();
+    stmt_.reset();
+    if (on_close_) {
+        auto on_close = std::move(on_close_);
+        on_close_ = nullptr;
+        on_close();
+    }
+}
+
+void RowCursor::read_ahead() {
+    auto driver = sql::mysql::get_driver_instance();
+    driver->threadInit();
+    try {
+        auto columns = static_cast<unsigned int>(columns_.size());
+        while (res_->next()) {
+            Row row(columns);
+            size_t bytes = sizeof(Row);
+            for (unsigned int i = 0; i < columns; i++) {
+                std::string value = res_->getString(i + 1);
+                if (!res_->wasNull()) {
+                    bytes += value.size();
+                    row[i] = std::move(value);
+                }
+            }
+
+            std::unique_lock<std::mutex> lk(mutex_);
+            // an empty buffer always takes a row, so a row bigger than the bound still gets through
+            cv_.wait(lk, [this]() { return stop_ || buffer_.empty() || buffered_ < buffer_bytes_; });
+            if (stop_) {
+                break;
+            }
+            buffered_ += bytes;
+            buffer_.emplace_back(bytes, std::move(row));
+            lk.unlock();
+            cv_.notify_all();
+        }
+    } catch (sql::SQLException& e) {
+        std::lock_guard<std::mutex> lk(mutex_);
+        error_ = e;
+    } catch (std::exception& e) {
+        // anything else escaping the thread would terminate the process, next() rethrows it instead
+        std::lock_guard<std::mutex> lk(mutex_);
+        error_ = sql::SQLException(std::string("streaming read failed: ") + e.what());
+    }
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        done_ = true;
+    }
+    cv_.notify_all();
+    driver->threadEnd();
+}
+
+} // namespace polardbx
+} // namespace sql
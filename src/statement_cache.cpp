@@ -0,0 +1,134 @@
+#include "statement_cache.h"
+#include <algorithm>
+#include <jdbc/cppconn/exception.h>
+
+namespace sql {
+namespace polardbx {
+
+sql::PreparedStatement* CachedStatement::get() const {
+    if (entry_ == nullptr) {
+        throw sql::InvalidArgumentException("empty cached statement");
+    }
+    return cache_->prepare(*entry_);
+}
+
+CachedStatement::~CachedStatement() {
+    if (entry_ != nullptr) {
+        entry_->CheckedOut = false;
+    }
+}
+
+CachedStatement::CachedStatement(CachedStatement&& other) noexcept
+    : cache_(other.cache_), entry_(std::move(other.entry_)) {
+    other.entry_ = nullptr;
+}
+
+CachedStatement& CachedStatement::operator=(CachedStatement&& other) noexcept {
+    if (this != &other) {
+        if (entry_ != nullptr) {
+            entry_->CheckedOut = false;
+        }
+        cache_ = other.cache_;
+        entry_ = std::move(other.entry_);
+        other.entry_ = nullptr;
+    }
+    return *this;
+}
+
+StatementCache::~StatementCache() {
+    release_statements();
+}
+
+void StatementCache::set_capacity(size_t capacity) {
+    capacity_ = capacity;
+    evict();
+}
+
+void StatementCache::attach(sql::Connection* conn) {
+    if (conn != conn_) {
+        release_statements();
+        conn_ = conn;
+    }
+}
+
+CachedStatement StatementCache::get(const sql::SQLString& sql) {
+    std::string key = sql;
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        auto& entry = lru_.front();
+        if (!entry->CheckedOut) {
+            if (entry->Stmt != nullptr) {
+                entry->Stmt->clearParameters();
+            }
+            entry->CheckedOut = true;
+            return CachedStatement(this, entry);
+        }
+        // the same sql is in use, e.g. one statement per nesting level of a loop
+        auto copy = std::make_shared<Entry>();
+        copy->Sql = std::move(key);
+        prepare(*copy);
+        return uncached(std::move(copy));
+    }
+
+    auto entry = std::make_shared<Entry>();
+    entry->Sql = std::move(key);
+    // prepare before caching, a statement the server rejects is not kept
+    prepare(*entry);
+    if (capacity_ == 0) {
+        return uncached(std::move(entry));
+    }
+    lru_.push_front(entry);
+    index_[entry->Sql] = lru_.begin();
+    entry->CheckedOut = true;
+    evict();
+    return CachedStatement(this, entry);
+}
+
+// handed out without caching, closed with its handle
+CachedStatement StatementCache::uncached(std::shared_ptr<Entry> entry) {
+    evict();
+    detached_.push_back(entry);
+    entry->CheckedOut = true;
+    return CachedStatement(this, std::move(entry));
+}
+
+void StatementCache::release_statements() {
+    for (auto& entry : lru_) {
+        entry->Stmt.reset();
+    }
+    for (auto& weak : detached_) {
+        if (auto entry = weak.lock()) {
+            entry->Stmt.reset();
+        }
+    }
+    detached_.clear();
+}
+
+sql::PreparedStatement* StatementCache::prepare(Entry& entry) {
+    if (entry.Stmt == nullptr) {
+        if (conn_ == nullptr) {
+            throw sql::SQLException("connection is gone, cannot prepare statement");
+        }
+        entry.Stmt.reset(conn_->prepareStatement(entry.Sql));
+    }
+    return entry.Stmt.get();
+}
+
+void StatementCache::evict() {
+    detached_.erase(std::remove_if(detached_.begin(), detached_.end(),
+        [](const std::weak_ptr<Entry>& weak) { return weak.expired(); }), detached_.end());
+
+    while (lru_.size() > capacity_) {
+        auto& victim = lru_.back();
+        index_.erase(victim->Sql);
+        if (victim.use_count() > 1) {
+            // a handle still uses it, it is closed when the handle goes or the connection does
+            detached_.push_back(victim);
+        }
+        lru_.pop_back();
+    }
+}
+
+} // namespace polardbx
+} // namespace sql
@@ -0,0 +1,153 @@
+#include "tracked_statement.h"
+#include "polardbx_connection.h"
+#include "result_cache.h"
+
+namespace sql {
+namespace polardbx {
+
+namespace {
+
+template <class Base>
+class Tracked : public Base {
+public:
+    Tracked(PolarDBX_Connection* conn, std::unique_ptr<Base> stmt) : conn_(conn), stmt_(std::move(stmt)) {}
+
+    sql::Connection* getConnection() override { return conn_; }
+    void cancel() override { stmt_->cancel(); }
+    void clearWarnings() override { stmt_->clearWarnings(); }
+    void close() override { stmt_->close(); }
+
+    bool execute(const sql::SQLString& sql) override {
+        return run(!ResultCache::is_read(sql), [&] { return stmt_->execute(sql); });
+    }
+
+    sql::ResultSet* executeQuery(const sql::SQLString& sql) override { return stmt_->executeQuery(sql); }
+
+    int executeUpdate(const sql::SQLString& sql) override {
+        return run(!ResultCache::is_read(sql), [&] { return stmt_->executeUpdate(sql); });
+    }
+
+    size_t getFetchSize() override { return stmt_->getFetchSize(); }
+    unsigned int getMaxFieldSize() override { return stmt_->getMaxFieldSize(); }
+    uint64_t getMaxRows() override { return stmt_->getMaxRows(); }
+    bool getMoreResults() override { return stmt_->getMoreResults(); }
+    unsigned int getQueryTimeout() override { return stmt_->getQueryTimeout(); }
+    sql::ResultSet* getResultSet() override { return stmt_->getResultSet(); }
+    sql::ResultSet::enum_type getResultSetType() override { return stmt_->getResultSetType(); }
+    uint64_t getUpdateCount() override { return stmt_->getUpdateCount(); }
+    const sql::SQLWarning* getWarnings() override { return stmt_->getWarnings(); }
+    void setCursorName(const sql::SQLString& name) override { stmt_->setCursorName(name); }
+    void setEscapeProcessing(bool enable) override { stmt_->setEscapeProcessing(enable); }
+    void setFetchSize(size_t rows) override { stmt_->setFetchSize(rows); }
+    void setMaxFieldSize(unsigned int max) override { stmt_->setMaxFieldSize(max); }
+    void setMaxRows(unsigned int max) override { stmt_->setMaxRows(max); }
+    void setQueryTimeout(unsigned int seconds) override { stmt_->setQueryTimeout(seconds); }
+
+    Base* setResultSetType(sql::ResultSet::enum_type type) override {
+        stmt_->setResultSetType(type);
+        return this;
+    }
+
+    int setQueryAttrBigInt(const sql::SQLString& name, const sql::SQLString& value) override {
+        return stmt_->setQueryAttrBigInt(name, value);
+    }
+    int setQueryAttrBoolean(const sql::SQLString& name, bool value) override {
+        return stmt_->setQueryAttrBoolean(name, value);
+    }
+    int setQueryAttrDateTime(const sql::SQLString& name, const sql::SQLString& value) override {
+        return stmt_->setQueryAttrDateTime(name, value);
+    }
+    int setQueryAttrDouble(const sql::SQLString& name, double value) override {
+        return stmt_->setQueryAttrDouble(name, value);
+    }
+    int setQueryAttrInt(const sql::SQLString& name, int32_t value) override {
+        return stmt_->setQueryAttrInt(name, value);
+    }
+    int setQueryAttrUInt(const sql::SQLString& name, uint32_t value) override {
+        return stmt_->setQueryAttrUInt(name, value);
+    }
+    int setQueryAttrInt64(const sql::SQLString& name, int64_t value) override {
+        return stmt_->setQueryAttrInt64(name, value);
+    }
+    int setQueryAttrUInt64(const sql::SQLString& name, uint64_t value) override {
+        return stmt_->setQueryAttrUInt64(name, value);
+    }
+    int setQueryAttrNull(const sql::SQLString& name) override { return stmt_->setQueryAttrNull(name); }
+    int setQueryAttrString(const sql::SQLString& name, const sql::SQLString& value) override {
+        return stmt_->setQueryAttrString(name, value);
+    }
+    void clearAttributes() override { stmt_->clearAttributes(); }
+
+protected:
+    template <class F>
+    auto run(bool writes, F statement) -> decltype(statement()) {
+        if (!writes) {
+            return statement();
+        }
+        try {
+            auto result = statement();
+            conn_->invalidateResultCache();
+            return result;
+        } catch (...) {
+            conn_->invalidateResultCache();
+            throw;
+        }
+    }
+
+    PolarDBX_Connection* conn_;
+    std::unique_ptr<Base> stmt_;
+};
+
+class TrackedPrepared : public Tracked<sql::PreparedStatement> {
+public:
+    TrackedPrepared(PolarDBX_Connection* conn, std::unique_ptr<sql::PreparedStatement> stmt, bool writes)
+        : Tracked(conn, std::move(stmt)), writes_(writes) {}
+
+    using Tracked::execute;
+    using Tracked::executeQuery;
+    using Tracked::executeUpdate;
+
+    bool execute() override { return run(writes_, [&] { return stmt_->execute(); }); }
+    sql::ResultSet* executeQuery() override { return stmt_->executeQuery(); }
+    int executeUpdate() override { return run(writes_, [&] { return stmt_->executeUpdate(); }); }
+
+    void clearParameters() override { stmt_->clearParameters(); }
+    sql::ResultSetMetaData* getMetaData() override { return stmt_->getMetaData(); }
+    sql::ParameterMetaData* getParameterMetaData() override { return stmt_->getParameterMetaData(); }
+
+    void setBigInt(unsigned int parameterIndex, const sql::SQLString& value) override {
+        stmt_->setBigInt(parameterIndex, value);
+    }
+    void setBlob(unsigned int parameterIndex, std::istream* blob) override { stmt_->setBlob(parameterIndex, blob); }
+    void setBoolean(unsigned int parameterIndex, bool value) override { stmt_->setBoolean(parameterIndex, value); }
+    void setDateTime(unsigned int parameterIndex, const sql::SQLString& value) override {
+        stmt_->setDateTime(parameterIndex, value);
+    }
+    void setDouble(unsigned int parameterIndex, double value) override { stmt_->setDouble(parameterIndex, value); }
+    void setInt(unsigned int parameterIndex, int32_t value) override { stmt_->setInt(parameterIndex, value); }
+    void setUInt(unsigned int parameterIndex, uint32_t value) override { stmt_->setUInt(parameterIndex, value); }
+    void setInt64(unsigned int parameterIndex, int64_t value) override { stmt_->setInt64(parameterIndex, value); }
+    void setUInt64(unsigned int parameterIndex, uint64_t value) override { stmt_->setUInt64(parameterIndex, value); }
+    void setNull(unsigned int parameterIndex, int sqlType) override { stmt_->setNull(parameterIndex, sqlType); }
+    void setString(unsigned int parameterIndex, const sql::SQLString& value) override {
+        stmt_->setString(parameterIndex, value);
+    }
+
+private:
+    // known when prepared, the statement text cannot change afterwards
+    bool writes_;
+};
+
+} // namespace
+
+sql::Statement* track_writes(PolarDBX_Connection* conn, std::unique_ptr<sql::Statement> stmt) {
+    return new Tracked<sql::Statement>(conn, std::move(stmt));
+}
+
+sql::PreparedStatement* track_writes(PolarDBX_Connection* conn, std::unique_ptr<sql::PreparedStatement> stmt,
+    const std::string& sql) {
+    return new TrackedPrepared(conn, std::move(stmt), !ResultCache::is_read(sql));
+}
+
+} // namespace polardbx
+} // namespace sql
@@ -0,0 +1,88 @@
+#include "waiter_registry.h"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+namespace sql {
+namespace polardbx {
+
+uint64_t WaiterRegistry::prepare(const std::string& key) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return entry_locked(key).Seq;
+}
+
+std::string WaiterRegistry::wait(const std::string& key, uint64_t ticket, int64_t deadline_nanos, Select select,
+    ConnectClass cls) {
+    std::unique_lock<std::mutex> lk(mutex_);
+    auto& entry = entry_locked(key);
+    if (entry.Seq != ticket) {
+        // notified since the ticket was taken, select again
+        return "";
+    }
+    if (entry.Waiters.empty()) {
+        entry.Selector = std::move(select);
+    }
+
+    Waiter self;
+    self.cls = cls;
+    auto position = entry.Waiters.insert(std::find_if(entry.Waiters.begin(), entry.Waiters.end(),
+        [cls](const Waiter* w) { return w->cls > cls; }), &self);
+    auto deadline = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(deadline_nanos));
+    while (!self.woken) {
+        if (self.cv.wait_until(lk, deadline) == std::cv_status::timeout && !self.woken) {
+            entry.Waiters.erase(position);
+            break;
+        }
+    }
+    return self.node;
+}
+
+void WaiterRegistry::notify(const std::string& prefix) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto seq = ++seq_;
+    for (auto it = entries_.lower_bound(prefix);
+         it != entries_.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+        auto& entry = it->second;
+        entry.Seq = seq;
+        while (!entry.Waiters.empty()) {
+            auto waiter = entry.Waiters.front();
+            if (entry.Selector) {
+                waiter->node = entry.Selector();
+                if (waiter->node.empty()) {
+                    // nothing for this key yet, the rest stays parked as well
+                    break;
+                }
+            }
+            entry.Waiters.pop_front();
+            waiter->woken = true;
+            waiter->cv.notify_one();
+        }
+    }
+}
+
+size_t WaiterRegistry::waiting() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    size_t n = 0;
+    for (const auto& entry : entries_) {
+        n += entry.second.Waiters.size();
+    }
+    return n;
+}
+
+WaiterRegistry::Entry& WaiterRegistry::entry_locked(const std::string& key) {
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+        return it->second;
+    }
+    if (entries_.size() >= 256) {
+        // keys no longer waited on are dropped; a ticket of a dropped key is older than
+        // seq_ after any notify, so its waiter selects again instead of missing one
+        for (auto idle = entries_.begin(); idle != entries_.end();) {
+            idle = idle->second.Waiters.empty() ? entries_.erase(idle) : std::next(idle);
+        }
+    }
+    return entries_.emplace(key, Entry{seq_, nullptr, {}}).first->second;
+}
+
+} // namespace polardbx
+} // namespace sql
@@ -0,0 +1,252 @@
+#include "warm_pool.h"
+#include "const.hpp"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <jdbc/mysql_driver.h>
+#include <jdbc/cppconn/exception.h>
+
+namespace sql {
+namespace polardbx {
+
+namespace {
+
+int64_t steady_nanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+WarmPool::WarmPool(Routable routable, ConnectAdmission& admission, std::shared_ptr<Logger> logger)
+    : routable_(std::move(routable)), admission_(admission), logger_(std::move(logger)) {}
+
+WarmPool::~WarmPool() {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (maintainer_ && maintainer_->joinable()) {
+        maintainer_->join();
+    }
+}
+
+void WarmPool::start_maintainer() {
+    if (maintainer_ == nullptr) {
+        maintainer_ = std::make_unique<std::thread>([this]() { maintain(); });
+    }
+}
+
+std::unique_ptr<sql::Connection> WarmPool::take(const std::shared_ptr<const ParsedOptions>& parsed,
+    const sql::ConnectOptionsMap& options, const std::string& addr, bool leader) {
+    if (parsed->c_cfg->WarmConnections <= 0 || parsed->CacheKey.empty()) {
+        return nullptr;
+    }
+
+    // closed outside the lock, closing sends COM_QUIT
+    std::vector<std::unique_ptr<sql::Connection>> closing;
+    std::shared_ptr<Pool> target;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        auto& pool = pools_[Key(parsed->CacheKey, leader ? "" : addr)];
+        if (pool == nullptr) {
+            pool = std::make_shared<Pool>();
+            pool->Parsed = parsed;
+            pool->Options = options;
+            pool->Addr = addr;
+            pool->Leader = leader;
+            start_maintainer();
+            logger_->info(std::string("warm pool for ") + (leader ? "leader " : "") + addr + " created");
+        }
+        if (pool->Addr != addr) {
+            // the caller was routed to a leader the pool has not followed yet
+            for (auto& idle : pool->Idle) {
+                closing.push_back(std::move(idle.second));
+            }
+            pool->Idle.clear();
+            pool->Addr = addr;
+            pool->Generation++;
+            pool->RetryAfterNanos = 0;
+        }
+        pool->LastTakenNanos = steady_nanos();
+        target = pool;
+    }
+    cv_.notify_all();
+
+    // the server or the network may have dropped a connection since it was opened,
+    // validated outside the lock since a ping takes a round trip
+    auto validate_after = static_cast<int64_t>(WARM_CONNECTION_VALIDATE_MILLIS) * 1000000LL;
+    auto max_age = static_cast<int64_t>(WARM_CONNECTION_MAX_AGE_MILLIS) * 1000000LL;
+    while (true) {
+        std::pair<int64_t, std::unique_ptr<sql::Connection>> idle;
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            if (target->Idle.empty() || target->Addr != addr) {
+                return nullptr;
+            }
+            idle = std::move(target->Idle.front());
+            target->Idle.pop_front();
+        }
+        auto age = steady_nanos() - idle.first;
+        if (age <= max_age && !idle.second->isClosed() && (age <= validate_after || idle.second->isValid())) {
+            return std::move(idle.second);
+        }
+        closing.push_back(std::move(idle.second));
+        // taking one triggers a refill, a dead one is replaced as well
+        cv_.notify_all();
+    }
+}
+
+void WarmPool::retarget_leader(const std::string& leader) {
+    std::vector<std::unique_ptr<sql::Connection>> closing;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        for (auto& [key, pool] : pools_) {
+            if (!pool->Leader || pool->Addr == leader) {
+                continue;
+            }
+            for (auto& idle : pool->Idle) {
+                closing.push_back(std::move(idle.second));
+            }
+            pool->Idle.clear();
+            pool->Addr = leader;
+            pool->Generation++;
+            pool->RetryAfterNanos = 0;
+        }
+    }
+    cv_.notify_all();
+}
+
+void WarmPool::clear() {
+    std::vector<std::unique_ptr<sql::Connection>> closing;
+    std::lock_guard<std::mutex> lk(mutex_);
+    for (auto& [key, pool] : pools_) {
+        for (auto& idle : pool->Idle) {
+            closing.push_back(std::move(idle.second));
+        }
+        pool->Idle.clear();
+        pool->Generation++;
+    }
+    pools_.clear();
+    // closing goes out of scope after the lock is released
+}
+
+void WarmPool::maintain() {
+    struct Open {
+        std::shared_ptr<Pool> Target;
+        uint64_t Generation;
+        std::string Addr;
+    };
+
+    std::unique_lock<std::mutex> lk(mutex_);
+    while (!stop_) {
+        cv_.wait_for(lk, std::chrono::milliseconds(1000));
+        if (stop_) {
+            break;
+        }
+
+        auto now = steady_nanos();
+        std::vector<std::unique_ptr<sql::Connection>> closing;
+        std::vector<std::shared_ptr<Pool>> live;
+        for (auto it = pools_.begin(); it != pools_.end();) {
+            auto& pool = it->second;
+            while (!pool->Idle.empty() &&
+                   now - pool->Idle.front().first > static_cast<int64_t>(WARM_CONNECTION_MAX_AGE_MILLIS) * 1000000LL) {
+                closing.push_back(std::move(pool->Idle.front().second));
+                pool->Idle.pop_front();
+            }
+            if (now - pool->LastTakenNanos > static_cast<int64_t>(pool->Parsed->p_cfg->HaIdleTimeoutMillis) * 1000000LL) {
+                logger_->info("warm pool for " + pool->Addr + " unused, dropped");
+                for (auto& idle : pool->Idle) {
+                    closing.push_back(std::move(idle.second));
+                }
+                pool->Idle.clear();
+                pool->Generation++;
+                it = pools_.erase(it);
+                continue;
+            }
+            live.push_back(pool);
+            ++it;
+        }
+
+        // routable_ takes the manager's locks, never call it under ours
+        std::vector<std::pair<std::string, bool>> targets;
+        for (const auto& pool : live) {
+            targets.emplace_back(pool->Addr, pool->Leader);
+        }
+        lk.unlock();
+        closing.clear();
+        std::vector<bool> routable;
+        for (const auto& [addr, leader] : targets) {
+            routable.push_back(routable_(addr, leader));
+        }
+        lk.lock();
+
+        std::vector<Open> to_open;
+        for (size_t i = 0; i < live.size(); i++) {
+            auto& pool = live[i];
+            if (pool->Addr != targets[i].first) {
+                // retargeted meanwhile, handled on the next round
+                continue;
+            }
+            if (!routable[i]) {
+                for (auto& idle : pool->Idle) {
+                    closing.push_back(std::move(idle.second));
+                }
+                pool->Idle.clear();
+                continue;
+            }
+            if (now < pool->RetryAfterNanos) {
+                continue;
+            }
+            auto target = static_cast<size_t>(pool->Parsed->c_cfg->WarmConnections);
+            while (pool->Idle.size() + pool->Opening < target) {
+                pool->Opening++;
+                to_open.push_back({pool, pool->Generation, pool->Addr});
+            }
+        }
+
+        for (auto& open : to_open) {
+            auto& pool = open.Target;
+            if (stop_ || now < pool->RetryAfterNanos) {
+                pool->Opening--;
+                continue;
+            }
+            auto options = pool->Options;
+            options[OPT_HOSTNAME] = open.Addr;
+            auto deadline = steady_nanos() + static_cast<int64_t>(pool->Parsed->c_cfg->ConnectTimeoutMillis) * 1000000LL;
+            lk.unlock();
+
+            std::unique_ptr<sql::Connection> conn;
+            // background work, shed first when clients queue for handshakes
+            auto permit = admission_.acquire(deadline, ConnectClass::BATCH);
+            if (permit) {
+                try {
+                    conn.reset(sql::mysql::get_driver_instance()->connect(options));
+                } catch (sql::SQLException& e) {
+                    logger_->error("warm connection to " + open.Addr + " failed: " + e.what());
+                }
+                permit.reset();
+            } else {
+                logger_->info("warm connection to " + open.Addr + " not admitted, retry later");
+            }
+
+            lk.lock();
+            pool->Opening--;
+            if (conn == nullptr) {
+                pool->RetryAfterNanos = steady_nanos() + static_cast<int64_t>(WARM_POOL_RETRY_MILLIS) * 1000000LL;
+            } else if (pool->Generation == open.Generation && !stop_) {
+                pool->Idle.emplace_back(steady_nanos(), std::move(conn));
+            } else {
+                closing.push_back(std::move(conn));
+            }
+        }
+
+        lk.unlock();
+        closing.clear();
+        lk.lock();
+    }
+}
+
+} // namespace polardbx
+} // namespace sql
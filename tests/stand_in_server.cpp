@@ -0,0 +1,972 @@
+#include "stand_in_server.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "const.hpp"
+#include "utils.hpp"
+
+namespace sql {
+namespace polardbx {
+namespace stand_in {
+
+namespace {
+
+constexpr uint32_t CLIENT_LONG_PASSWORD = 0x00000001;
+constexpr uint32_t CLIENT_FOUND_ROWS = 0x00000002;
+constexpr uint32_t CLIENT_LONG_FLAG = 0x00000004;
+constexpr uint32_t CLIENT_CONNECT_WITH_DB = 0x00000008;
+constexpr uint32_t CLIENT_IGNORE_SPACE = 0x00000100;
+constexpr uint32_t CLIENT_PROTOCOL_41 = 0x00000200;
+constexpr uint32_t CLIENT_INTERACTIVE = 0x00000400;
+constexpr uint32_t CLIENT_TRANSACTIONS = 0x00002000;
+constexpr uint32_t CLIENT_SECURE_CONNECTION = 0x00008000;
+constexpr uint32_t CLIENT_MULTI_STATEMENTS = 0x00010000;
+constexpr uint32_t CLIENT_MULTI_RESULTS = 0x00020000;
+constexpr uint32_t CLIENT_PS_MULTI_RESULTS = 0x00040000;
+constexpr uint32_t CLIENT_PLUGIN_AUTH = 0x00080000;
+constexpr uint32_t CLIENT_CONNECT_ATTRS = 0x00100000;
+constexpr uint32_t CLIENT_PLUGIN_AUTH_LENENC_CLIENT_DATA = 0x00200000;
+
+// no SSL, no DEPRECATE_EOF and no QUERY_ATTRIBUTES: classic EOF framing, plain COM_QUERY
+constexpr uint32_t SERVER_CAPABILITIES = CLIENT_LONG_PASSWORD | CLIENT_FOUND_ROWS | CLIENT_LONG_FLAG |
+    CLIENT_CONNECT_WITH_DB | CLIENT_IGNORE_SPACE | CLIENT_PROTOCOL_41 | CLIENT_INTERACTIVE |
+    CLIENT_TRANSACTIONS | CLIENT_SECURE_CONNECTION | CLIENT_MULTI_STATEMENTS | CLIENT_MULTI_RESULTS |
+    CLIENT_PS_MULTI_RESULTS | CLIENT_PLUGIN_AUTH | CLIENT_CONNECT_ATTRS | CLIENT_PLUGIN_AUTH_LENENC_CLIENT_DATA;
+
+constexpr uint16_t SERVER_STATUS_AUTOCOMMIT = 0x0002;
+constexpr uint16_t SERVER_MORE_RESULTS_EXISTS = 0x0008;
+
+constexpr uint8_t COM_QUIT = 0x01;
+constexpr uint8_t COM_INIT_DB = 0x02;
+constexpr uint8_t COM_QUERY = 0x03;
+constexpr uint8_t COM_PING = 0x0e;
+constexpr uint8_t COM_CHANGE_USER = 0x11;
+constexpr uint8_t COM_STMT_PREPARE = 0x16;
+constexpr uint8_t COM_STMT_EXECUTE = 0x17;
+constexpr uint8_t COM_STMT_CLOSE = 0x19;
+constexpr uint8_t COM_STMT_RESET = 0x1a;
+constexpr uint8_t COM_RESET_CONNECTION = 0x1f;
+
+constexpr uint8_t CHARSET_UTF8_GENERAL_CI = 33;
+constexpr uint8_t MYSQL_TYPE_VAR_STRING = 0xfd;
+constexpr size_t MAX_PACKET_PAYLOAD = 0xffffff;
+
+bool read_fully(int fd, char* buf, size_t len) {
+    while (len > 0) {
+        auto n = ::recv(fd, buf, len, 0);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        buf += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool write_fully(int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        auto n = ::send(fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        buf += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool read_packet(int fd, std::string& payload, uint8_t& seq) {
+    payload.clear();
+    size_t len = 0;
+    do {
+        unsigned char header[4];
+        if (!read_fully(fd, reinterpret_cast<char*>(header), 4)) {
+            return false;
+        }
+        len = header[0] | (header[1] << 8) | (header[2] << 16);
+        seq = header[3];
+        auto offset = payload.size();
+        payload.resize(offset + len);
+        if (len > 0 && !read_fully(fd, &payload[offset], len)) {
+            return false;
+        }
+    } while (len == MAX_PACKET_PAYLOAD);
+    return true;
+}
+
+bool write_packet(int fd, const std::string& payload, uint8_t& seq) {
+    size_t offset = 0;
+    while (true) {
+        auto len = std::min(payload.size() - offset, MAX_PACKET_PAYLOAD);
+        std::string packet(4, '\0');
+        packet[0] = static_cast<char>(len & 0xff);
+        packet[1] = static_cast<char>((len >> 8) & 0xff);
+        packet[2] = static_cast<char>((len >> 16) & 0xff);
+        packet[3] = static_cast<char>(seq++);
+        packet.append(payload, offset, len);
+        if (!write_fully(fd, packet.data(), packet.size())) {
+            return false;
+        }
+        offset += len;
+        // a payload of exactly N * 0xffffff bytes ends with an empty packet
+        if (len < MAX_PACKET_PAYLOAD) {
+            return true;
+        }
+    }
+}
+
+void put_int(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+void put_lenenc_int(std::string& out, uint64_t value) {
+    if (value < 251) {
+        put_int(out, value, 1);
+    } else if (value < (1ULL << 16)) {
+        out.push_back(static_cast<char>(0xfc));
+        put_int(out, value, 2);
+    } else if (value < (1ULL << 24)) {
+        out.push_back(static_cast<char>(0xfd));
+        put_int(out, value, 3);
+    } else {
+        out.push_back(static_cast<char>(0xfe));
+        put_int(out, value, 8);
+    }
+}
+
+void put_lenenc_str(std::string& out, const std::string& value) {
+    put_lenenc_int(out, value.size());
+    out += value;
+}
+
+// the 4 byte statement id following the command byte, 0 (never handed out) when missing
+uint32_t statement_id(const std::string& payload) {
+    uint32_t id = 0;
+    for (size_t i = 0; i < 4 && i + 1 < payload.size(); i++) {
+        id |= static_cast<uint32_t>(static_cast<uint8_t>(payload[i + 1])) << (8 * i);
+    }
+    return payload.size() >= 5 ? id : 0;
+}
+
+std::string ok_packet(uint64_t affected_rows, uint16_t status) {
+    std::string out(1, '\0');
+    put_lenenc_int(out, affected_rows);
+    put_lenenc_int(out, 0);
+    put_int(out, status, 2);
+    put_int(out, 0, 2);
+    return out;
+}
+
+std::string eof_packet(uint16_t status) {
+    std::string out(1, static_cast<char>(0xfe));
+    put_int(out, 0, 2);
+    put_int(out, status, 2);
+    return out;
+}
+
+std::string err_packet(uint16_t code, const std::string& message) {
+    std::string out(1, static_cast<char>(0xff));
+    put_int(out, code, 2);
+    out += "#HY000";
+    out += message;
+    return out;
+}
+
+std::string column_definition(const std::string& name) {
+    std::string out;
+    put_lenenc_str(out, "def");
+    put_lenenc_str(out, "");
+    put_lenenc_str(out, "");
+    put_lenenc_str(out, "");
+    put_lenenc_str(out, name);
+    put_lenenc_str(out, name);
+    put_lenenc_int(out, 0x0c);
+    put_int(out, CHARSET_UTF8_GENERAL_CI, 2);
+    put_int(out, 1024, 4);
+    put_int(out, MYSQL_TYPE_VAR_STRING, 1);
+    put_int(out, 0, 2);
+    put_int(out, 0, 1);
+    put_int(out, 0, 2);
+    return out;
+}
+
+std::string lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::tolower(c); });
+    return s;
+}
+
+// trims whitespace and trailing semicolons so statements compare equal to the HA query constants
+std::string normalize(std::string s) {
+    trim(s);
+    while (!s.empty() && s.back() == ';') {
+        s.pop_back();
+        rtrim(s);
+    }
+    return s;
+}
+
+bool starts_with_ci(const std::string& s, const std::string& prefix) {
+    return s.size() >= prefix.size() && lower(s.substr(0, prefix.size())) == prefix;
+}
+
+// splits on semicolons outside quotes and comments
+std::vector<std::string> split_statements(const std::string& sql) {
+    std::vector<std::string> statements;
+    std::string current;
+    char quote = 0;
+    bool comment = false;
+    for (size_t i = 0; i < sql.size(); i++) {
+        char c = sql[i];
+        current.push_back(c);
+        if (comment) {
+            if (c == '*' && i + 1 < sql.size() && sql[i + 1] == '/') {
+                current.push_back(sql[++i]);
+                comment = false;
+            }
+        } else if (quote) {
+            if (c == '\\' && i + 1 < sql.size()) {
+                current.push_back(sql[++i]);
+            } else if (c == quote) {
+                quote = 0;
+            }
+        } else if (c == '\'' || c == '"' || c == '`') {
+            quote = c;
+        } else if (c == '/' && i + 1 < sql.size() && sql[i + 1] == '*') {
+            current.push_back(sql[++i]);
+            comment = true;
+        } else if (c == ';') {
+            current.pop_back();
+            if (!normalize(current).empty()) {
+                statements.push_back(normalize(current));
+            }
+            current.clear();
+        }
+    }
+    if (!normalize(current).empty()) {
+        statements.push_back(normalize(current));
+    }
+    return statements;
+}
+
+const std::map<std::string, std::string>& session_variables() {
+    static const std::map<std::string, std::string> variables {
+        {"autocommit", "1"},
+        {"character_set_client", "utf8mb4"},
+        {"character_set_connection", "utf8mb4"},
+        {"character_set_results", "utf8mb4"},
+        {"character_set_server", "utf8mb4"},
+        {"collation_connection", "utf8mb4_general_ci"},
+        {"lower_case_table_names", "0"},
+        {"max_allowed_packet", "67108864"},
+        {"net_write_timeout", "60"},
+        {"sql_mode", ""},
+        {"time_zone", "SYSTEM"},
+        {"transaction_isolation", "REPEATABLE-READ"},
+        {"tx_isolation", "REPEATABLE-READ"},
+        {"wait_timeout", "28800"},
+    };
+    return variables;
+}
+
+std::optional<std::string> session_variable(std::string name) {
+    name = lower(name);
+    for (const auto& scope : {"session.", "global.", "local."}) {
+        if (name.rfind(scope, 0) == 0) {
+            name = name.substr(strlen(scope));
+        }
+    }
+    const auto& variables = session_variables();
+    auto it = variables.find(name);
+    if (it == variables.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+// number of row tuples after VALUES, one affected row each
+uint64_t count_value_tuples(const std::string& statement) {
+    auto pos = lower(statement).find("values");
+    if (pos == std::string::npos) {
+        return 1;
+    }
+    uint64_t tuples = 0;
+    int depth = 0;
+    char quote = 0;
+    for (size_t i = pos; i < statement.size(); i++) {
+        char c = statement[i];
+        if (quote) {
+            if (c == '\\') {
+                i++;
+            } else if (c == quote) {
+                quote = 0;
+            }
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+        } else if (c == '(') {
+            if (depth++ == 0) {
+                tuples++;
+            }
+        } else if (c == ')') {
+            depth--;
+        }
+    }
+    return std::max<uint64_t>(tuples, 1);
+}
+
+} // namespace
+
+Reply Reply::ok(uint64_t affected_rows) {
+    Reply reply;
+    reply.kind = Kind::OK;
+    reply.affected_rows = affected_rows;
+    return reply;
+}
+
+Reply Reply::error(uint16_t code, const std::string& message) {
+    Reply reply;
+    reply.kind = Kind::ERR;
+    reply.error_code = code;
+    reply.message = message;
+    return reply;
+}
+
+Reply Reply::result_set(std::vector<std::string> columns, std::vector<std::vector<std::optional<std::string>>> rows) {
+    Reply reply;
+    reply.kind = Kind::RESULT_SET;
+    reply.columns = std::move(columns);
+    reply.rows = std::move(rows);
+    return reply;
+}
+
+Reply generic_reply(const std::string& statement, uint16_t port) {
+    auto lowered = lower(statement);
+    for (const auto& keyword : {"set ", "use ", "begin", "start ", "commit", "rollback", "call ", "do "}) {
+        if (lowered.rfind(keyword, 0) == 0) {
+            return Reply::ok();
+        }
+    }
+    if (starts_with_ci(lowered, "insert ") || starts_with_ci(lowered, "replace ")) {
+        return Reply::ok(count_value_tuples(statement));
+    }
+    if (starts_with_ci(lowered, "update ") || starts_with_ci(lowered, "delete ")) {
+        return Reply::ok();
+    }
+
+    if (starts_with_ci(lowered, "select ")) {
+        // select @@a, @@b / select <literal>
+        std::vector<std::string> columns;
+        std::vector<std::optional<std::string>> row;
+        std::istringstream iss(statement.substr(strlen("select ")));
+        std::string item;
+        while (getline(iss, item, ',')) {
+            trim(item);
+            auto space = item.find(' ');
+            auto expr = item.substr(0, space);
+            columns.push_back(expr);
+            if (lower(expr) == "@@port") {
+                row.push_back(std::to_string(port));
+            } else if (expr.rfind("@@", 0) == 0) {
+                row.push_back(session_variable(expr.substr(2)));
+            } else if (expr.size() >= 2 && (expr.front() == '\'' || expr.front() == '"') && expr.back() == expr.front()) {
+                row.push_back(expr.substr(1, expr.size() - 2));
+            } else {
+                row.push_back(expr);
+            }
+        }
+        return Reply::result_set(std::move(columns), {std::move(row)});
+    }
+
+    if (starts_with_ci(lowered, "show ")) {
+        std::vector<std::vector<std::optional<std::string>>> rows;
+        auto like = lowered.find(" like ");
+        if (lowered.find("variables") != std::string::npos && like != std::string::npos) {
+            auto pattern = statement.substr(like + strlen(" like "));
+            trim(pattern);
+            if (pattern.size() >= 2 && (pattern.front() == '\'' || pattern.front() == '"')) {
+                pattern = pattern.substr(1, pattern.size() - 2);
+            }
+            pattern = lower(pattern);
+            bool prefix = !pattern.empty() && pattern.back() == '%';
+            if (prefix) {
+                pattern.pop_back();
+            }
+            for (const auto& [name, value] : session_variables()) {
+                if (prefix ? name.rfind(pattern, 0) == 0 : name == pattern) {
+                    rows.push_back({name, value});
+                }
+            }
+        }
+        return Reply::result_set({"Variable_name", "Value"}, std::move(rows));
+    }
+
+    return Reply::error(1064, "You have an error in your SQL syntax near '" + statement.substr(0, 64) + "'");
+}
+
+StandInServer::StandInServer(QueryHandler handler, uint16_t port)
+    : handler_(std::move(handler)), port_(port), server_version_("8.0.32") {}
+
+StandInServer::~StandInServer() {
+    stop();
+}
+
+std::string StandInServer::addr() const {
+    return mergeHostPort("127.0.0.1", port_);
+}
+
+void StandInServer::set_server_version(const std::string& version) {
+    std::lock_guard<std::mutex> lock(version_mutex_);
+    server_version_ = version;
+}
+
+std::string StandInServer::server_version() const {
+    std::lock_guard<std::mutex> lock(version_mutex_);
+    return server_version_;
+}
+
+void StandInServer::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) {
+        return;
+    }
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("socket failed: ") + strerror(errno));
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    sockaddr_in sa {};
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sa.sin_port = htons(port_);
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) != 0 || ::listen(fd, 1024) != 0) {
+        auto err = errno;
+        ::close(fd);
+        throw std::runtime_error("bind 127.0.0.1:" + std::to_string(port_) + " failed: " + strerror(err));
+    }
+    socklen_t len = sizeof(sa);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&sa), &len);
+    port_ = ntohs(sa.sin_port);
+
+    listen_fd_ = fd;
+    stopping_ = false;
+    running_ = true;
+    accept_thread_ = std::thread([this]() { accept_loop(); });
+}
+
+void StandInServer::stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+        return;
+    }
+    stopping_ = true;
+    running_ = false;
+    if (accept_thread_.joinable()) {
+        accept_thread_.join();
+    }
+    ::close(listen_fd_);
+    listen_fd_ = -1;
+    reap_sessions(true);
+}
+
+void StandInServer::accept_loop() {
+    while (!stopping_) {
+        pollfd pfd {listen_fd_, POLLIN, 0};
+        if (::poll(&pfd, 1, 20) <= 0) {
+            continue;
+        }
+        int fd = ::accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        connection_count_++;
+
+        auto session = std::make_unique<Session>();
+        session->fd = fd;
+        session->id = next_session_id_++;
+        auto* raw = session.get();
+        session->thread = std::thread([this, raw]() {
+            serve(*raw);
+            raw->done = true;
+        });
+        // sessions_ is only touched by this thread while running, stop() joins it first
+        sessions_.push_back(std::move(session));
+        reap_sessions(false);
+    }
+}
+
+void StandInServer::reap_sessions(bool all) {
+    for (auto it = sessions_.begin(); it != sessions_.end();) {
+        auto& session = **it;
+        if (all || session.done) {
+            if (all) {
+                ::shutdown(session.fd, SHUT_RDWR);
+            }
+            if (session.thread.joinable()) {
+                session.thread.join();
+            }
+            ::close(session.fd);
+            it = sessions_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool StandInServer::stall() {
+    auto latency = latency_millis_.load();
+    if (latency > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(latency));
+    }
+    while (partitioned_ && !stopping_) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return !stopping_;
+}
+
+bool StandInServer::handshake(Session& session) {
+    auto version = server_version();
+
+    // mysql_native_password; the scramble is never checked
+    const std::string scramble = "0123456789abcdefghij";
+    std::string out(1, '\x0a');
+    out += version;
+    out.push_back('\0');
+    put_int(out, session.id, 4);
+    out += scramble.substr(0, 8);
+    out.push_back('\0');
+    put_int(out, SERVER_CAPABILITIES & 0xffff, 2);
+    put_int(out, CHARSET_UTF8_GENERAL_CI, 1);
+    put_int(out, SERVER_STATUS_AUTOCOMMIT, 2);
+    put_int(out, SERVER_CAPABILITIES >> 16, 2);
+    put_int(out, scramble.size() + 1, 1);
+    out.append(10, '\0');
+    out += scramble.substr(8);
+    out.push_back('\0');
+    out += "mysql_native_password";
+    out.push_back('\0');
+
+    uint8_t seq = 0;
+    if (!write_packet(session.fd, out, seq)) {
+        return false;
+    }
+
+    std::string response;
+    if (!read_packet(session.fd, response, seq) || response.size() < 4) {
+        return false;
+    }
+    session.client_flags = static_cast<uint8_t>(response[0]) | (static_cast<uint8_t>(response[1]) << 8) |
+        (static_cast<uint8_t>(response[2]) << 16) | (static_cast<uint32_t>(static_cast<uint8_t>(response[3])) << 24);
+
+    seq++;
+    return write_packet(session.fd, ok_packet(0, SERVER_STATUS_AUTOCOMMIT), seq);
+}
+
+void StandInServer::serve(Session& session) {
+    if (!stall() || !handshake(session)) {
+        return;
+    }
+
+    std::string payload;
+    uint8_t seq = 0;
+    while (!stopping_) {
+        if (!read_packet(session.fd, payload, seq) || payload.empty()) {
+            return;
+        }
+        if (!stall()) {
+            return;
+        }
+        seq++;
+
+        auto command = static_cast<uint8_t>(payload[0]);
+        bool ok = true;
+        switch (command) {
+            case COM_QUIT:
+                return;
+            case COM_QUERY:
+                query_count_++;
+                ok = handle_query(session, payload.substr(1), seq);
+                break;
+            case COM_INIT_DB:
+            case COM_PING:
+            case COM_CHANGE_USER:
+            case COM_RESET_CONNECTION:
+                ok = write_packet(session.fd, ok_packet(0, SERVER_STATUS_AUTOCOMMIT), seq);
+                break;
+            case COM_STMT_PREPARE:
+                prepare_count_++;
+                ok = handle_prepare(session, payload.substr(1), seq);
+                break;
+            case COM_STMT_EXECUTE:
+            case COM_STMT_RESET:
+                if (session.statements.count(statement_id(payload)) == 0) {
+                    ok = write_packet(session.fd, err_packet(1243, "Unknown prepared statement handler"), seq);
+                } else {
+                    query_count_ += command == COM_STMT_EXECUTE ? 1 : 0;
+                    ok = write_packet(session.fd, ok_packet(command == COM_STMT_EXECUTE ? 1 : 0, SERVER_STATUS_AUTOCOMMIT), seq);
+                }
+                break;
+            case COM_STMT_CLOSE:
+                session.statements.erase(statement_id(payload));
+                break;
+            default:
+                ok = write_packet(session.fd, err_packet(1047, "Unknown command"), seq);
+                break;
+        }
+        if (!ok) {
+            return;
+        }
+    }
+}
+
+bool StandInServer::handle_query(Session& session, const std::string& sql, uint8_t& seq) {
+    std::vector<std::string> statements;
+    if (session.client_flags & CLIENT_MULTI_STATEMENTS) {
+        statements = split_statements(sql);
+    } else {
+        statements.push_back(normalize(sql));
+    }
+    if (statements.empty()) {
+        return write_packet(session.fd, err_packet(1065, "Query was empty"), seq);
+    }
+
+    for (size_t i = 0; i < statements.size(); i++) {
+        auto reply = handler_ ? handler_(statements[i]) : std::nullopt;
+        if (!reply && lower(statements[i]) == "select connection_id()") {
+            // ids grow with every accepted connection, so tests can tell old sessions from new ones
+            reply = Reply::result_set({"connection_id()"}, {{std::to_string(session.id)}});
+        }
+        if (!reply) {
+            reply = generic_reply(statements[i], port_);
+        }
+        bool more = i + 1 < statements.size() && reply->kind != Reply::Kind::ERR;
+        if (!send_reply(session, *reply, seq, more)) {
+            return false;
+        }
+        if (!more) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool StandInServer::handle_prepare(Session& session, const std::string& sql, uint8_t& seq) {
+    // placeholders outside quotes, each announced with a column definition
+    uint16_t params = 0;
+    char quote = 0;
+    for (size_t i = 0; i < sql.size(); i++) {
+        char c = sql[i];
+        if (quote) {
+            if (c == '\\') {
+                i++;
+            } else if (c == quote) {
+                quote = 0;
+            }
+        } else if (c == '\'' || c == '"' || c == '`') {
+            quote = c;
+        } else if (c == '?') {
+            params++;
+        }
+    }
+
+    auto id = session.next_statement_id++;
+    session.statements[id] = normalize(sql);
+    std::string out(1, '\0');
+    put_int(out, id, 4);
+    put_int(out, 0, 2);
+    put_int(out, params, 2);
+    put_int(out, 0, 1);
+    put_int(out, 0, 2);
+    if (!write_packet(session.fd, out, seq)) {
+        return false;
+    }
+    for (uint16_t i = 0; i < params; i++) {
+        if (!write_packet(session.fd, column_definition("?"), seq)) {
+            return false;
+        }
+    }
+    return params == 0 || write_packet(session.fd, eof_packet(SERVER_STATUS_AUTOCOMMIT), seq);
+}
+
+bool StandInServer::send_reply(Session& session, const Reply& reply, uint8_t& seq, bool more_results) {
+    uint16_t status = SERVER_STATUS_AUTOCOMMIT | (more_results ? SERVER_MORE_RESULTS_EXISTS : 0);
+    if (reply.kind == Reply::Kind::OK) {
+        return write_packet(session.fd, ok_packet(reply.affected_rows, status), seq);
+    }
+    if (reply.kind == Reply::Kind::ERR) {
+        return write_packet(session.fd, err_packet(reply.error_code, reply.message), seq);
+    }
+
+    std::string out;
+    put_lenenc_int(out, reply.columns.size());
+    if (!write_packet(session.fd, out, seq)) {
+        return false;
+    }
+    for (const auto& column : reply.columns) {
+        if (!write_packet(session.fd, column_definition(column), seq)) {
+            return false;
+        }
+    }
+    if (!write_packet(session.fd, eof_packet(status), seq)) {
+        return false;
+    }
+    for (const auto& row : reply.rows) {
+        out.clear();
+        for (const auto& value : row) {
+            if (value) {
+                put_lenenc_str(out, *value);
+            } else {
+                out.push_back(static_cast<char>(0xfb));
+            }
+        }
+        if (!write_packet(session.fd, out, seq)) {
+            return false;
+        }
+    }
+    return write_packet(session.fd, eof_packet(status), seq);
+}
+
+std::string StandInCluster::addrs() const {
+    std::string out;
+    for (const auto& server : servers_) {
+        if (!out.empty()) {
+            out += ",";
+        }
+        out += server->addr();
+    }
+    return out;
+}
+
+void StandInCluster::set_query_hook(QueryHook hook) {
+    std::lock_guard<std::mutex> lock(hook_mutex_);
+    hook_ = std::move(hook);
+}
+
+void StandInCluster::start_servers(size_t count, const std::string& version) {
+    for (size_t i = 0; i < count; i++) {
+        auto server = std::make_unique<StandInServer>([this, i](const std::string& statement) -> std::optional<Reply> {
+            QueryHook hook;
+            {
+                std::lock_guard<std::mutex> lock(hook_mutex_);
+                hook = hook_;
+            }
+            if (hook) {
+                auto reply = hook(i, statement);
+                if (reply) {
+                    return reply;
+                }
+            }
+            return answer(i, statement);
+        });
+        server->set_server_version(version);
+        servers_.push_back(std::move(server));
+    }
+    // ports are needed by the model before the first query can be answered
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& server : servers_) {
+        server->start();
+    }
+}
+
+void StandInCluster::shutdown() {
+    for (auto& server : servers_) {
+        server->stop();
+    }
+}
+
+XClusterStandIn::XClusterStandIn(size_t node_count, int32_t cluster_id, const std::string& version)
+    : cluster_id_(cluster_id), nodes_(node_count) {
+    if (node_count == 0) {
+        throw std::invalid_argument("node_count must be positive");
+    }
+    for (auto& node : nodes_) {
+        node.role = "Follower";
+    }
+    nodes_[0].role = "Leader";
+    start_servers(node_count, version);
+}
+
+int XClusterStandIn::leader() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    settle();
+    return leader_;
+}
+
+std::string XClusterStandIn::leader_addr() {
+    auto i = leader();
+    return i < 0 ? "" : addr(i);
+}
+
+void XClusterStandIn::transfer_leader(size_t to, int32_t transfer_millis) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    settle();
+    next_leader_ = static_cast<int>(to);
+    transferring_ = true;
+    change_at_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(transfer_millis);
+    settle();
+}
+
+void XClusterStandIn::elect(size_t i, int32_t after_millis) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    settle();
+    next_leader_ = static_cast<int>(i);
+    transferring_ = false;
+    change_at_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(after_millis);
+    settle();
+}
+
+void XClusterStandIn::set_role(size_t i, const std::string& role) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    nodes_.at(i).role = role;
+}
+
+void XClusterStandIn::set_apply_delay(size_t i, int32_t seconds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    nodes_.at(i).apply_delay = seconds;
+}
+
+void XClusterStandIn::set_election_weight(size_t i, int32_t weight) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    nodes_.at(i).election_weight = weight;
+}
+
+void XClusterStandIn::settle() {
+    if (next_leader_ < 0 || std::chrono::steady_clock::now() < change_at_) {
+        return;
+    }
+    if (leader_ >= 0) {
+        nodes_[leader_].role = "Follower";
+    }
+    leader_ = next_leader_;
+    nodes_[leader_].role = "Leader";
+    next_leader_ = -1;
+    transferring_ = false;
+}
+
+std::string XClusterStandIn::paxos_addr(size_t i) const {
+    return mergeHostPort("127.0.0.1", servers_[i]->port() - PaxosPortGap);
+}
+
+std::optional<Reply> XClusterStandIn::answer(size_t i, const std::string& statement) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    settle();
+    bool is_leader = static_cast<int>(i) == leader_;
+
+    if (statement == normalize(BASIC_INFO_QUERY)) {
+        return Reply::result_set({"version()", "@@cluster_id", "@@port"},
+            {{servers_[i]->server_version(), std::to_string(cluster_id_), std::to_string(servers_[i]->port())}});
+    }
+
+    if (statement == normalize(CLUSTER_LOCAL_QUERY)) {
+        auto current_leader = leader_ >= 0 ? paxos_addr(leader_) : std::string();
+        return Reply::result_set({"CURRENT_LEADER", "ROLE"}, {{current_leader, nodes_[i].role}});
+    }
+
+    if (statement == normalize(CLUSTER_GLOBAL_QUERY)) {
+        std::vector<std::vector<std::optional<std::string>>> rows;
+        if (is_leader) {
+            for (size_t j = 0; j < nodes_.size(); j++) {
+                rows.push_back({nodes_[j].role, paxos_addr(j)});
+            }
+        }
+        return Reply::result_set({"ROLE", "IP_PORT"}, std::move(rows));
+    }
+
+    if (statement == normalize(CHECK_LEADER_TRANSFER_QUERY)) {
+        auto transferring = is_leader && transferring_ ? "1" : "0";
+        return Reply::result_set({"Variable_name", "Value"}, {{std::string("consensus_in_leader_transfer"), std::string(transferring)}});
+    }
+
+    int apply_delay_threshold = 0, weight_threshold = 0;
+    if (sscanf(statement.c_str(), CLUSTER_HEALTH_QUERY.c_str(), &apply_delay_threshold, &weight_threshold) == 2) {
+        std::vector<std::vector<std::optional<std::string>>> rows;
+        if (is_leader) {
+            for (size_t j = 0; j < nodes_.size(); j++) {
+                if (alive(j) && nodes_[j].apply_delay <= apply_delay_threshold &&
+                    nodes_[j].election_weight > weight_threshold) {
+                    rows.push_back({nodes_[j].role, paxos_addr(j)});
+                }
+            }
+        }
+        return Reply::result_set({"Role", "IP_PORT"}, std::move(rows));
+    }
+
+    return std::nullopt;
+}
+
+PolarDBXStandIn::PolarDBXStandIn(std::vector<CnSpec> cns, const std::string& version)
+    : cns_(std::move(cns)) {
+    if (cns_.empty()) {
+        throw std::invalid_argument("at least one cn is required");
+    }
+    for (size_t i = 0; i < cns_.size(); i++) {
+        if (cns_[i].instance_name.empty()) {
+            cns_[i].instance_name = "pxc-stand-in-" + std::to_string(i);
+        }
+    }
+    start_servers(cns_.size(), version);
+}
+
+void PolarDBXStandIn::set_leader(size_t i) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    leader_ = i;
+}
+
+void PolarDBXStandIn::set_role(size_t i, const std::string& role) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cns_.at(i).role = role;
+}
+
+void PolarDBXStandIn::set_zones(size_t i, const std::string& zones) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cns_.at(i).zones = zones;
+}
+
+std::optional<Reply> PolarDBXStandIn::answer(size_t i, const std::string& statement) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (statement == normalize(BASIC_INFO_QUERY)) {
+        return Reply::result_set({"version()", "@@cluster_id", "@@port"},
+            {{servers_[i]->server_version(), std::string("-1"), std::to_string(servers_[i]->port())}});
+    }
+
+    if (statement == normalize(SHOW_MPP_QUERY)) {
+        std::vector<std::vector<std::optional<std::string>>> rows;
+        for (size_t j = 0; j < cns_.size(); j++) {
+            if (alive(j)) {
+                rows.push_back({cns_[j].instance_name, addr(j), cns_[j].role,
+                                std::string(j == leader_ ? "Y" : "N"), cns_[j].zones});
+            }
+        }
+        return Reply::result_set({"ID", "NODE", "ROLE", "LEADER", "SUB_CLUSTER"}, std::move(rows));
+    }
+
+    return std::nullopt;
+}
+
+} // namespace stand_in
+} // namespace polardbx
+} // namespace sql
@@ -0,0 +1,234 @@
+#ifndef STAND_IN_SERVER_H
+#define STAND_IN_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sql {
+namespace polardbx {
+namespace stand_in {
+
+// Minimal MySQL wire-protocol server used to exercise the driver without a live
+// cluster. It speaks the text protocol only: handshake (any credentials are
+// accepted), COM_QUERY, COM_PING, COM_INIT_DB, COM_RESET_CONNECTION and COM_QUIT.
+// Prepared statements are accepted for statements without a result set: execute
+// answers OK with one affected row.
+// `select connection_id()` returns the session's id, the n-th accepted connection gets n.
+
+struct Reply {
+    enum class Kind { OK, ERR, RESULT_SET };
+
+    Kind kind = Kind::OK;
+    uint64_t affected_rows = 0;
+    uint16_t error_code = 0;
+    std::string message;
+    std::vector<std::string> columns;
+    std::vector<std::vector<std::optional<std::string>>> rows;
+
+    static Reply ok(uint64_t affected_rows = 0);
+    static Reply error(uint16_t code, const std::string& message);
+    static Reply result_set(std::vector<std::string> columns, std::vector<std::vector<std::optional<std::string>>> rows);
+};
+
+// returns std::nullopt to fall back to generic_reply()
+using QueryHandler = std::function<std::optional<Reply>(const std::string& statement)>;
+
+// Answers what a plain server would for the statements a connector issues on its
+// own (SET, SELECT @@var, SHOW VARIABLES, transaction control, ...).
+Reply generic_reply(const std::string& statement, uint16_t port = 3306);
+
+class StandInServer {
+public:
+    // port 0 binds an ephemeral port on 127.0.0.1, the same port is reused by restarts
+    explicit StandInServer(QueryHandler handler, uint16_t port = 0);
+    ~StandInServer();
+
+    StandInServer(const StandInServer&) = delete;
+    StandInServer& operator=(const StandInServer&) = delete;
+
+    // throws std::runtime_error when the port cannot be bound
+    void start();
+    // closes the listener and every open session, clients see connection refused / reset
+    void stop();
+
+    bool running() const { return running_; }
+    uint16_t port() const { return port_; }
+    std::string addr() const;
+
+    void set_server_version(const std::string& version);
+    std::string server_version() const;
+    // delay before every handshake and every response
+    void set_latency(int32_t millis) { latency_millis_ = millis; }
+    // a partitioned server accepts tcp connections but never answers on them
+    void set_partitioned(bool partitioned) { partitioned_ = partitioned; }
+    bool partitioned() const { return partitioned_; }
+
+    uint64_t connection_count() const { return connection_count_; }
+    uint64_t query_count() const { return query_count_; }
+    uint64_t prepare_count() const { return prepare_count_; }
+
+private:
+    struct Session {
+        int fd = -1;
+        uint32_t id = 0;
+        uint32_t client_flags = 0;
+        // prepared statements by id
+        std::map<uint32_t, std::string> statements;
+        uint32_t next_statement_id = 1;
+        std::thread thread;
+        std::atomic<bool> done{false};
+    };
+
+    void accept_loop();
+    void serve(Session& session);
+    bool handshake(Session& session);
+    bool handle_query(Session& session, const std::string& sql, uint8_t& seq);
+    bool handle_prepare(Session& session, const std::string& sql, uint8_t& seq);
+    bool send_reply(Session& session, const Reply& reply, uint8_t& seq, bool more_results);
+    void reap_sessions(bool all);
+    // sleeps for the configured latency and while partitioned, false once stopping
+    bool stall();
+
+    QueryHandler handler_;
+    uint16_t port_;
+    int listen_fd_ = -1;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> stopping_{false};
+    std::atomic<int32_t> latency_millis_{0};
+    std::atomic<bool> partitioned_{false};
+    std::atomic<uint64_t> connection_count_{0};
+    std::atomic<uint64_t> query_count_{0};
+    std::atomic<uint64_t> prepare_count_{0};
+    std::atomic<uint32_t> next_session_id_{1};
+
+    // guards start/stop
+    std::mutex mutex_;
+    mutable std::mutex version_mutex_;
+    std::string server_version_;
+    std::thread accept_thread_;
+    std::list<std::unique_ptr<Session>> sessions_;
+};
+
+// A group of stand-in servers sharing one topology model. Derived models answer the
+// HA queries and must call shutdown() in their destructor.
+class StandInCluster {
+public:
+    using QueryHook = std::function<std::optional<Reply>(size_t node, const std::string& statement)>;
+
+    virtual ~StandInCluster() = default;
+
+    size_t size() const { return servers_.size(); }
+    std::string addr(size_t i) const { return servers_.at(i)->addr(); }
+    // comma separated, usable as hostName
+    std::string addrs() const;
+    StandInServer& server(size_t i) { return *servers_.at(i); }
+
+    void crash(size_t i) { servers_.at(i)->stop(); }
+    void restart(size_t i) { servers_.at(i)->start(); }
+    void partition(size_t i, bool partitioned) { servers_.at(i)->set_partitioned(partitioned); }
+    void set_latency(size_t i, int32_t millis) { servers_.at(i)->set_latency(millis); }
+    // consulted before the topology model, e.g. to serve application tables
+    void set_query_hook(QueryHook hook);
+
+protected:
+    void start_servers(size_t count, const std::string& version);
+    void shutdown();
+    bool alive(size_t i) const { return servers_[i]->running() && !servers_[i]->partitioned(); }
+    virtual std::optional<Reply> answer(size_t node, const std::string& statement) = 0;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<StandInServer>> servers_;
+
+private:
+    std::mutex hook_mutex_;
+    QueryHook hook_;
+};
+
+// XCluster (DN) model. Node i listens on addr(i) and reports paxos port
+// port - PaxosPortGap, matching the driver's default GlobalPortGap.
+class XClusterStandIn : public StandInCluster {
+public:
+    static constexpr int32_t PaxosPortGap = -8000;
+
+    explicit XClusterStandIn(size_t node_count, int32_t cluster_id = 1,
+                             const std::string& version = "8.0.32-X-Cluster-8.4.19-20240630");
+    ~XClusterStandIn() override { shutdown(); }
+
+    // -1 while no leader is elected
+    int leader();
+    std::string leader_addr();
+
+    // the current leader reports consensus_in_leader_transfer=1 for transfer_millis,
+    // then it steps down and node `to` becomes leader
+    void transfer_leader(size_t to, int32_t transfer_millis);
+    // node i becomes leader after after_millis. A crashed leader keeps being
+    // reported as CURRENT_LEADER by the followers until then, as in a real election.
+    void elect(size_t i, int32_t after_millis = 0);
+    void set_role(size_t i, const std::string& role);
+    void set_apply_delay(size_t i, int32_t seconds);
+    void set_election_weight(size_t i, int32_t weight);
+
+protected:
+    std::optional<Reply> answer(size_t node, const std::string& statement) override;
+
+private:
+    struct Node {
+        std::string role;
+        int32_t apply_delay = 0;
+        int32_t election_weight = 5;
+    };
+
+    // applies a due leadership change, mutex_ held
+    void settle();
+    std::string paxos_addr(size_t i) const;
+
+    int32_t cluster_id_;
+    std::vector<Node> nodes_;
+    int leader_ = 0;
+    int next_leader_ = -1;
+    bool transferring_ = false;
+    std::chrono::steady_clock::time_point change_at_;
+};
+
+struct CnSpec {
+    std::string instance_name;
+    // W, R or CR
+    std::string role = "W";
+    // comma separated zone list
+    std::string zones;
+};
+
+// PolarDB-X CN model answering `show mpp`. Crashed or partitioned CNs are left out
+// of the reported topology.
+class PolarDBXStandIn : public StandInCluster {
+public:
+    explicit PolarDBXStandIn(std::vector<CnSpec> cns,
+                             const std::string& version = "5.7.25-TDDL-5.4.19-20240927");
+    ~PolarDBXStandIn() override { shutdown(); }
+
+    void set_leader(size_t i);
+    void set_role(size_t i, const std::string& role);
+    void set_zones(size_t i, const std::string& zones);
+
+protected:
+    std::optional<Reply> answer(size_t node, const std::string& statement) override;
+
+private:
+    std::vector<CnSpec> cns_;
+    size_t leader_ = 0;
+};
+
+} // namespace stand_in
+} // namespace polardbx
+} // namespace sql
+
+#endif // STAND_IN_SERVER_H
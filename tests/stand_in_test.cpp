@@ -0,0 +1,721 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <jdbc/cppconn/statement.h>
+#include <jdbc/cppconn/prepared_statement.h>
+#include <jdbc/cppconn/resultset.h>
+#include <jdbc/cppconn/exception.h>
+
+#include "polardbx_driver.h"
+#include "polardbx_connection.h"
+#include "parallel_scan.h"
+#include "option_registry.h"
+#include "ha_manager.h"
+#include "config.h"
+#include "stand_in_server.h"
+
+// HA behaviour against local stand-in servers, no live cluster needed.
+
+namespace sql {
+namespace polardbx {
+
+struct HaManagerPeer {
+    static std::vector<std::shared_ptr<MppInfo>> get_all_mpp_info_concurrent(HaManager& manager,
+        const std::vector<std::string>& addresses) {
+        return manager.get_all_mpp_info_concurrent(addresses);
+    }
+
+    static std::vector<std::shared_ptr<MppInfo>> get_mpp_info(HaManager& manager, const std::string& addr) {
+        return manager.get_mpp_info(addr);
+    }
+
+    static int64_t conn_count(HaManager& manager, const std::string& addr) {
+        return manager.node_table_.conn_count(manager.node_table_.intern(addr));
+    }
+
+    static size_t cn_probe_connections(HaManager& manager) {
+        std::lock_guard<std::mutex> lk(manager.cn_seed_mutex_);
+        return manager.cn_probe_conns_.size();
+    }
+};
+
+} // namespace polardbx
+} // namespace sql
+
+using sql::polardbx::HaManager;
+using sql::polardbx::HaManagerPeer;
+
+using namespace sql::polardbx::stand_in;
+
+namespace {
+
+sql::ConnectOptionsMap options_for(const std::string& addrs) {
+    sql::ConnectOptionsMap options;
+    options[OPT_USERNAME] = std::string("root");
+    options[OPT_PASSWORD] = std::string("");
+    options[OPT_HOSTNAME] = addrs;
+    return options;
+}
+
+// port of the stand-in a fresh connection lands on, 0 if the connect fails
+int connected_port(sql::ConnectOptionsMap options) {
+    try {
+        std::unique_ptr<sql::Connection> conn(sql::polardbx::get_driver_instance()->connect(options));
+        std::unique_ptr<sql::Statement> stmt(conn->createStatement());
+        std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("select @@port"));
+        int port = res->next() ? res->getInt(1) : 0;
+        conn->close();
+        return port;
+    } catch (sql::SQLException& e) {
+        return 0;
+    }
+}
+
+bool connects_to(const sql::ConnectOptionsMap& options, int port, std::chrono::milliseconds within) {
+    auto deadline = std::chrono::steady_clock::now() + within;
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (connected_port(options) == port) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return false;
+}
+
+bool eventually(const std::function<bool()>& condition, std::chrono::milliseconds within) {
+    auto deadline = std::chrono::steady_clock::now() + within;
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return true;
+}
+
+// the stand-in numbers sessions in accept order, see StandInServer
+uint64_t session_id(sql::Connection& conn) {
+    std::unique_ptr<sql::Statement> stmt(conn.createStatement());
+    std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("select connection_id()"));
+    return res->next() ? res->getUInt64(1) : 0;
+}
+
+int session_port(sql::Connection& conn) {
+    std::unique_ptr<sql::Statement> stmt(conn.createStatement());
+    std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("select @@port"));
+    return res->next() ? res->getInt(1) : 0;
+}
+
+// Another process acting as the host-local prober of json_file: it holds the lock
+// and publishes topology files the way the driver does.
+class ForeignProber {
+public:
+    explicit ForeignProber(const std::string& json_file) : json_file_(json_file) {
+        fd_ = ::open((json_file + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+        ::flock(fd_, LOCK_EX);
+    }
+    ~ForeignProber() { die(); }
+
+    // the kernel drops the lock with the process
+    void die() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    // leader < 0 publishes a cluster without leader
+    void publish(XClusterStandIn& dn, int leader) {
+        std::string json = "[";
+        for (size_t i = 0; i < dn.size(); i++) {
+            json += std::string(i == 0 ? "" : ",") + "{\"tag\":\"" + dn.addr(i) + "\",\"host\":\"127.0.0.1\",\"port\":" +
+                    std::to_string(dn.server(i).port()) + ",\"role\":\"" +
+                    (static_cast<int>(i) == leader ? "Leader" : "Follower") + "\",\"peers\":[],\"update_time\":\"0\"}";
+        }
+        json += "]";
+        auto temp = json_file_ + ".tmp.test";
+        std::ofstream(temp) << json;
+        std::rename(temp.c_str(), json_file_.c_str());
+    }
+
+private:
+    std::string json_file_;
+    int fd_ = -1;
+};
+
+// a manager for CN seed probing only, no checker thread is started
+std::shared_ptr<HaManager> cn_prober(int32_t quorum) {
+    auto config = std::make_shared<sql::polardbx::PolarDBXConfig>();
+    config->conn_properties_ = options_for("");
+    config->CnProbeQuorum = quorum;
+    config->HaCheckConnectTimeoutMillis = 200;
+    config->HaCheckSocketTimeoutMillis = 1000;
+    return std::make_shared<HaManager>(false, false, 0, config);
+}
+
+std::vector<std::string> tags_of(const std::vector<std::shared_ptr<sql::polardbx::MppInfo>>& infos) {
+    std::vector<std::string> tags;
+    for (const auto& info : infos) {
+        tags.push_back(info->Tag);
+    }
+    return tags;
+}
+
+bool lock_held(const std::string& json_file) {
+    int fd = ::open((json_file + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+    bool held = ::flock(fd, LOCK_EX | LOCK_NB) != 0;
+    ::close(fd);
+    return held;
+}
+
+} // namespace
+
+TEST(StandInDnTest, FindsLeader) {
+    XClusterStandIn dn(3, 101);
+    EXPECT_EQ(connected_port(options_for(dn.addrs())), dn.server(0).port());
+}
+
+TEST(StandInDnTest, FollowsLeaderTransfer) {
+    XClusterStandIn dn(3, 102);
+    auto options = options_for(dn.addrs());
+    ASSERT_EQ(connected_port(options), dn.server(0).port());
+
+    dn.transfer_leader(1, 300);
+    EXPECT_TRUE(connects_to(options, dn.server(1).port(), std::chrono::seconds(5)));
+}
+
+TEST(StandInDnTest, FollowsNewLeaderAfterCrash) {
+    XClusterStandIn dn(3, 103);
+    auto options = options_for(dn.addrs());
+    ASSERT_EQ(connected_port(options), dn.server(0).port());
+
+    dn.crash(0);
+    dn.elect(2, 500);
+    EXPECT_TRUE(connects_to(options, dn.server(2).port(), std::chrono::seconds(10)));
+}
+
+TEST(StandInDnTest, SlaveReadSkipsLaggingFollower) {
+    XClusterStandIn dn(3, 104);
+    dn.set_apply_delay(1, 30);
+    auto options = options_for(dn.addrs());
+    options[OPT_SLAVE_ONLY] = true;
+    options[OPT_APPLY_DELAY_THRESHOLD] = 3;
+
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(connected_port(options), dn.server(2).port());
+    }
+}
+
+TEST(StandInDnTest, ConfirmedSuspectKeepsNormalReadTimeout) {
+    XClusterStandIn dn(3, 106);
+    auto options = options_for(dn.addrs());
+    options[OPT_LEADER_SUSPECT_WINDOW] = 3000;
+    // keeps the manager probing
+    std::unique_ptr<sql::Connection> holder(sql::polardbx::get_driver_instance()->connect(options));
+
+    // a restart breaks the ping connection, the leader turns suspect and is confirmed alive
+    dn.crash(0);
+    dn.restart(0);
+    ASSERT_TRUE(connects_to(options, dn.server(0).port(), std::chrono::seconds(5)));
+    std::this_thread::sleep_for(std::chrono::seconds(3));
+
+    // slower than the confirmation's read timeout, the long connection still waits for it
+    // instead of failing the ping and reconnecting
+    dn.set_latency(0, 4000);
+    auto connections = dn.server(0).connection_count();
+    std::this_thread::sleep_for(std::chrono::seconds(6));
+    EXPECT_EQ(dn.server(0).connection_count(), connections);
+    dn.set_latency(0, 0);
+}
+
+TEST(StandInDnTest, WarmPoolRefillsAndIsAdopted) {
+    XClusterStandIn dn(3, 107);
+    auto options = options_for(dn.addrs());
+    options[OPT_WARM_CONNECTIONS] = 2;
+    auto driver = sql::polardbx::get_driver_instance();
+    std::unique_ptr<sql::Connection> first(driver->connect(options));
+
+    // the first connect creates the pool, the maintainer fills it in the background
+    auto& leader = dn.server(0);
+    auto opened = leader.connection_count();
+    ASSERT_TRUE(eventually([&]() { return leader.connection_count() >= opened + 2; }, std::chrono::seconds(5)));
+
+    // a session opened before the connect was taken from the pool
+    auto before = leader.connection_count();
+    std::unique_ptr<sql::Connection> second(driver->connect(options));
+    EXPECT_LE(session_id(*second), before);
+    // and the pool is topped up again
+    EXPECT_TRUE(eventually([&]() { return leader.connection_count() >= before + 1; }, std::chrono::seconds(5)));
+}
+
+TEST(StandInDnTest, WarmPoolFollowsLeaderChange) {
+    XClusterStandIn dn(3, 108);
+    auto options = options_for(dn.addrs());
+    options[OPT_WARM_CONNECTIONS] = 2;
+    auto driver = sql::polardbx::get_driver_instance();
+    std::unique_ptr<sql::Connection> holder(driver->connect(options));
+
+    dn.transfer_leader(1, 300);
+    ASSERT_TRUE(connects_to(options, dn.server(1).port(), std::chrono::seconds(5)));
+    // give the maintainer a round to warm up against the new leader
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+
+    auto before = dn.server(1).connection_count();
+    std::unique_ptr<sql::Connection> conn(driver->connect(options));
+    EXPECT_LE(session_id(*conn), before);
+}
+
+TEST(StandInDnTest, WarmPoolSkipsDroppedConnections) {
+    XClusterStandIn dn(3, 109);
+    auto options = options_for(dn.addrs());
+    options[OPT_WARM_CONNECTIONS] = 2;
+    auto driver = sql::polardbx::get_driver_instance();
+    std::unique_ptr<sql::Connection> holder(driver->connect(options));
+    auto& leader = dn.server(0);
+    auto opened = leader.connection_count();
+    ASSERT_TRUE(eventually([&]() { return leader.connection_count() >= opened + 2; }, std::chrono::seconds(5)));
+
+    // a restart drops the pooled sessions without the client noticing until it pings
+    dn.crash(0);
+    dn.restart(0);
+    auto cold = options_for(dn.addrs());
+    ASSERT_TRUE(connects_to(cold, leader.port(), std::chrono::seconds(5)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    EXPECT_EQ(connected_port(options), leader.port());
+}
+
+TEST(StandInDnTest, CachedStatementIsPreparedOncePerCheckout) {
+    XClusterStandIn dn(3, 110);
+    auto options = options_for(dn.addrs());
+    options[OPT_PREP_STMT_CACHE_SIZE] = 4;
+    std::unique_ptr<sql::Connection> conn(sql::polardbx::get_driver_instance()->connect(options));
+    auto polardbx = dynamic_cast<sql::polardbx::PolarDBX_Connection*>(conn.get());
+    ASSERT_NE(polardbx, nullptr);
+    auto& leader = dn.server(0);
+    auto prepared = leader.prepare_count();
+
+    const sql::SQLString sql("insert into t values (?)");
+    for (int i = 0; i < 3; i++) {
+        auto stmt = polardbx->prepareCachedStatement(sql);
+        stmt->setInt(1, i);
+        EXPECT_EQ(stmt->executeUpdate(), 1);
+    }
+    EXPECT_EQ(leader.prepare_count(), prepared + 1);
+
+    // a second checkout while the first is out gets a statement of its own
+    auto outer = polardbx->prepareCachedStatement(sql);
+    outer->setInt(1, 1);
+    {
+        auto inner = polardbx->prepareCachedStatement(sql);
+        EXPECT_NE(inner.get(), outer.get());
+        inner->setInt(1, 2);
+        EXPECT_EQ(inner->executeUpdate(), 1);
+    }
+    // the inner checkout did not clear the outer one's parameters
+    EXPECT_EQ(outer->executeUpdate(), 1);
+    EXPECT_EQ(leader.prepare_count(), prepared + 2);
+}
+
+TEST(StandInDnTest, RerouteKeepsStatementsAndSessionState) {
+    XClusterStandIn dn(3, 111);
+    std::mutex mu;
+    std::vector<std::string> seen;
+    dn.set_query_hook([&](size_t node, const std::string& statement) -> std::optional<Reply> {
+        if (node == 1) {
+            std::string lowered(statement);
+            std::transform(lowered.begin(), lowered.end(), lowered.begin(), [](unsigned char c) { return std::tolower(c); });
+            std::lock_guard<std::mutex> lk(mu);
+            seen.push_back(lowered);
+        }
+        return std::nullopt;
+    });
+    auto options = options_for(dn.addrs());
+    options[OPT_PREP_STMT_CACHE_SIZE] = 4;
+    std::unique_ptr<sql::Connection> conn(sql::polardbx::get_driver_instance()->connect(options));
+    auto polardbx = dynamic_cast<sql::polardbx::PolarDBX_Connection*>(conn.get());
+    ASSERT_NE(polardbx, nullptr);
+    conn->setSchema("db1");
+    conn->setAutoCommit(false);
+    const sql::SQLString sql("insert into t values (?)");
+    {
+        auto stmt = polardbx->prepareCachedStatement(sql);
+        stmt->setInt(1, 1);
+        ASSERT_EQ(stmt->executeUpdate(), 1);
+    }
+
+    dn.transfer_leader(1, 300);
+    ASSERT_TRUE(connects_to(options, dn.server(1).port(), std::chrono::seconds(5)));
+    auto prepared = dn.server(1).prepare_count();
+    ASSERT_TRUE(conn->reconnect());
+    EXPECT_EQ(session_port(*conn), dn.server(1).port());
+
+    // the cached statement is prepared again on the new leader
+    auto stmt = polardbx->prepareCachedStatement(sql);
+    stmt->setInt(1, 2);
+    EXPECT_EQ(stmt->executeUpdate(), 1);
+    EXPECT_EQ(dn.server(1).prepare_count(), prepared + 1);
+
+    // and the schema and autocommit set through the connection went along
+    std::lock_guard<std::mutex> lk(mu);
+    auto sent = [&](const std::string& text) {
+        return std::any_of(seen.begin(), seen.end(), [&](const std::string& s) { return s.find(text) != std::string::npos; });
+    };
+    EXPECT_TRUE(sent("use `db1`"));
+    EXPECT_TRUE(sent("autocommit=0"));
+}
+
+TEST(StandInDnTest, PipelineSendsOnePacket) {
+    XClusterStandIn dn(3, 112);
+    auto options = options_for(dn.addrs());
+    options[OPT_ALLOW_MULTI_QUERIES] = true;
+    std::unique_ptr<sql::Connection> conn(sql::polardbx::get_driver_instance()->connect(options));
+    auto polardbx = dynamic_cast<sql::polardbx::PolarDBX_Connection*>(conn.get());
+    ASSERT_NE(polardbx, nullptr);
+    // the multi-statement flag stays off the caller's map
+    EXPECT_EQ(options.count("CLIENT_MULTI_STATEMENTS"), 0u);
+
+    std::vector<sql::polardbx::PipelineResult> results;
+    auto& leader = dn.server(0);
+    auto queries = leader.query_count();
+    {
+        auto pipeline = polardbx->pipeline();
+        pipeline->add("insert into t values (1)");
+        pipeline->add("select 'a', 'b';");
+        pipeline->add("insert into t values (2), (3)");
+        results = pipeline->execute();
+    }
+    EXPECT_EQ(leader.query_count(), queries + 1);
+
+    // the rows stay readable after the pipeline and its statement are gone
+    ASSERT_EQ(results.size(), 3u);
+    EXPECT_EQ(results[0].UpdateCount, 1u);
+    ASSERT_TRUE(results[1].ok());
+    ASSERT_NE(results[1].Rows, nullptr);
+    ASSERT_TRUE(results[1].Rows->next());
+    EXPECT_EQ(std::string(results[1].Rows->getString(2)), "b");
+    EXPECT_EQ(results[2].UpdateCount, 2u);
+}
+
+TEST(StandInDnTest, PipelineStopsAtFirstError) {
+    XClusterStandIn dn(3, 113);
+    auto options = options_for(dn.addrs());
+    options[OPT_ALLOW_MULTI_QUERIES] = true;
+    std::unique_ptr<sql::Connection> conn(sql::polardbx::get_driver_instance()->connect(options));
+    auto pipeline = dynamic_cast<sql::polardbx::PolarDBX_Connection*>(conn.get())->pipeline();
+
+    pipeline->add("insert into t values (1)");
+    pipeline->add("not a statement");
+    pipeline->add("insert into t values (2)");
+    auto results = pipeline->execute();
+    ASSERT_EQ(results.size(), 3u);
+    EXPECT_TRUE(results[0].ok());
+    EXPECT_FALSE(results[1].ok());
+    EXPECT_FALSE(results[2].ok());
+
+    // a ';' anywhere but at the end, or an unclosed quote, would split the packet differently
+    EXPECT_THROW(pipeline->add("select 1; select 2"), sql::InvalidArgumentException);
+    EXPECT_THROW(pipeline->add("select 'a;b'"), sql::InvalidArgumentException);
+    EXPECT_THROW(pipeline->add("select 'a"), sql::InvalidArgumentException);
+    EXPECT_THROW(pipeline->add("select 1 /* open"), sql::InvalidArgumentException);
+    EXPECT_NO_THROW(pipeline->add("select 'it''s', `a\\b` /* ok */"));
+    EXPECT_EQ(pipeline->size(), 1u);
+}
+
+TEST(StandInDnTest, OpenCursorPinsTheSession) {
+    XClusterStandIn dn(3, 114);
+    dn.set_query_hook([](size_t, const std::string& statement) -> std::optional<Reply> {
+        if (statement == "select v from big") {
+            return Reply::result_set({"v"}, {{std::string("1")}, {std::string("2")}, {std::string("3")}});
+        }
+        return std::nullopt;
+    });
+    auto options = options_for(dn.addrs());
+    std::unique_ptr<sql::Connection> conn(sql::polardbx::get_driver_instance()->connect(options));
+    auto polardbx = dynamic_cast<sql::polardbx::PolarDBX_Connection*>(conn.get());
+    ASSERT_NE(polardbx, nullptr);
+
+    auto cursor = polardbx->executeStreaming("select v from big");
+    EXPECT_THROW(conn->commit(), sql::SQLException);
+    EXPECT_THROW(conn->rollback(), sql::SQLException);
+    EXPECT_THROW(conn->setAutoCommit(false), sql::SQLException);
+    EXPECT_THROW(conn->getAutoCommit(), sql::SQLException);
+    EXPECT_THROW(conn->setSchema("db1"), sql::SQLException);
+    EXPECT_THROW(conn->getSchema(), sql::SQLException);
+    EXPECT_THROW(conn->isValid(), sql::SQLException);
+    EXPECT_THROW(conn->setTransactionIsolation(sql::TRANSACTION_READ_COMMITTED), sql::SQLException);
+    EXPECT_THROW(conn->setSavepoint("s1"), sql::SQLException);
+    EXPECT_THROW(conn->setReadOnly(true), sql::SQLException);
+    EXPECT_THROW(polardbx->setSessionVariable("sql_mode", ""), sql::SQLException);
+    EXPECT_THROW(polardbx->getSessionVariable("sql_mode"), sql::SQLException);
+    EXPECT_THROW(conn->createStatement(), sql::SQLException);
+
+    sql::polardbx::RowCursor::Row row;
+    int rows = 0;
+    while (cursor->next(row)) {
+        rows++;
+    }
+    EXPECT_EQ(rows, 3);
+    // drained, the session is free again
+    EXPECT_NO_THROW(conn->commit());
+    EXPECT_TRUE(conn->isValid());
+}
+
+TEST(StandInDnTest, WritesAroundTheCacheDropItsEntries) {
+    XClusterStandIn dn(3, 115);
+    std::atomic<int> reads{0};
+    dn.set_query_hook([&reads](size_t, const std::string& statement) -> std::optional<Reply> {
+        if (statement == "select v from t") {
+            reads++;
+            return Reply::result_set({"v"}, {{std::string("a")}});
+        }
+        return std::nullopt;
+    });
+    auto options = options_for(dn.addrs());
+    options[OPT_RESULT_CACHE_SIZE] = 1 << 20;
+    options[OPT_RESULT_CACHE_TTL] = 60000;
+    std::unique_ptr<sql::Connection> conn(sql::polardbx::get_driver_instance()->connect(options));
+    auto polardbx = dynamic_cast<sql::polardbx::PolarDBX_Connection*>(conn.get());
+    ASSERT_NE(polardbx, nullptr);
+    // true when the query reached the server instead of being served from the cache
+    auto missed = [&reads](sql::polardbx::PolarDBX_Connection* c) {
+        int before = reads;
+        c->executeCachedQuery("select v from t");
+        return reads > before;
+    };
+    EXPECT_TRUE(missed(polardbx));
+    EXPECT_FALSE(missed(polardbx));
+
+    // a write through a plain statement used to leave the entry stale
+    std::unique_ptr<sql::Statement> stmt(conn->createStatement());
+    EXPECT_EQ(stmt->getConnection(), conn.get());
+    stmt->executeUpdate("update t set v = 'b'");
+    EXPECT_TRUE(missed(polardbx));
+    std::unique_ptr<sql::ResultSet>(stmt->executeQuery("select 1"));
+    stmt->execute("select 1");
+    EXPECT_FALSE(missed(polardbx));
+    stmt->execute("delete from t");
+    EXPECT_TRUE(missed(polardbx));
+
+    std::unique_ptr<sql::PreparedStatement> insert(conn->prepareStatement("insert into t values (?)"));
+    insert->setInt(1, 1);
+    insert->executeUpdate();
+    EXPECT_TRUE(missed(polardbx));
+
+    conn->commit();
+    EXPECT_TRUE(missed(polardbx));
+    conn->rollback();
+    EXPECT_TRUE(missed(polardbx));
+    EXPECT_FALSE(missed(polardbx));
+
+    // the session state results depend on is part of the key
+    polardbx->setSessionVariable("time_zone", "+08:00");
+    EXPECT_TRUE(missed(polardbx));
+    EXPECT_FALSE(missed(polardbx));
+    auto reader_options = options;
+    reader_options[OPT_USERNAME] = std::string("reader");
+    std::unique_ptr<sql::Connection> reader(sql::polardbx::get_driver_instance()->connect(reader_options));
+    auto reader_polardbx = dynamic_cast<sql::polardbx::PolarDBX_Connection*>(reader.get());
+    ASSERT_NE(reader_polardbx, nullptr);
+    EXPECT_TRUE(missed(reader_polardbx));
+    EXPECT_FALSE(missed(reader_polardbx));
+}
+
+TEST(StandInDnTest, HostLocalProberElectionAndTakeover) {
+    XClusterStandIn dn(3, 105);
+    auto json_file = "/tmp/polardbx_stand_in_" + std::to_string(::getpid()) + "_105.json";
+    std::remove(json_file.c_str());
+    auto options = options_for(dn.addrs());
+    options[OPT_HOST_LOCAL_PROBE] = true;
+    options[OPT_JSON_FILE] = json_file;
+    options[OPT_POLARDBX_CONNECT_TIMEOUT] = 1000;
+
+    ForeignProber prober(json_file);
+    prober.publish(dn, 0);
+    // the lock is taken, the driver follows the published leader
+    EXPECT_TRUE(connects_to(options, dn.server(0).port(), std::chrono::seconds(5)));
+
+    // the prober lost the leader, followers stop routing to it
+    prober.publish(dn, -1);
+    EXPECT_TRUE(connects_to(options, 0, std::chrono::seconds(5)));
+    prober.publish(dn, 0);
+    EXPECT_TRUE(connects_to(options, dn.server(0).port(), std::chrono::seconds(5)));
+
+    // the prober process dies while the leader fails over, the driver takes over probing
+    dn.crash(0);
+    dn.elect(1);
+    prober.die();
+    EXPECT_TRUE(connects_to(options, dn.server(1).port(), std::chrono::seconds(10)));
+    EXPECT_TRUE(lock_held(json_file));
+
+    std::remove(json_file.c_str());
+}
+
+TEST(StandInDnTest, RetiredProberGivesUpTheLock) {
+    XClusterStandIn dn(3, 116);
+    auto json_file = "/tmp/polardbx_stand_in_" + std::to_string(::getpid()) + "_116.json";
+    std::remove(json_file.c_str());
+    auto options = options_for(dn.addrs());
+    options[OPT_HOST_LOCAL_PROBE] = true;
+    options[OPT_JSON_FILE] = json_file;
+    options[OPT_HA_CHECK_INTERVAL] = 100;
+    options[OPT_HA_SHUTDOWN_TIMEOUT] = 500;
+
+    // the only process on the host, the driver becomes the prober
+    EXPECT_EQ(connected_port(options), dn.server(0).port());
+    EXPECT_TRUE(eventually([&]() { return lock_held(json_file); }, std::chrono::seconds(5)));
+    // no connection left, the manager retires and a follower can take over at once
+    EXPECT_TRUE(eventually([&]() { return !lock_held(json_file); }, std::chrono::seconds(5)));
+
+    std::remove(json_file.c_str());
+}
+
+TEST(StandInCnTest, FailsOverToAnotherCn) {
+    PolarDBXStandIn cn({{"cn-0", "W", "z1"}, {"cn-1", "W", "z1"}, {"cn-2", "W", "z2"}});
+    auto options = options_for(cn.addr(0));
+    ASSERT_NE(connected_port(options), 0);
+
+    cn.crash(0);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    int port = 0;
+    while (std::chrono::steady_clock::now() < deadline) {
+        port = connected_port(options);
+        if (port != 0) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    EXPECT_TRUE(port == cn.server(1).port() || port == cn.server(2).port());
+}
+
+TEST(StandInCnTest, QuorumViewIsOrderedByTag) {
+    PolarDBXStandIn cn({{"cn-0", "W", "z1"}, {"cn-1", "W", "z1"}, {"cn-2", "R", "z2"}});
+    auto manager = cn_prober(2);
+
+    auto first = tags_of(HaManagerPeer::get_all_mpp_info_concurrent(*manager, {cn.addr(0), cn.addr(1), cn.addr(2)}));
+    auto second = tags_of(HaManagerPeer::get_all_mpp_info_concurrent(*manager, {cn.addr(2), cn.addr(1), cn.addr(0)}));
+    ASSERT_EQ(first.size(), 3u);
+    EXPECT_TRUE(std::is_sorted(first.begin(), first.end()));
+    EXPECT_EQ(first, second);
+}
+
+TEST(StandInCnTest, HungCnDoesNotHoldTheCheck) {
+    PolarDBXStandIn cn({{"cn-0", "W", "z1"}, {"cn-1", "W", "z1"}, {"cn-2", "W", "z2"}});
+    // every seed has to agree, so the round can only end on its deadline or the hung seed
+    auto manager = cn_prober(3);
+    cn.partition(2, true);
+
+    auto start = std::chrono::steady_clock::now();
+    auto infos = HaManagerPeer::get_all_mpp_info_concurrent(*manager, {cn.addr(0), cn.addr(1), cn.addr(2)});
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    // deadline is 200 + 1000ms, the hung seed holds its probe for the 2s connect timeout
+    EXPECT_LT(elapsed, std::chrono::milliseconds(1800));
+    std::vector<std::string> expected{cn.addr(0), cn.addr(1)};
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(tags_of(infos), expected);
+    cn.partition(2, false);
+}
+
+TEST(StandInCnTest, ProbeConnectionIsReused) {
+    PolarDBXStandIn cn({{"cn-0", "W", "z1"}});
+    auto manager = cn_prober(1);
+
+    for (int i = 0; i < 5; i++) {
+        ASSERT_EQ(HaManagerPeer::get_mpp_info(*manager, cn.addr(0)).size(), 1u);
+    }
+    EXPECT_EQ(cn.server(0).connection_count(), 1u);
+}
+
+TEST(StandInCnTest, ProbeHonoursReadTimeout) {
+    PolarDBXStandIn cn({{"cn-0", "W", "z1"}});
+    auto manager = cn_prober(1);
+    ASSERT_EQ(HaManagerPeer::get_mpp_info(*manager, cn.addr(0)).size(), 1u);
+
+    // 1s read timeout on the reused connection, then the 2s connect timeout of the retry
+    cn.set_latency(0, 10000);
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(HaManagerPeer::get_mpp_info(*manager, cn.addr(0)).empty());
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(5000));
+    cn.set_latency(0, 0);
+}
+
+TEST(StandInCnTest, ProbeConnectionOfRemovedSeedIsClosed) {
+    PolarDBXStandIn cn({{"cn-0", "W", "z1"}, {"cn-1", "W", "z1"}});
+    auto manager = cn_prober(2);
+
+    ASSERT_EQ(HaManagerPeer::get_all_mpp_info_concurrent(*manager, {cn.addr(0), cn.addr(1)}).size(), 2u);
+    EXPECT_EQ(HaManagerPeer::cn_probe_connections(*manager), 2u);
+
+    ASSERT_EQ(HaManagerPeer::get_all_mpp_info_concurrent(*manager, {cn.addr(0)}).size(), 2u);
+    EXPECT_EQ(HaManagerPeer::cn_probe_connections(*manager), 1u);
+}
+
+TEST(StandInCnTest, ParallelScanGivesConnectionsBack) {
+    PolarDBXStandIn cn({{"cn-0", "W", "z1"}, {"cn-1", "W", "z1"}, {"cn-2", "W", "z1"}});
+    cn.set_query_hook([](size_t, const std::string& statement) -> std::optional<Reply> {
+        const std::string prefix = "select v from t where (p = ";
+        if (statement.rfind(prefix, 0) != 0) {
+            return std::nullopt;
+        }
+        auto p = statement.substr(prefix.size(), 1);
+        return Reply::result_set({"v"}, {{p + "a"}, {p + "b"}});
+    });
+    auto options = options_for(cn.addrs());
+    auto queries = sql::polardbx::ParallelScan::expand("select v from t where {partition}",
+        {"p = 0", "p = 1", "p = 2", "p = 3"});
+    auto manager = HaManager::get_manager(sql::polardbx::parse_connect_options(options)->p_cfg);
+    ASSERT_NE(manager, nullptr);
+
+    {
+        sql::polardbx::ParallelScan scan(options, queries, 2, sql::polardbx::ParallelScan::Merge::ORDERED);
+        std::vector<std::string> values;
+        sql::polardbx::RowCursor::Row row;
+        while (scan.next(row)) {
+            values.push_back(*row[0]);
+        }
+        EXPECT_EQ(values, (std::vector<std::string>{"0a", "0b", "1a", "1b", "2a", "2b", "3a", "3b"}));
+    }
+    {
+        sql::polardbx::ParallelScan scan(options, queries, 3, sql::polardbx::ParallelScan::Merge::UNORDERED);
+        std::multiset<std::string> values;
+        sql::polardbx::RowCursor::Row row;
+        while (scan.next(row)) {
+            values.insert(*row[0]);
+        }
+        EXPECT_EQ(values.size(), 8u);
+        EXPECT_EQ(values.count("3b"), 1u);
+    }
+    {
+        // abandoned after the first row, the open pieces are closed with the scan
+        sql::polardbx::ParallelScan scan(options, queries, 3, sql::polardbx::ParallelScan::Merge::UNORDERED);
+        sql::polardbx::RowCursor::Row row;
+        ASSERT_TRUE(scan.next(row));
+    }
+
+    for (size_t i = 0; i < cn.size(); i++) {
+        EXPECT_EQ(HaManagerPeer::conn_count(*manager, cn.addr(i)), 0) << cn.addr(i);
+    }
+    manager->release();
+}
+
+TEST(StandInCnTest, ParallelScanFailsOnABadOption) {
+    PolarDBXStandIn cn({{"cn-0", "W", "z1"}, {"cn-1", "W", "z1"}});
+    auto options = options_for(cn.addrs());
+    // rejected by the connection with std::invalid_argument on a worker thread
+    options[OPT_ENABLE_FOLLOWER_READ] = 7;
+    sql::polardbx::ParallelScan scan(options, sql::polardbx::ParallelScan::expand("select {partition}",
+        {"1", "2"}), 2, sql::polardbx::ParallelScan::Merge::UNORDERED);
+    sql::polardbx::RowCursor::Row row;
+    EXPECT_THROW(scan.next(row), sql::SQLException);
+}